@@ -0,0 +1,252 @@
+/**
+  ******************************************************************************
+  * @file           : BufferPool.cpp
+  * @author         : hyn
+  * @brief          : None
+  * @attention      : None
+  * @date           : 2023/6/1
+  ******************************************************************************
+  */
+
+
+#include "BufferPool.h"
+#include "mutex.h"
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+#include <vector>
+
+namespace hyn {
+
+namespace {
+
+///shared_ptr控制块用的级别，放在数据级别后面
+constexpr size_t CONTROL_CLASS = BufferPool::CLASS_COUNT;
+constexpr size_t CONTROL_SIZE = 64;
+///控制块每个线程最多缓存的个数
+constexpr size_t MAX_CONTROL_BLOCKS = 1024;
+std::atomic<size_t> s_maxCachedBytes{1 << 20};
+
+size_t ClassSize(size_t cls) {
+    return cls == CONTROL_CLASS ? CONTROL_SIZE : BufferPool::CLASS_SIZE[cls];
+}
+
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+/**
+ *@brief 线程缓存，只有所属线程修改，统计用原子变量给GetStats读
+ */
+struct ThreadCache {
+    ThreadCache();
+
+    ~ThreadCache();
+
+    void trim();
+
+    FreeBlock *lists[CONTROL_CLASS + 1]{};
+    size_t counts[CONTROL_CLASS + 1]{};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> bypass{0};
+    std::atomic<uint64_t> cachedBytes{0};
+};
+
+/**
+ *@brief 所有线程缓存的登记表，线程退出时把统计并到retired里
+ */
+struct Registry {
+    mutex::Mutex mutex;
+    std::vector<ThreadCache *> caches;
+    uint64_t retiredHits = 0;
+    uint64_t retiredMisses = 0;
+    uint64_t retiredBypass = 0;
+};
+
+Registry &GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadCache *t_cache = nullptr;
+///线程缓存已经析构，之后释放的内存块直接还给系统
+thread_local bool t_cacheDestroyed = false;
+
+ThreadCache *GetCache() {
+    if (!t_cache && !t_cacheDestroyed) {
+        static thread_local ThreadCache cache;
+        t_cache = &cache;
+    }
+    return t_cache;
+}
+
+void Increase(std::atomic<uint64_t> &v) {
+    v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+ThreadCache::ThreadCache() {
+    Registry &registry = GetRegistry();
+    mutex::Mutex::Lock lock(registry.mutex);
+    registry.caches.push_back(this);
+}
+
+ThreadCache::~ThreadCache() {
+    trim();
+    t_cache = nullptr;
+    t_cacheDestroyed = true;
+    Registry &registry = GetRegistry();
+    mutex::Mutex::Lock lock(registry.mutex);
+    registry.retiredHits += hits;
+    registry.retiredMisses += misses;
+    registry.retiredBypass += bypass;
+    std::erase(registry.caches, this);
+}
+
+void ThreadCache::trim() {
+    for (size_t cls = 0; cls <= CONTROL_CLASS; ++cls) {
+        while (lists[cls]) {
+            FreeBlock *block = lists[cls];
+            lists[cls] = block->next;
+            ::operator delete(block);
+        }
+        counts[cls] = 0;
+    }
+    cachedBytes.store(0, std::memory_order_relaxed);
+}
+
+void *AllocateBlock(size_t cls) {
+    ThreadCache *cache = GetCache();
+    if (cache && cache->lists[cls]) {
+        FreeBlock *block = cache->lists[cls];
+        cache->lists[cls] = block->next;
+        --cache->counts[cls];
+        if (cls != CONTROL_CLASS) {
+            Increase(cache->hits);
+            cache->cachedBytes.store(cache->cachedBytes.load(std::memory_order_relaxed) - ClassSize(cls),
+                                     std::memory_order_relaxed);
+        }
+        return block;
+    }
+    if (cache && cls != CONTROL_CLASS) {
+        Increase(cache->misses);
+    }
+    return ::operator new(ClassSize(cls));
+}
+
+void ReleaseBlock(void *ptr, size_t cls) {
+    ThreadCache *cache = GetCache();
+    size_t limit = cls == CONTROL_CLASS ? MAX_CONTROL_BLOCKS : s_maxCachedBytes / ClassSize(cls);
+    if (!cache || cache->counts[cls] >= limit) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto *block = static_cast<FreeBlock *>(ptr);
+    block->next = cache->lists[cls];
+    cache->lists[cls] = block;
+    ++cache->counts[cls];
+    if (cls != CONTROL_CLASS) {
+        cache->cachedBytes.store(cache->cachedBytes.load(std::memory_order_relaxed) + ClassSize(cls),
+                                 std::memory_order_relaxed);
+    }
+}
+
+/**
+ *@brief 内存块引用计数归零时放回池里
+ */
+struct BlockDeleter {
+    uint8_t cls;
+
+    void operator()(char *ptr) const {
+        ReleaseBlock(ptr, cls);
+    }
+};
+
+/**
+ *@brief shared_ptr控制块的分配器，控制块固定大小，也放在池里
+ */
+template<typename T>
+struct ControlAllocator {
+    using value_type = T;
+
+    ControlAllocator() = default;
+
+    template<typename U>
+    ControlAllocator(const ControlAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        static_assert(sizeof(T) <= CONTROL_SIZE, "control block too large");
+        if (n != 1) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T *>(AllocateBlock(CONTROL_CLASS));
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+        ReleaseBlock(ptr, CONTROL_CLASS);
+    }
+
+    template<typename U>
+    bool operator==(const ControlAllocator<U> &) const { return true; }
+};
+
+} // namespace
+
+std::shared_ptr<char[]> BufferPool::Allocate(size_t size) {
+    size_t cls = 0;
+    while (cls < CLASS_COUNT && CLASS_SIZE[cls] < size) {
+        ++cls;
+    }
+    //太小的块用4K浪费太多，太大的不缓存
+    if (cls == CLASS_COUNT || size * 4 < CLASS_SIZE[cls]) {
+        if (ThreadCache *cache = GetCache()) {
+            Increase(cache->bypass);
+        }
+        return std::make_shared_for_overwrite<char[]>(size);
+    }
+    return {static_cast<char *>(AllocateBlock(cls)), BlockDeleter{static_cast<uint8_t>(cls)},
+            ControlAllocator<char>()};
+}
+
+BufferPool::Stats BufferPool::GetStats() {
+    Stats stats{};
+    Registry &registry = GetRegistry();
+    {
+        mutex::Mutex::Lock lock(registry.mutex);
+        stats.hits = registry.retiredHits;
+        stats.misses = registry.retiredMisses;
+        stats.bypass = registry.retiredBypass;
+        for (ThreadCache *cache: registry.caches) {
+            stats.hits += cache->hits.load(std::memory_order_relaxed);
+            stats.misses += cache->misses.load(std::memory_order_relaxed);
+            stats.bypass += cache->bypass.load(std::memory_order_relaxed);
+            stats.cachedBytes += cache->cachedBytes.load(std::memory_order_relaxed);
+        }
+    }
+    //statm的第二列是常驻内存页数
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file) {
+        unsigned long size = 0, resident = 0;
+        if (fscanf(file, "%lu %lu", &size, &resident) == 2) {
+            stats.rss = resident * sysconf(_SC_PAGESIZE);
+        }
+        fclose(file);
+    }
+    return stats;
+}
+
+void BufferPool::SetMaxCachedBytes(size_t bytes) {
+    s_maxCachedBytes = bytes;
+}
+
+void BufferPool::Trim() {
+    if (ThreadCache *cache = GetCache()) {
+        cache->trim();
+    }
+}
+
+} // hyn
@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file           : BufferPool.h
+  * @author         : hyn
+  * @brief          : 按大小分级的网络缓冲区池
+  * @attention      : None
+  * @date           : 2023/6/1
+  ******************************************************************************
+  */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace hyn {
+
+/**
+ *@brief 网络缓冲区池，按4K/16K/64K分级，每个线程缓存自己释放的内存块
+ *@note 分配时从当前线程的缓存里取，引用计数归零时放回释放它的线程的缓存，超过上限才真正释放；
+ *      shared_ptr的控制块也从池里分配，稳定后分配和释放都不调用malloc/free；
+ *      不到4K的1/4或者超过64K的不走池
+ */
+class BufferPool {
+public:
+    ///级别个数
+    static constexpr size_t CLASS_COUNT = 3;
+    ///各级别内存块的大小
+    static constexpr size_t CLASS_SIZE[CLASS_COUNT] = {4096, 16384, 65536};
+
+    /**
+     *@brief 统计，所有线程加起来
+     */
+    struct Stats {
+        ///从缓存里取到的次数
+        uint64_t hits;
+        ///缓存为空，新分配的次数
+        uint64_t misses;
+        ///大小不合适，不走池的次数
+        uint64_t bypass;
+        ///缓存着的字节数
+        uint64_t cachedBytes;
+        ///进程的常驻内存字节数
+        uint64_t rss;
+    };
+
+    /**
+     *@brief 分配size字节的内存块
+     *@return 引用计数归零时回到池里
+     */
+    static std::shared_ptr<char[]> Allocate(size_t size);
+
+    static Stats GetStats();
+
+    /**
+     *@brief 每个线程每个级别最多缓存的字节数，默认1M
+     */
+    static void SetMaxCachedBytes(size_t bytes);
+
+    /**
+     *@brief 释放当前线程缓存的所有内存块
+     */
+    static void Trim();
+};
+
+} // hyn
@@ -9,10 +9,13 @@
   */
 #pragma
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <type_traits>
 #include <vector>
 
 #include "endian.h"
@@ -22,6 +25,8 @@ namespace hyn {
 /**
  *@brief ByteArray
  *@note 序列化
+ *@note 内存块带引用计数，slice/append可以让多个ByteArray共用同一段数据而不拷贝；
+ *      共用的数据是只读的，不要setPos回去覆盖它
  */
 class ByteArray {
 public:
@@ -32,18 +37,26 @@ public:
      */
     struct Node {
         /**
-         *@brief 构造指定大小的内存块
+         *@brief 构造指定大小的内存块，从BufferPool分配
          *@param s 内存块字节数
          */
         explicit Node(size_t s);
 
+        /**
+         *@brief 引用别的节点的一段内存，不拷贝
+         *@param block 内存块
+         *@param p 起始地址，在block里面
+         *@param s 字节数
+         */
+        Node(std::shared_ptr<char[]> block, char *p, size_t s);
+
         /**
          *@brief 无参构造，全部初始化为nullptr/0
          */
         Node();
 
         /**
-         *@brief 析构，释放内存
+         *@brief 析构，内存块没有别人引用时释放
          */
         ~Node();
 
@@ -53,11 +66,13 @@ public:
         Node *next{nullptr};
         ///内存块大小
         size_t size{0};
+        ///持有内存块，切片出去的节点和原来的节点共用
+        std::shared_ptr<char[]> block;
     };
 
     /**
      *@brief 使用指定长度的内存构造ByteArray
-     *@param 内存块大小
+     *@param 内存块大小，第一次写入时才分配
      */
     explicit ByteArray(size_t base_size = 4096);
 
@@ -69,56 +84,76 @@ public:
         * @post m_position += sizeof(value)
         *       如果m_position > m_size 则 m_size = m_position
         */
-    void writeFint8(int8_t value);
+    void writeFint8(int8_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度uint8_t类型的数据
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFuint8(uint8_t value);
+    void writeFuint8(uint8_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度int16_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFint16(int16_t value);
+    void writeFint16(int16_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度uint16_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFuint16(uint16_t value);
+    void writeFuint16(uint16_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度int32_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFint32(int32_t value);
+    void writeFint32(int32_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度uint32_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFuint32(uint32_t value);
+    void writeFuint32(uint32_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度int64_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFint64(int64_t value);
+    void writeFint64(int64_t value) { writeFixed(value); }
 
     /**
      * @brief 写入固定长度uint64_t类型的数据(大端/小端)
      * @post m_position += sizeof(value)
      *       如果m_position > m_size 则 m_size = m_position
      */
-    void writeFuint64(uint64_t value);
+    void writeFuint64(uint64_t value) { writeFixed(value); }
+
+    /**
+     * @brief 批量写入固定长度的数据(大端/小端)
+     * @note 字节序和本机不同时整块做字节序转换，结果和逐个writeFxxx一样
+     */
+    template<typename T>
+    void writeFixedArray(const T *values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && (sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) <= 8);
+        if (sizeof(T) == 1 || m_endian == hyn_BYTE_ORDER) {
+            write(values, count * sizeof(T));
+            return;
+        }
+        char temp[4096];
+        for (size_t i = 0; i < count;) {
+            size_t n = std::min(count - i, sizeof(temp) / sizeof(T));
+            SwapArray(values + i, temp, n, sizeof(T));
+            write(temp, n * sizeof(T));
+            i += n;
+        }
+    }
 
     /**
      * @brief 写入有符号Varint32类型的数据
@@ -144,6 +179,28 @@ public:
      */
     void writeUint64(uint64_t value);
 
+    /**
+     * @brief 批量写入无符号Varint32类型的数据
+     * @note 编码结果和逐个调用writeUint32一样，CPU支持时用AVX2/BMI2编码
+     */
+    void writeUint32Array(const uint32_t *values, size_t count);
+
+    /**
+     * @brief 批量写入有符号Varint32类型的数据
+     * @note 采用Zigzag + Varint编码，和逐个调用writeInt32一样
+     */
+    void writeInt32Array(const int32_t *values, size_t count);
+
+    /**
+     * @brief 批量写入无符号Varint64类型的数据
+     */
+    void writeUint64Array(const uint64_t *values, size_t count);
+
+    /**
+     * @brief 批量写入有符号Varint64类型的数据
+     */
+    void writeInt64Array(const int64_t *values, size_t count);
+
     /**
      * @brief 写入float类型的数据
      */
@@ -186,7 +243,7 @@ public:
      * @post m_position += sizeof(int8_t);
      * @exception 如果getReadSize() < sizeof(int8_t) 抛出 std::out_of_range
      */
-    int8_t readFint8();
+    int8_t readFint8() { return readFixed<int8_t>(); }
 
     /**
      * @brief 读取uint8_t类型的数据
@@ -194,7 +251,7 @@ public:
      * @post m_position += sizeof(uint8_t);
      * @exception 如果getReadSize() < sizeof(uint8_t) 抛出 std::out_of_range
      */
-    uint8_t readFuint8();
+    uint8_t readFuint8() { return readFixed<uint8_t>(); }
 
     /**
      * @brief 读取int16_t类型的数据
@@ -202,7 +259,7 @@ public:
      * @post m_position += sizeof(int16_t);
      * @exception 如果getReadSize() < sizeof(int16_t) 抛出 std::out_of_range
      */
-    int16_t readFint16();
+    int16_t readFint16() { return readFixed<int16_t>(); }
 
     /**
      * @brief 读取uint16_t类型的数据
@@ -210,7 +267,7 @@ public:
      * @post m_position += sizeof(uint16_t);
      * @exception 如果getReadSize() < sizeof(uint16_t) 抛出 std::out_of_range
      */
-    uint16_t readFuint16();
+    uint16_t readFuint16() { return readFixed<uint16_t>(); }
 
     /**
      * @brief 读取int32_t类型的数据
@@ -218,7 +275,7 @@ public:
      * @post m_position += sizeof(int32_t);
      * @exception 如果getReadSize() < sizeof(int32_t) 抛出 std::out_of_range
      */
-    int32_t readFint32();
+    int32_t readFint32() { return readFixed<int32_t>(); }
 
     /**
      * @brief 读取uint32_t类型的数据
@@ -226,7 +283,7 @@ public:
      * @post m_position += sizeof(uint32_t);
      * @exception 如果getReadSize() < sizeof(uint32_t) 抛出 std::out_of_range
      */
-    uint32_t readFuint32();
+    uint32_t readFuint32() { return readFixed<uint32_t>(); }
 
     /**
      * @brief 读取int64_t类型的数据
@@ -234,7 +291,7 @@ public:
      * @post m_position += sizeof(int64_t);
      * @exception 如果getReadSize() < sizeof(int64_t) 抛出 std::out_of_range
      */
-    int64_t readFint64();
+    int64_t readFint64() { return readFixed<int64_t>(); }
 
     /**
      * @brief 读取uint64_t类型的数据
@@ -242,7 +299,20 @@ public:
      * @post m_position += sizeof(uint64_t);
      * @exception 如果getReadSize() < sizeof(uint64_t) 抛出 std::out_of_range
      */
-    uint64_t readFuint64();
+    uint64_t readFuint64() { return readFixed<uint64_t>(); }
+
+    /**
+     * @brief 批量读取count个固定长度的数据(大端/小端)
+     * @exception 如果getReadSize() < count * sizeof(T) 抛出 std::out_of_range
+     */
+    template<typename T>
+    void readFixedArray(T *values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && (sizeof(T) & (sizeof(T) - 1)) == 0 && sizeof(T) <= 8);
+        read(values, count * sizeof(T));
+        if (sizeof(T) > 1 && m_endian != hyn_BYTE_ORDER) {
+            SwapArray(values, values, count, sizeof(T));
+        }
+    }
 
     /**
     * @brief 读取有符号Varint32类型的数据
@@ -276,6 +346,31 @@ public:
      */
     uint64_t readUint64();
 
+    /**
+     * @brief 批量读取count个无符号Varint32类型的数据
+     * @post m_position += 这些Varint32实际占用内存
+     * @exception 数据不够时抛出 std::out_of_range，已经读出的值留在values里
+     */
+    void readUint32Array(uint32_t *values, size_t count);
+
+    /**
+     * @brief 批量读取count个有符号Varint32类型的数据
+     * @exception 数据不够时抛出 std::out_of_range
+     */
+    void readInt32Array(int32_t *values, size_t count);
+
+    /**
+     * @brief 批量读取count个无符号Varint64类型的数据
+     * @exception 数据不够时抛出 std::out_of_range
+     */
+    void readUint64Array(uint64_t *values, size_t count);
+
+    /**
+     * @brief 批量读取count个有符号Varint64类型的数据
+     * @exception 数据不够时抛出 std::out_of_range
+     */
+    void readInt64Array(int64_t *values, size_t count);
+
     /**
      * @brief 读取float类型的数据
      * @pre getReadSize() >= sizeof(float)
@@ -364,6 +459,24 @@ public:
      */
     bool readFromFile(const std::string &fileName);
 
+    /**
+     *@brief 把文件映射成ByteArray的内存块，不拷贝数据，原来的数据被清空，位置在0
+     *@param fileName 文件名
+     *@param writable 为true时按MAP_SHARED映射，写入直接落到文件里；
+     *       为false时按MAP_PRIVATE映射，写入只改自己的副本
+     *@param size writable时文件小于size会先扩展到size
+     *@return 是否成功
+     *@note 写超过文件大小的部分用普通内存块，不会写进文件
+     */
+    bool mapFile(const std::string &fileName, bool writable = false, size_t size = 0);
+
+    /**
+     *@brief position所在的数据是不是mapFile映射的文件，可以直接sendfile
+     *@param [out] offset 对应的文件偏移
+     *@return 文件fd，和ByteArray共用，不要close；不是映射的文件时返回-1
+     */
+    int getMappedFile(size_t position, off_t &offset) const;
+
     /**
     * @brief 返回ByteArray当前位置
     */
@@ -434,6 +547,28 @@ public:
      */
     uint64_t getWriteBuffers(std::vector<iovec> &buffers, uint64_t len);
 
+    /**
+     * @brief 把src从position开始len长度的数据接到当前位置，只增加引用计数，不拷贝
+     * @param[in] src 数据来源，可以是自己
+     * @param[in] len 数据长度
+     * @param[in] position src中的开始位置
+     * @post m_position后面原来的数据被丢弃，m_position += len，m_size = m_position
+     * @exception 如果 (src.getSize() - position) < len 则抛出 std::out_of_range
+     */
+    void append(const ByteArray &src, size_t len, size_t position);
+
+    /**
+     * @brief 把src可读取的数据接到当前位置，不拷贝，不改变src的位置
+     * @param[in] len 数据长度,如果len > src.getReadSize() 则 len = src.getReadSize()
+     */
+    void append(const ByteArray &src, size_t len = ~0ull);
+
+    /**
+     * @brief 返回一个共用[position, position + len)这段数据的ByteArray，位置在0
+     * @exception 如果 (m_size - position) < len 则抛出 std::out_of_range
+     */
+    [[nodiscard]] ByteArray::ptr slice(size_t len, size_t position) const;
+
 
     /**
      *@brief 清空ByteArray
@@ -446,6 +581,54 @@ public:
      */
     [[nodiscard]] size_t getSize() const { return m_size; }
 
+private:
+    /**
+     *@brief 写入固定长度的数据，当前内存块放得下时直接写，不走write的循环
+     */
+    template<typename T>
+    void writeFixed(T value) {
+        if constexpr (sizeof(T) > 1) {
+            if (m_endian != hyn_BYTE_ORDER) {
+                value = byteswap(value);
+            }
+        }
+        size_t npos = m_pos - m_curPos;
+        if (m_cur && npos + sizeof(T) < m_cur->size) {
+            memcpy(m_cur->ptr + npos, &value, sizeof(T));
+            m_pos += sizeof(T);
+            m_size = std::max(m_size, m_pos);
+            return;
+        }
+        write(&value, sizeof(T));
+    }
+
+    /**
+     *@brief 读取固定长度的数据，当前内存块里有完整的值时直接读
+     */
+    template<typename T>
+    T readFixed() {
+        T value;
+        size_t npos = m_pos - m_curPos;
+        if (m_cur && npos + sizeof(T) < m_cur->size && sizeof(T) <= m_size - m_pos) {
+            memcpy(&value, m_cur->ptr + npos, sizeof(T));
+            m_pos += sizeof(T);
+        } else {
+            read(&value, sizeof(T));
+        }
+        if constexpr (sizeof(T) > 1) {
+            if (m_endian != hyn_BYTE_ORDER) {
+                value = byteswap(value);
+            }
+        }
+        return value;
+    }
+
+    /**
+     *@brief 把count个width字节的值逐个反转字节序，src和dst可以相同
+     *@note CPU支持AVX2时一次处理32字节
+     */
+    static void SwapArray(const void *src, void *dst, size_t count, size_t width);
+
 private:
     /**
      *@brief 采用Zigzag编码将32位有符号整数编码为无符号整数
@@ -479,6 +662,18 @@ private:
      */
     [[nodiscard]] size_t getCapacity() const { return m_capacity - m_pos; }
 
+    /**
+     *@brief 找到position所在的内存块
+     *@param [out] offset position在内存块里的偏移
+     *@return 内存块，position == m_capacity时返回nullptr
+     */
+    Node *findNode(size_t position, size_t &offset) const;
+
+    /**
+     *@brief 丢弃position之后的内存块，容量变为position
+     */
+    void truncate(size_t position);
+
     ///内存总大小
     size_t m_baseSize;
     ///当前操作位置
@@ -489,10 +684,14 @@ private:
     size_t m_size{0};
     ///字节序（默认大端）
     int8_t m_endian{hyn_BIG_ENDIAN};
-    ///第一个内存块指针
-    Node *m_root;
-    ///当前操作的内存块指针
-    Node *m_cur;
+    ///第一个内存块指针，第一次写入时才分配
+    Node *m_root{nullptr};
+    ///最后一个内存块，扩容时接在它后面
+    Node *m_tail{nullptr};
+    ///当前操作的内存块指针，m_pos == m_capacity时为nullptr
+    Node *m_cur{nullptr};
+    ///当前内存块的起始位置，内存块大小不一定都是m_baseSize
+    size_t m_curPos{0};
 };
 
 
@@ -11,23 +11,50 @@
 
 #include "Logger.h"
 #include "ByteArray.h"
+#include "BufferPool.h"
+#include "Varint.h"
 #include <cstring>
 #include <iomanip>
 #include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
 
 namespace hyn {
 
-ByteArray::Node::Node(size_t s) : ptr(new char[s]), size(s) {
+///批量写Varint时每次在栈上编码的个数
+static constexpr size_t VARINT_BATCH = 256;
+
+/**
+ *@brief：mapFile映射的内存块的删除器，最后一个引用释放时解除映射、关闭文件
+ */
+struct MappedFile {
+    size_t length;
+    int fd;
+
+    void operator()(char *addr) const {
+        munmap(addr, length);
+        close(fd);
+    }
+};
+
+ByteArray::Node::Node(size_t s) : size(s), block(BufferPool::Allocate(s)) {
+    ptr = block.get();
+}
+
+ByteArray::Node::Node(std::shared_ptr<char[]> b, char *p, size_t s) : ptr(p), size(s), block(std::move(b)) {
 }
 
 ByteArray::Node::Node() = default;
 
-ByteArray::Node::~Node() {
-    delete[] ptr;
-}
+ByteArray::Node::~Node() = default;
 
-ByteArray::ByteArray(size_t base_size) : m_baseSize(base_size), m_capacity(base_size), m_root(new Node(base_size)),
-                                         m_cur(m_root) {
+ByteArray::ByteArray(size_t base_size) : m_baseSize(base_size), m_capacity(0) {
 }
 
 ByteArray::~ByteArray() {
@@ -39,56 +66,6 @@ ByteArray::~ByteArray() {
     }
 }
 
-void ByteArray::writeFint8(int8_t value) {
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFuint8(uint8_t value) {
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFint16(int16_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFuint16(uint16_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFint32(int32_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFuint32(uint32_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFint64(int64_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
-void ByteArray::writeFuint64(uint64_t value) {
-    if (m_endian != hyn_BYTE_ORDER) {
-        value = byteswap(value);
-    }
-    write(&value, sizeof(value));
-}
-
 size_t ByteArray::getPos() const {
     return m_pos;
 }
@@ -97,13 +74,25 @@ void ByteArray::setPos(size_t mPos) {
     THROW_OUT_OF_RANGE_IF(mPos > m_capacity, "setpos out of range");
     m_pos = mPos;
     m_size = std::max(m_pos, m_size);
-    m_cur = m_root;
-    while (mPos > m_cur->size) {
-        mPos -= m_cur->size;
-        m_cur = m_cur->next;
+    size_t offset;
+    m_cur = findNode(mPos, offset);
+    m_curPos = mPos - offset;
+}
+
+ByteArray::Node *ByteArray::findNode(size_t position, size_t &offset) const {
+    //往后找的时候从当前内存块开始
+    Node *cur = m_root;
+    size_t start = 0;
+    if (m_cur && position >= m_curPos) {
+        cur = m_cur;
+        start = m_curPos;
+    }
+    while (cur && position >= start + cur->size) {
+        start += cur->size;
+        cur = cur->next;
     }
-    if (m_cur->size == mPos)
-        m_cur = m_cur->next;
+    offset = position - start;
+    return cur;
 }
 
 bool ByteArray::writeToFile(const std::string &fileName) {
@@ -113,31 +102,36 @@ bool ByteArray::writeToFile(const std::string &fileName) {
         error("write to file %s error,errno:%d,errstr:%s", fileName.c_str(), errno, strerror(errno));
         return false;
     }
-    auto read_size = getReadSize(), pos = m_pos;
-    Node *cur = m_cur;
-    while (read_size > 0) {
-        auto diff = pos % m_baseSize;
-        auto len = (read_size > m_baseSize ? m_baseSize : read_size) - diff;
-        ofs.write(cur->ptr, static_cast<long>(len));
-        cur = cur->next;
-        pos += len;
-        read_size -= len;
+    std::vector<iovec> buffers;
+    getReadBuffers(buffers);
+    for (auto &iov: buffers) {
+        ofs.write(static_cast<const char *>(iov.iov_base), static_cast<long>(iov.iov_len));
     }
     return true;
 }
 
 void ByteArray::clear() {
     m_pos = 0;
-    m_capacity = m_baseSize;
     m_size = 0;
-    Node *temp = m_root->next;
+    //第一个内存块是自己独占的完整内存块时留着复用
+    Node *keep = nullptr;
+    if (m_root && m_root->ptr == m_root->block.get() && m_root->size == m_baseSize &&
+        m_root->block.use_count() == 1 && !std::get_deleter<MappedFile>(m_root->block)) {
+        keep = m_root;
+    }
+    Node *temp = keep ? m_root->next : m_root;
     while (temp) {
         m_cur = temp;
         temp = temp->next;
         delete m_cur;
     }
+    m_root = keep;
+    if (m_root)
+        m_root->next = nullptr;
     m_cur = m_root;
-    m_root->next = nullptr;
+    m_tail = m_root;
+    m_curPos = 0;
+    m_capacity = m_root ? m_root->size : 0;
 }
 
 void ByteArray::write(const void *buff, size_t size) {
@@ -146,26 +140,19 @@ void ByteArray::write(const void *buff, size_t size) {
     }
     addCapacity(size);
 
-    size_t npos = m_pos % m_baseSize;
-    size_t ncap = m_cur->size - npos;
+    size_t npos = m_pos - m_curPos;
     size_t bpos = 0;
 
     while (size > 0) {
-        if (ncap >= size) {
-            memcpy(m_cur->ptr + npos, (const char *) buff + bpos, size);
-            if (m_cur->size == (npos + size)) {
-                m_cur = m_cur->next;
-            }
-            m_pos += size;
-            bpos += size;
-            size = 0;
-        } else {
-            memcpy(m_cur->ptr + npos, (const char *) buff + bpos, ncap);
-            m_pos += ncap;
-            bpos += ncap;
-            size -= ncap;
+        size_t len = std::min(m_cur->size - npos, size);
+        memcpy(m_cur->ptr + npos, (const char *) buff + bpos, len);
+        m_pos += len;
+        bpos += len;
+        size -= len;
+        npos += len;
+        if (npos == m_cur->size) {
+            m_curPos += m_cur->size;
             m_cur = m_cur->next;
-            ncap = m_cur->size;
             npos = 0;
         }
     }
@@ -183,18 +170,99 @@ void ByteArray::addCapacity(size_t size) {
         return;
     size -= old_cap;
     size_t count = ceil(1.0 * size / m_baseSize);
-    Node *first = nullptr, *last = m_root;
-    while (last->next != nullptr)
-        last = last->next;
+    Node *first = nullptr, *last = m_tail;
     for (size_t i = 0; i < count; ++i) {
-        last->next = new Node(m_baseSize);
+        auto *node = new Node(m_baseSize);
+        if (last)
+            last->next = node;
+        else
+            m_root = node;
         if (first == nullptr)
-            first = last->next;
-        last = last->next;
+            first = node;
+        last = node;
         m_capacity += m_baseSize;
     }
-    if (old_cap == 0)
+    m_tail = last;
+    if (old_cap == 0) {
         m_cur = first;
+        m_curPos = m_pos;
+    }
+}
+
+void ByteArray::truncate(size_t position) {
+    Node **link = &m_root;
+    Node *prev = nullptr;
+    size_t start = 0;
+    while (*link && start + (*link)->size <= position) {
+        start += (*link)->size;
+        prev = *link;
+        link = &(*link)->next;
+    }
+    //position落在内存块中间时把这个内存块截短，后面的空间不再使用
+    if (*link && position > start) {
+        (*link)->size = position - start;
+        prev = *link;
+        link = &(*link)->next;
+    }
+    Node *temp = *link;
+    *link = nullptr;
+    m_tail = prev;
+    while (temp) {
+        Node *next = temp->next;
+        delete temp;
+        temp = next;
+    }
+    m_capacity = position;
+    m_size = std::min(m_size, position);
+    if (m_pos >= position) {
+        m_cur = nullptr;
+        m_curPos = position;
+    }
+}
+
+void ByteArray::append(const ByteArray &src, size_t len, size_t position) {
+    THROW_OUT_OF_RANGE_IF(position > src.m_size || len > src.m_size - position, "append out of range");
+    if (len == 0) {
+        return;
+    }
+    //先把要共用的内存块都引用上，src是自己时截断也不会释放它们
+    Node *first = nullptr, *last = nullptr;
+    size_t npos;
+    Node *cur = src.findNode(position, npos);
+    for (size_t left = len; left > 0; cur = cur->next, npos = 0) {
+        size_t size = std::min(cur->size - npos, left);
+        auto *node = new Node(cur->block, cur->ptr + npos, size);
+        if (last)
+            last->next = node;
+        else
+            first = node;
+        last = node;
+        left -= size;
+    }
+
+    truncate(m_pos);
+    if (m_tail)
+        m_tail->next = first;
+    else
+        m_root = first;
+    m_tail = last;
+    m_pos += len;
+    m_size = m_pos;
+    m_capacity = m_pos;
+    m_cur = nullptr;
+    m_curPos = m_pos;
+}
+
+void ByteArray::append(const ByteArray &src, size_t len) {
+    append(src, std::min(len, src.getReadSize()), src.m_pos);
+}
+
+ByteArray::ptr ByteArray::slice(size_t len, size_t position) const {
+    ByteArray::ptr ba(new ByteArray(m_baseSize));
+    ba->setIsLittleEndian(isLittleEndian());
+    ba->append(*this, len, position);
+    ba->setPos(0);
+    return ba;
 }
 
 void ByteArray::read(void *buff, size_t size) {
@@ -202,54 +270,35 @@ void ByteArray::read(void *buff, size_t size) {
         throw std::out_of_range("not enough len");
     }
 
-    size_t npos = m_pos % m_baseSize;
-    size_t ncap = m_cur->size - npos;
+    size_t npos = m_pos - m_curPos;
     size_t bpos = 0;
     while (size > 0) {
-        if (ncap >= size) {
-            memcpy((char *) buff + bpos, m_cur->ptr + npos, size);
-            if (m_cur->size == (npos + size)) {
-                m_cur = m_cur->next;
-            }
-            m_pos += size;
-            bpos += size;
-            size = 0;
-        } else {
-            memcpy((char *) buff + bpos, m_cur->ptr + npos, ncap);
-            m_pos += ncap;
-            bpos += ncap;
-            size -= ncap;
+        size_t len = std::min(m_cur->size - npos, size);
+        memcpy((char *) buff + bpos, m_cur->ptr + npos, len);
+        m_pos += len;
+        bpos += len;
+        size -= len;
+        npos += len;
+        if (npos == m_cur->size) {
+            m_curPos += m_cur->size;
             m_cur = m_cur->next;
-            ncap = m_cur->size;
             npos = 0;
         }
     }
 }
 
 void ByteArray::read(void *buff, size_t size, size_t position) const {
-    THROW_OUT_OF_RANGE_IF(size > (m_size - position), "not enough len");
-    size_t npos = position % m_baseSize;
-    size_t ncap = m_cur->size - npos;
+    THROW_OUT_OF_RANGE_IF(position > m_size || size > (m_size - position), "not enough len");
+    size_t npos;
+    Node *cur = findNode(position, npos);
     size_t bpos = 0;
-    Node *cur = m_cur;
     while (size > 0) {
-        if (ncap >= size) {
-            memcpy((char *) buff + bpos, cur->ptr + npos, size);
-            if (cur->size == (npos + size)) {
-                cur = cur->next;
-            }
-            position += size;
-            bpos += size;
-            size = 0;
-        } else {
-            memcpy((char *) buff + bpos, cur->ptr + npos, ncap);
-            position += ncap;
-            bpos += ncap;
-            size -= ncap;
-            cur = cur->next;
-            ncap = cur->size;
-            npos = 0;
-        }
+        size_t len = std::min(cur->size - npos, size);
+        memcpy((char *) buff + bpos, cur->ptr + npos, len);
+        bpos += len;
+        size -= len;
+        cur = cur->next;
+        npos = 0;
     }
 }
 
@@ -268,6 +317,60 @@ bool ByteArray::readFromFile(const std::string &fileName) {
     return true;
 }
 
+bool ByteArray::mapFile(const std::string &fileName, bool writable, size_t size) {
+    int fd = open(fileName.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        error("map file %s error,errno:%d,errstr:%s", fileName.c_str(), errno, strerror(errno));
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || (writable && size > (size_t) st.st_size && ftruncate(fd, (off_t) size) < 0)) {
+        error("map file %s error,errno:%d,errstr:%s", fileName.c_str(), errno, strerror(errno));
+        close(fd);
+        return false;
+    }
+    size_t length = std::max((size_t) st.st_size, writable ? size : 0);
+    char *addr = nullptr;
+    if (length) {
+        //只读时也带PROT_WRITE，MAP_PRIVATE下写入是写时复制，不会改到文件
+        void *rt = mmap(nullptr, length, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (rt == MAP_FAILED) {
+            error("mmap file %s error,errno:%d,errstr:%s", fileName.c_str(), errno, strerror(errno));
+            close(fd);
+            return false;
+        }
+        addr = static_cast<char *>(rt);
+    }
+
+    clear();
+    truncate(0);
+    if (!length) {
+        close(fd);
+        return true;
+    }
+    m_root = new Node(std::shared_ptr<char[]>(addr, MappedFile{length, fd}), addr, length);
+    m_tail = m_root;
+    m_cur = m_root;
+    m_curPos = 0;
+    m_capacity = length;
+    m_size = length;
+    return true;
+}
+
+int ByteArray::getMappedFile(size_t position, off_t &offset) const {
+    size_t npos;
+    Node *node = findNode(position, npos);
+    if (!node) {
+        return -1;
+    }
+    auto file = std::get_deleter<MappedFile>(node->block);
+    if (!file) {
+        return -1;
+    }
+    offset = static_cast<off_t>(node->ptr - node->block.get() + npos);
+    return file->fd;
+}
+
 bool ByteArray::isLittleEndian() const {
     return m_endian == hyn_LITTLE_ENDIAN;
 }
@@ -307,58 +410,25 @@ std::string ByteArray::toHexString() const {
 
 
 uint64_t ByteArray::getReadBuffers(std::vector<iovec> &buffers, uint64_t len) const {
-    len = len > getReadSize() ? getReadSize() : len;
-    if (len <= 0)
-        return 0;
-    uint64_t size = len;
-    size_t npos = m_pos % m_baseSize, ncap = m_cur->size - npos;
-    iovec iov{};
-    Node *cur = m_cur;
-    while (size > 0) {
-        if (ncap >= size) {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = size;
-            size = 0;
-        } else {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = ncap;
-            size -= ncap;
-            cur = cur->next;
-            ncap = cur->size;
-            npos = 0;
-        }
-        buffers.push_back(iov);
-    }
-    return len;
+    return getReadBuffers(buffers, len, m_pos);
 }
 
 uint64_t ByteArray::getReadBuffers(std::vector<iovec> &buffers, uint64_t len, uint64_t position) const {
-    len = len > getReadSize() ? getReadSize() : len;
+    if (position >= m_size)
+        return 0;
+    len = len > m_size - position ? m_size - position : len;
     if (len <= 0)
         return 0;
     uint64_t size = len;
-    size_t npos = position % m_baseSize;
-    size_t count = position / m_baseSize;
-    Node *cur = m_cur;
-    while (count > 0) {
-        cur = cur->next;
-        --count;
-    }
-    size_t ncap = cur->size - npos;
+    size_t npos;
+    Node *cur = findNode(position, npos);
     iovec iov{};
     while (size > 0) {
-        if (ncap >= size) {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = size;
-            size = 0;
-        } else {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = ncap;
-            size -= ncap;
-            cur = cur->next;
-            ncap = cur->size;
-            npos = 0;
-        }
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min(cur->size - npos, size);
+        size -= iov.iov_len;
+        cur = cur->next;
+        npos = 0;
         buffers.push_back(iov);
     }
     return len;
@@ -371,24 +441,15 @@ uint64_t ByteArray::getWriteBuffers(std::vector<iovec> &buffers, uint64_t len) {
     addCapacity(len);
     uint64_t size = len;
 
-    size_t npos = m_pos % m_baseSize;
-    size_t ncap = m_cur->size - npos;
+    size_t npos = m_pos - m_curPos;
     iovec iov{};
     Node *cur = m_cur;
     while (len > 0) {
-        if (ncap >= len) {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = len;
-            len = 0;
-        } else {
-            iov.iov_base = cur->ptr + npos;
-            iov.iov_len = ncap;
-
-            len -= ncap;
-            cur = cur->next;
-            ncap = cur->size;
-            npos = 0;
-        }
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min(cur->size - npos, len);
+        len -= iov.iov_len;
+        cur = cur->next;
+        npos = 0;
         buffers.push_back(iov);
     }
     return size;
@@ -418,6 +479,70 @@ int64_t ByteArray::DecodeZigzag64(uint64_t value) {
     return (value >> 1) ^ (-(value & 1));
 }
 
+template<typename T>
+static void SwapScalar(const char *src, char *dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        T v;
+        memcpy(&v, src + i * sizeof(T), sizeof(T));
+        v = byteswap(v);
+        memcpy(dst + i * sizeof(T), &v, sizeof(T));
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ *@brief：每32字节用一次pshufb把每个值的字节倒过来
+ */
+__attribute__((target("avx2")))
+static size_t SwapAvx2(const char *src, char *dst, size_t count, size_t width) {
+    __m256i pick;
+    if (width == 2) {
+        pick = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    } else if (width == 4) {
+        pick = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    } else {
+        pick = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    }
+    size_t bytes = count * width & ~size_t(31);
+    for (size_t i = 0; i < bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, pick));
+    }
+    return bytes / width;
+}
+#endif
+
+void ByteArray::SwapArray(const void *src, void *dst, size_t count, size_t width) {
+    auto in = static_cast<const char *>(src);
+    auto out = static_cast<char *>(dst);
+    size_t done = 0;
+#if defined(__x86_64__) && defined(__GNUC__)
+    static const bool s_avx2 = __builtin_cpu_supports("avx2");
+    if (s_avx2) {
+        done = SwapAvx2(in, out, count, width);
+    }
+#endif
+    in += done * width;
+    out += done * width;
+    count -= done;
+    switch (width) {
+        case 2:
+            SwapScalar<uint16_t>(in, out, count);
+            break;
+        case 4:
+            SwapScalar<uint32_t>(in, out, count);
+            break;
+        case 8:
+            SwapScalar<uint64_t>(in, out, count);
+            break;
+        default:
+            break;
+    }
+}
+
 void ByteArray::writeInt32(int32_t value) {
     writeUint32(EncodeZigzag32(value));
 }
@@ -448,6 +573,40 @@ void ByteArray::writeUint64(uint64_t value) {
     write(temp, i);
 }
 
+void ByteArray::writeUint32Array(const uint32_t *values, size_t count) {
+    uint8_t temp[VARINT_BATCH * varint::MAX_LEN32 + varint::ENCODE_SLACK];
+    for (size_t i = 0; i < count; i += VARINT_BATCH) {
+        size_t n = std::min(count - i, VARINT_BATCH);
+        write(temp, varint::EncodeUint32(values + i, n, temp));
+    }
+}
+
+void ByteArray::writeInt32Array(const int32_t *values, size_t count) {
+    uint32_t temp[VARINT_BATCH];
+    for (size_t i = 0; i < count; i += VARINT_BATCH) {
+        size_t n = std::min(count - i, VARINT_BATCH);
+        varint::EncodeZigzag32(values + i, n, temp);
+        writeUint32Array(temp, n);
+    }
+}
+
+void ByteArray::writeUint64Array(const uint64_t *values, size_t count) {
+    uint8_t temp[VARINT_BATCH * varint::MAX_LEN64 + varint::ENCODE_SLACK];
+    for (size_t i = 0; i < count; i += VARINT_BATCH) {
+        size_t n = std::min(count - i, VARINT_BATCH);
+        write(temp, varint::EncodeUint64(values + i, n, temp));
+    }
+}
+
+void ByteArray::writeInt64Array(const int64_t *values, size_t count) {
+    uint64_t temp[VARINT_BATCH];
+    for (size_t i = 0; i < count; i += VARINT_BATCH) {
+        size_t n = std::min(count - i, VARINT_BATCH);
+        varint::EncodeZigzag64(values + i, n, temp);
+        writeUint64Array(temp, n);
+    }
+}
+
 void ByteArray::writeFloat(float value) {
     uint32_t v;
     memcpy(&v, &value, sizeof(value));
@@ -484,80 +643,6 @@ void ByteArray::writeStringWithoutLength(const std::string &value) {
     write(value.c_str(), value.size());
 }
 
-int8_t ByteArray::readFint8() {
-    int8_t v;
-    read(&v, sizeof(v));
-    return v;
-}
-
-uint8_t ByteArray::readFuint8() {
-    uint8_t v;
-    read(&v, sizeof(v));
-    return v;
-}
-
-
-int16_t ByteArray::readFint16() {
-    int16_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-uint16_t ByteArray::readFuint16() {
-    uint16_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-int32_t ByteArray::readFint32() {
-    int32_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-uint32_t ByteArray::readFuint32() {
-    uint32_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-int64_t ByteArray::readFint64() {
-    int64_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-uint64_t ByteArray::readFuint64() {
-    uint64_t v;
-    read(&v, sizeof(v));
-    if (m_endian == hyn_BYTE_ORDER) {
-        return v;
-    } else {
-        return byteswap(v);
-    }
-}
-
-
 int32_t ByteArray::readInt32() {
     return DecodeZigzag32(readUint32());
 }
@@ -594,6 +679,52 @@ uint64_t ByteArray::readUint64() {
     return res;
 }
 
+void ByteArray::readUint32Array(uint32_t *values, size_t count) {
+    size_t n = 0;
+    while (n < count) {
+        THROW_OUT_OF_RANGE_IF(!getReadSize(), "not enough len");
+        //当前内存块里完整的值一次解码完
+        size_t npos = m_pos - m_curPos;
+        size_t decoded;
+        size_t used = varint::DecodeUint32(reinterpret_cast<const uint8_t *>(m_cur->ptr + npos),
+                                           std::min(m_cur->size - npos, getReadSize()),
+                                           values + n, count - n, decoded);
+        setPos(m_pos + used);
+        n += decoded;
+        //跨过内存块边界的值逐字节读
+        if (n < count) {
+            values[n++] = readUint32();
+        }
+    }
+}
+
+void ByteArray::readInt32Array(int32_t *values, size_t count) {
+    readUint32Array(reinterpret_cast<uint32_t *>(values), count);
+    varint::DecodeZigzag32(reinterpret_cast<uint32_t *>(values), count, values);
+}
+
+void ByteArray::readUint64Array(uint64_t *values, size_t count) {
+    size_t n = 0;
+    while (n < count) {
+        THROW_OUT_OF_RANGE_IF(!getReadSize(), "not enough len");
+        size_t npos = m_pos - m_curPos;
+        size_t decoded;
+        size_t used = varint::DecodeUint64(reinterpret_cast<const uint8_t *>(m_cur->ptr + npos),
+                                           std::min(m_cur->size - npos, getReadSize()),
+                                           values + n, count - n, decoded);
+        setPos(m_pos + used);
+        n += decoded;
+        if (n < count) {
+            values[n++] = readUint64();
+        }
+    }
+}
+
+void ByteArray::readInt64Array(int64_t *values, size_t count) {
+    readUint64Array(reinterpret_cast<uint64_t *>(values), count);
+    varint::DecodeZigzag64(reinterpret_cast<uint64_t *>(values), count, values);
+}
+
 float ByteArray::readFloat() {
     auto v = readFuint32();
     float value;
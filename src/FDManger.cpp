@@ -14,17 +14,21 @@
 #include "Hook.h"
 
 namespace hyn {
-FdCtx::FdCtx(int fd) : m_isInit(false), m_isSocket(false), m_isSysNonblock(false), m_isUsrNonblock(false), m_isClose(
-        false), m_fd(fd), m_recvTimeOut(-1), m_sendTimeOut(-1) {
-    init();
-}
-
-bool FdCtx::init() {
-    if (m_isInit)
-        return true;
+bool FdCtx::init(int fd) {
+    m_isInit = false;
+    m_isSocket = false;
+    m_isSysNonblock = false;
+    m_isUsrNonblock = false;
+    m_isClose = false;
+    m_recvTimeOut = -1;
+    m_sendTimeOut = -1;
+    m_io.m_fd = fd;
+    //同一个fd号上次常驻注册的状态不算数了
+    m_io.m_registered = false;
+    m_io.m_ready = iomanager::IOManager::NONE;
     //调用fstat函数来获取文件描述符的状态，并将状态存储在fd_stat结构体中。
     struct stat fd_stat{};
-    int ret = fstat(m_fd, &fd_stat);
+    int ret = fstat(fd, &fd_stat);
     //如果fstat函数返回-1，则表示文件描述符无效，设置m_isInit和m_isSocket为false。
     //否则，设置m_isInit为true，并通过S_ISSOCK宏判断文件描述符是否是套接字（socket）。
     if (ret == -1) {
@@ -37,9 +41,9 @@ bool FdCtx::init() {
     //如果文件描述符是套接字，则通过fcntl_f函数获取文件描述符的标志位，如果标志位中没有设置O_NONBLOCK，则设置该标志位，以便以后进行非阻塞I/O操作。同时，将m_sysNonblock设置为true。
     //如果文件描述符不是套接字，则将m_sysNonblock设置为false。
     if (m_isSocket) {
-        int flag = fcntl_f(m_fd, F_GETFL, 0);
+        int flag = fcntl_f(fd, F_GETFL, 0);
         if (!(flag & O_NONBLOCK)) {
-            fcntl_f(m_fd, F_SETFL, flag | O_NONBLOCK);
+            fcntl_f(fd, F_SETFL, flag | O_NONBLOCK);
             m_isSysNonblock = true;
         }
     } else {
@@ -80,36 +84,27 @@ uint64_t FdCtx::get_time(int type) const {
     }
 }
 
-FDManger::FDManger() {
-    m_datas.resize(64);
-}
-
 FdCtx::ptr FDManger::get(int fd, bool auto_create) {
-    if (fd == -1)
+    FdCtx *ctx = record(fd, auto_create);
+    if (!ctx)
+        return nullptr;
+    if (ctx->m_used.load(std::memory_order_acquire))
+        return ctx;
+    if (!auto_create)
         return nullptr;
-    RWMutexType::ReadLock Rlock(m_mutex);
-    if (fd >= (int) m_datas.size()) {
-        if (!auto_create)
-            return nullptr;
-    } else {
-        if (m_datas[fd] || !auto_create) {
-            return m_datas[fd];
-        }
-    }
-    Rlock.unlock();
 
-    RWMutexType::WriteLock Wlock(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    if (fd >= static_cast<double >(m_datas.size()))
-        m_datas.resize(static_cast<unsigned long>((fd * 1.5)));
-    m_datas[fd] = ctx;
+    //同时创建时只初始化一次
+    iomanager::IOManager::FdContext::MutexType::Lock lock(ctx->m_io.mutex);
+    if (!ctx->m_used.load(std::memory_order_relaxed)) {
+        ctx->init(fd);
+        ctx->m_used.store(true, std::memory_order_release);
+    }
     return ctx;
 }
 
 void FDManger::del(int fd) {
-    RWMutexType::WriteLock lock(m_mutex);
-    if (m_datas.size() <= fd)
-        return;
-    m_datas[fd].reset();
+    FdCtx *ctx = record(fd, false);
+    if (ctx)
+        ctx->m_used.store(false, std::memory_order_release);
 }
-} // hyn
\ No newline at end of file
+} // hyn
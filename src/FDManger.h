@@ -18,6 +18,8 @@
 #include <fcntl.h>
 #include "mutex.h"
 #include "_Singleton.h"
+#include "SegmentedArray.h"
+#include "IOManager.h"
 
 
 namespace hyn {
@@ -26,12 +28,16 @@ namespace hyn {
  * @brief 文件句柄上下文类
  * @note 管理文件句柄类型(是否socket)
  * @note 是否阻塞,是否关闭,读/写超时时间
+ * @note 同一个fd的hook状态和IOManager的事件上下文放在同一条记录里，按缓存行对齐，
+ *       hook用到的标志、超时和已注册的事件在第一个缓存行；记录直到程序退出都不释放
  */
-class FdCtx : public std::enable_shared_from_this<FdCtx> {
+class alignas(64) FdCtx : boost::noncopyable {
+    friend class FDManger;
+    friend class iomanager::IOManager;
 public:
-    typedef std::shared_ptr<FdCtx> ptr;
+    typedef FdCtx *ptr;
 
-    explicit FdCtx(int fd);
+    FdCtx() = default;
 
     /**
      * @brief 是否初始化完成
@@ -85,32 +91,39 @@ public:
     uint64_t get_time(int type) const;
 
 private:
-    bool init();
+    /**
+     * @brief 第一次被hook使用时初始化，fd被关闭后重新使用时也会再来一次
+     */
+    bool init(int fd);
 
+    ///是否被hook使用中，FDManger::del之后为false
+    std::atomic<bool> m_used{false};
     ///是否初始化
-    bool m_isInit: 1;
+    bool m_isInit: 1 {false};
     ///是否socket
-    bool m_isSocket: 1;
+    bool m_isSocket: 1 {false};
     ///是否system nonblock
-    bool m_isSysNonblock: 1;
+    bool m_isSysNonblock: 1 {false};
     ///是否usr nonblock
-    bool m_isUsrNonblock: 1;
+    bool m_isUsrNonblock: 1 {false};
     ///是否关闭
-    bool m_isClose;
-    ///fd
-    int m_fd;
+    bool m_isClose{false};
     ///读超时时间
-    uint64_t m_recvTimeOut;
+    uint64_t m_recvTimeOut{static_cast<uint64_t>(-1)};
     ///写超时时间
-    uint64_t m_sendTimeOut;
+    uint64_t m_sendTimeOut{static_cast<uint64_t>(-1)};
+    ///IOManager的事件上下文，fd也存在这里
+    iomanager::IOManager::FdContext m_io;
 };
 
+/**
+ * @brief 文件句柄管理类
+ * @note 每个hook的系统调用都要查一次，用分段数组按fd下标查找，不加锁
+ */
 class FDManger {
 
 public:
-    typedef mutex::RWMutex RWMutexType;
-
-    FDManger();
+    FDManger() = default;
 
     ~FDManger() = default;
 
@@ -118,6 +131,7 @@ public:
      *@brief：获取文件句柄类,fd不存在的情况下是否自动创建
      *@param：文件句柄
      *@param：fd不存在的情况下是否自动创建
+     *@return：fd超出范围时返回nullptr
      */
     FdCtx::ptr get(int fd, bool auto_create = false);
 
@@ -127,10 +141,19 @@ public:
      */
     void del(int fd);
 
+    /**
+     *@brief：fd对应的记录，不管有没有被hook使用过，IOManager用它存放事件上下文
+     *@param：文件句柄
+     *@param：记录所在的段还没分配时是否分配
+     *@return：fd超出范围或者段不存在时返回nullptr
+     */
+    FdCtx *record(int fd, bool auto_create) {
+        return fd < 0 ? nullptr : m_datas.at(fd, auto_create);
+    }
+
 private:
-    RWMutexType m_mutex;
-    ///文件句柄集合
-    std::vector<FdCtx::ptr> m_datas;
+    ///文件句柄集合，每段1024条记录
+    SegmentedArray<FdCtx, 10, 16384> m_datas;
 };
 
 typedef Singleton <FDManger> FdMgr;
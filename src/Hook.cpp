@@ -9,6 +9,10 @@
   */
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <poll.h>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
 #include "Hook.h"
 #include "fiber.h"
 #include "IOManager.h"
@@ -38,15 +42,45 @@ static thread_local bool s_hook_enable = false;
     XX(send)         \
     XX(sendto)       \
     XX(sendmsg)      \
+    XX(sendfile)     \
+    XX(splice)       \
     XX(close)        \
     XX(fcntl)        \
     XX(ioctl)        \
     XX(getsockopt)   \
     XX(setsockopt)
 
-struct time_info {
-    int cancelled = 0;
-};
+/**
+ *@作用：构造io_uring请求
+ *@参数：操作码
+ *@参数：fd
+ *@参数：缓冲区或者结构体的地址
+ *@参数：长度，超过32位的部分截到UINT32_MAX，和系统调用一样按部分完成处理
+ *@返回值：请求，其余字段由调用者填写
+ */
+static io_uring_sqe make_sqe(uint8_t opcode, int fd, uint64_t addr, size_t len) {
+    io_uring_sqe sqe{};
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = addr;
+    sqe.len = static_cast<uint32_t>(std::min<size_t>(len, UINT32_MAX));
+    return sqe;
+}
+
+/**
+ *@作用：把io_uring请求的结果转换成系统调用的返回值和errno
+ */
+static ssize_t uring_result(int fd, int res) {
+    if (res >= 0) {
+        return res;
+    }
+    if (res == -ECANCELED) {
+        //fd已经被close取消了，否则是超时
+        res = FdMgr::GetInstance()->get(fd) ? -ETIMEDOUT : -EBADF;
+    }
+    errno = -res;
+    return -1;
+}
 
 /**
  *@作用：在进行非阻塞 IO 操作时，添加超时和事件通知等功能
@@ -55,13 +89,14 @@ struct time_info {
  *@参数：被hook的函数名称
  *@参数：事件类型
  *@参数：超时时间类型(读还是写)
+ *@参数：返回io_uring请求的函数，只在io_uring模式下需要等待时调用；nullptr表示这个函数只走epoll
  *@参数：可变参数：函数参数
  *@返回值：操作的字节数，如果发生错误则返回-1。
  */
-template<typename OriginFun, typename ...Args>
+template<typename OriginFun, typename MakeSqe, typename ...Args>
 static ssize_t
 do_io(int fd, OriginFun func, const char *hook_fun_name, iomanager::IOManager::Event event, int timeout_so,
-      Args ...args) {
+      MakeSqe make_uring_sqe, Args ...args) {
     //首先判断是否开启了 hook，如果未开启则直接调用原始函数。
     if (!s_hook_enable)
         return func(fd, std::forward<Args>(args)...);
@@ -82,7 +117,6 @@ do_io(int fd, OriginFun func, const char *hook_fun_name, iomanager::IOManager::E
         return func(fd, std::forward<Args>(args)...);
 
     uint64_t timeout = fd_ctx->get_time(timeout_so);
-    auto tinfo = std::make_shared<time_info>();
 
     retry:
 
@@ -98,41 +132,28 @@ do_io(int fd, OriginFun func, const char *hook_fun_name, iomanager::IOManager::E
         //debug("do io");
 
         iomanager::IOManager *iom = iomanager::IOManager::GetThis();
-        Timer::ptr timer;
-        std::weak_ptr<time_info> weak_time_info(tinfo);
-
 
-        //如果超时时间不为 -1，则使用 IO 线程添加一个条件定时器，到达超时时间时会取消当前事件的监听,强制执行，并将 timer_info 结构体的
-        // cancelled 标志设置为 ETIMEDOUT。
-        if (timeout != static_cast<uint64_t>(-1)) {
-            timer = iom->addConditionTimer(timeout, [weak_time_info, fd, iom, event]() {
-                auto t = weak_time_info.lock();
-                if (t == nullptr || t->cancelled) {
-                    return;
+        //io_uring模式下把这次IO直接交给内核，完成时带着结果恢复，不用再epoll_ctl和重试
+        if constexpr (!std::is_same_v<MakeSqe, std::nullptr_t>) {
+            if (iom->isIoUring()) {
+                int res = iom->submitIo(make_uring_sqe(), timeout);
+                if (res != -ENOSYS) {
+                    return uring_result(fd, res);
                 }
-                t->cancelled = ETIMEDOUT;
-                iom->cancelEvent(fd, event);
-            }, weak_time_info, false);
+            }
         }
 
-        //将文件描述符 fd 加入到 IO 管理器的事件循环中，如果返回值不为 0，则表示出错，打印错误日志并返回 -1。否则，使用协程的
-        // YieldToHold 函数将协程切换到后台运行
-        int rt = iom->addEvent(fd, event);
-        if (rt != 0) {
+        //等待事件，超时由fd上下文里的定时器取消事件，不分配内存
+        int rt = iom->waitEvent(fd, event, timeout);
+        if (rt == -1) {
             error("%s addEvent error fd:%d", hook_fun_name, fd);
-            if (timer)
-                timer->cancel();
             return -1;
-        } else {
-            fiber::Fiber::YieldToHold();
-            if (timer)
-                timer->cancel();
-            if (tinfo->cancelled) {
-                errno = tinfo->cancelled;
-                return -1;
-            }
-            goto retry;
         }
+        if (rt == ETIMEDOUT) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        goto retry;
     }
     return n;
 }
@@ -254,36 +275,25 @@ int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
     //如果返回-1且错误代码是EINPROGRESS，则进行以下操作：
     //创建一个定时器。
     hyn::iomanager::IOManager *iom = hyn::iomanager::IOManager::GetThis();
-    hyn::Timer::ptr timer;
-    auto tinfo = std::make_shared<hyn::time_info>();
-    std::weak_ptr<hyn::time_info> winfo(tinfo);
-
-    //如果timeout_ms不为默认值（-1），则创建一个定时器。定时器回调函数会将超时标记设置为ETIMEDOUT，并取消等待事件的IO事件。
-    if (timout_ms != static_cast<uint64_t>(-1)) {
-        timer = iom->addConditionTimer(timout_ms, [winfo, fd, iom] {
-            auto t = winfo.lock();
-            if (!t || t->cancelled)
-                return;
-            t->cancelled = ETIMEDOUT;
-            iom->cancelEvent(fd, hyn::iomanager::IOManager::WRITE);
-        }, winfo, false);
+    //io_uring模式下用poll请求等连接完成，连接已经发起了，不能再提交connect
+    int res = -ENOSYS;
+    if (iom->isIoUring()) {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_POLL_ADD, fd, 0, 0);
+        sqe.poll32_events = POLLOUT;
+        res = iom->submitIo(sqe, timout_ms);
+        if (res < 0 && res != -ENOSYS) {
+            return static_cast<int>(hyn::uring_result(fd, res));
+        }
     }
-
-    //使用IOManager的addEvent函数向事件循环中添加WRITE事件。如果添加成功，则调用Fiber::YieldToHold函数切换到其他协程执行，
-    // 等待IO事件被触发或者超时定时器超时。
-    int rt = iom->addEvent(fd, hyn::iomanager::IOManager::WRITE);
-    if (rt == 0) {
-        hyn::fiber::Fiber::YieldToHold();
-        if (timer)
-            timer->cancel();
-        if (tinfo) {
-            errno = tinfo->cancelled;
+    if (res == -ENOSYS) {
+        //等待WRITE事件，连接完成或者超时后恢复
+        int rt = iom->waitEvent(fd, hyn::iomanager::IOManager::WRITE, timout_ms);
+        if (rt == ETIMEDOUT) {
+            errno = ETIMEDOUT;
             return -1;
+        } else if (rt) {
+            error("connect addEvent error fd = %d,WRITE", fd);
         }
-    } else {
-        if (timer)
-            timer->cancel();
-        error("connect addEvent error fd = %d,WRITE", fd);
     }
 
     //当WRITE事件被触发或者定时器超时时，使用getsockopt函数获取套接字选项值。如果选项值为0，则表示连接成功，返回0；否则，
@@ -306,7 +316,13 @@ int connect(int fd, const struct sockaddr *addr, socklen_t addrlen) {
 }
 
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
-    int fd = hyn::do_io(sockfd, accept_f, "accept", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+    auto make_sqe = [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_ACCEPT, sockfd, reinterpret_cast<uint64_t>(addr), 0);
+        sqe.addr2 = reinterpret_cast<uint64_t>(addrlen);
+        return sqe;
+    };
+    int fd = static_cast<int>(hyn::do_io(sockfd, accept_f, "accept", hyn::iomanager::IOManager::READ, SO_RCVTIMEO,
+                                         make_sqe, addr, addrlen));
     if (fd >= 0) {
         hyn::FdMgr::GetInstance()->get(fd, true);
     }
@@ -337,48 +353,102 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
 
 //read
 ssize_t read(int fd, void *buf, size_t count) {
-    return hyn::do_io(fd, read_f, "read", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, buf, count);
+    return hyn::do_io(fd, read_f, "read", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_READ, fd, reinterpret_cast<uint64_t>(buf), count);
+        sqe.off = static_cast<uint64_t>(-1);
+        return sqe;
+    }, buf, count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
-    return hyn::do_io(fd, readv_f, "readv", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+    return hyn::do_io(fd, readv_f, "readv", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_READV, fd, reinterpret_cast<uint64_t>(iov), iovcnt);
+        sqe.off = static_cast<uint64_t>(-1);
+        return sqe;
+    }, iov, iovcnt);
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
-    return hyn::do_io(sockfd, recv_f, "recv", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    return hyn::do_io(sockfd, recv_f, "recv", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_RECV, sockfd, reinterpret_cast<uint64_t>(buf), len);
+        sqe.msg_flags = flags;
+        return sqe;
+    }, buf, len, flags);
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
-    return hyn::do_io(sockfd, recvfrom_f, "recvfrom", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, buf, len, flags,
-                      src_addr, addrlen);
+    return hyn::do_io(sockfd, recvfrom_f, "recvfrom", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, nullptr, buf, len,
+                      flags, src_addr, addrlen);
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
-    return hyn::do_io(sockfd, recvmsg_f, "recvmsg", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, msg, flags);
+    return hyn::do_io(sockfd, recvmsg_f, "recvmsg", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_RECVMSG, sockfd, reinterpret_cast<uint64_t>(msg), 1);
+        sqe.msg_flags = flags;
+        return sqe;
+    }, msg, flags);
 }
 
 //write
 ssize_t write(int fd, const void *buf, size_t count) {
-    return hyn::do_io(fd, write_f, "write", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+    return hyn::do_io(fd, write_f, "write", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_WRITE, fd, reinterpret_cast<uint64_t>(buf), count);
+        sqe.off = static_cast<uint64_t>(-1);
+        return sqe;
+    }, buf, count);
 }
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
-    return hyn::do_io(fd, writev_f, "writev", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+    return hyn::do_io(fd, writev_f, "writev", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_WRITEV, fd, reinterpret_cast<uint64_t>(iov), iovcnt);
+        sqe.off = static_cast<uint64_t>(-1);
+        return sqe;
+    }, iov, iovcnt);
 }
 
 //send
 ssize_t send(int sockfd, const void *buf, size_t len, int flags) {
-    return hyn::do_io(sockfd, send_f, "send", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, buf, len, flags);
+    return hyn::do_io(sockfd, send_f, "send", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_SEND, sockfd, reinterpret_cast<uint64_t>(buf), len);
+        sqe.msg_flags = flags;
+        return sqe;
+    }, buf, len, flags);
 }
 
 ssize_t
 sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
-    return hyn::do_io(sockfd, sendto_f, "sendto", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, buf, len, flags,
-                      dest_addr, addrlen);
+    return hyn::do_io(sockfd, sendto_f, "sendto", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, nullptr, buf, len,
+                      flags, dest_addr, addrlen);
 }
 
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
-    return hyn::do_io(sockfd, sendmsg_f, "sendmsg", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+    return hyn::do_io(sockfd, sendmsg_f, "sendmsg", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, [=] {
+        io_uring_sqe sqe = hyn::make_sqe(IORING_OP_SENDMSG, sockfd, reinterpret_cast<uint64_t>(msg), 1);
+        sqe.msg_flags = flags;
+        return sqe;
+    }, msg, flags);
+}
+
+//zero copy
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return hyn::do_io(out_fd, sendfile_f, "sendfile", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, nullptr, in_fd,
+                      offset, count);
+}
+
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+    //一端是管道，另一端是socket时在socket上等待：从socket读等可读，往socket写等可写
+    if (hyn::s_hook_enable) {
+        auto ctx = hyn::FdMgr::GetInstance()->get(fd_in);
+        if (!ctx || !ctx->is_socket()) {
+            auto fun = [](int out, int in, loff_t *in_off, loff_t *out_off, size_t n, unsigned int f) {
+                return splice_f(in, in_off, out, out_off, n, f);
+            };
+            return hyn::do_io(fd_out, fun, "splice", hyn::iomanager::IOManager::WRITE, SO_SNDTIMEO, nullptr, fd_in,
+                              off_in, off_out, len, flags);
+        }
+    }
+    return hyn::do_io(fd_in, splice_f, "splice", hyn::iomanager::IOManager::READ, SO_RCVTIMEO, nullptr, off_in, fd_out,
+                      off_out, len, flags);
 }
 
 //close
@@ -388,8 +458,10 @@ int close(int fd) {
     auto ctx = hyn::FdMgr::GetInstance()->get(fd);
     if (ctx) {
         auto iom = hyn::iomanager::IOManager::GetThis();
-        if (iom)
+        if (iom) {
             iom->cancelAll(fd);
+            iom->cancelIo(fd);
+        }
         hyn::FdMgr::GetInstance()->del(fd);
     }
     return close_f(fd);
@@ -8,6 +8,9 @@
   ******************************************************************************
   */
 #include "Http.h"
+#include <charconv>
+#include <cstring>
+#include <ctime>
 
 namespace hyn::http {
 
@@ -54,6 +57,35 @@ bool CaseInsensitiveLess::operator()(const std::string &lhs, const std::string &
     return strcasecmp(lhs.c_str(), rhs.c_str()) < 0;
 }
 
+const HeaderFields::Field *HeaderFields::find(std::string_view name, uint32_t hash) const {
+    for (const Field *it = end(); it != begin();) {
+        --it;
+        if (it->hash == hash && it->name.size() == name.size() &&
+            strncasecmp(it->name.data(), name.data(), name.size()) == 0) {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+size_t HeaderFields::erase(std::string_view name) {
+    uint32_t hash = HeaderHash(name);
+    Field *out = begin();
+    for (Field *it = begin(); it != end(); ++it) {
+        if (it->hash == hash && it->name.size() == name.size() &&
+            strncasecmp(it->name.data(), name.data(), name.size()) == 0) {
+            continue;
+        }
+        *out++ = *it;
+    }
+    size_t removed = end() - out;
+    m_size -= removed;
+    if (!m_more.empty()) {
+        m_more.resize(m_size);
+    }
+    return removed;
+}
+
 HttpRequest::HttpRequest(uint8_t version, bool close) : m_autoClose(close), m_isWebSocket(false), m_parserParamFlag(0),
                                                         m_method(HttpMethod::GET), m_version(version), m_path("/") {
 }
@@ -63,9 +95,9 @@ std::shared_ptr<HttpRequest> HttpRequest::creatResponse() {
     return nullptr;
 }
 
-std::string HttpRequest::getHeader(const std::string &key, const std::string &def) const {
-    auto it = m_headers.find(key);
-    return it == m_headers.end() ? def : it->second;
+std::string HttpRequest::getHeader(std::string_view key, const std::string &def) const {
+    auto field = m_fields.find(key);
+    return field ? std::string(field->value) : def;
 }
 
 std::string HttpRequest::getParam(const std::string &key, const std::string &def) {
@@ -80,8 +112,13 @@ std::string HttpRequest::getCookie(const std::string &key, const std::string &de
     return it == m_cookies.end() ? def : it->second;
 }
 
-void HttpRequest::setHeader(const std::string &key, const std::string &value) {
-    m_headers[key] = value;
+void HttpRequest::setHeader(std::string_view key, std::string_view value) {
+    //已经有这个头部时复用它拷贝进来的名字和值
+    const HeaderFields::Field *old = m_fields.find(key);
+    std::string_view name = old ? restore(old->name, key) : store(key);
+    std::string_view val = old ? restore(old->value, value) : store(value);
+    m_fields.erase(key);
+    m_fields.add(name, val);
 }
 
 void HttpRequest::setParam(const std::string &key, const std::string &value) {
@@ -92,8 +129,8 @@ void HttpRequest::setCookie(const std::string &key, const std::string &value) {
     m_cookies[key] = value;
 }
 
-void HttpRequest::delHeader(const std::string &key) {
-    m_headers.erase(key);
+void HttpRequest::delHeader(std::string_view key) {
+    m_fields.erase(key);
 }
 
 void HttpRequest::delParam(const std::string &key) {
@@ -104,13 +141,13 @@ void HttpRequest::delCookie(const std::string &key) {
     m_cookies.erase(key);
 }
 
-bool HttpRequest::hasHeader(const std::string &key, std::string *value) {
-    auto it = m_headers.find(key);
-    if (it == m_headers.end()) {
+bool HttpRequest::hasHeader(std::string_view key, std::string *value) {
+    auto field = m_fields.find(key);
+    if (!field) {
         return false;
     }
     if (value) {
-        *value = it->second;
+        *value = field->value;
     }
     return true;
 }
@@ -153,10 +190,10 @@ std::ostream &HttpRequest::dump(std::ostream &os) const {
        "." << static_cast<uint32_t>(m_version & 0x0f) << "\r\n";
     if (!m_isWebSocket)
         os << "connection: " << (m_autoClose ? "close" : "keep-alive") << "\r\n";
-    for (auto &i: m_headers) {
-        if (!m_isWebSocket && strcasecmp(i.first.c_str(), "connection") == 0)
+    for (auto &i: m_fields) {
+        if (!m_isWebSocket && i.hash == header::CONNECTION && strncasecmp(i.name.data(), "connection", 10) == 0)
             continue;
-        os << i.first << ": " << i.second << "\r\n";
+        os << i.name << ": " << i.value << "\r\n";
     }
     if (!m_body.empty()) {
         os << "connection-length: " << m_body.size() << "\r\n\r\n" << m_body;
@@ -173,9 +210,9 @@ std::string HttpRequest::toString() const {
 }
 
 void HttpRequest::initClose() {
-    std::string conn = getHeader("connection");
+    std::string_view conn = getHeaderView("connection", header::CONNECTION);
     if (!conn.empty()) {
-        if (strcasecmp(conn.c_str(), "keep-alive") == 0) {
+        if (conn.size() == 10 && strncasecmp(conn.data(), "keep-alive", 10) == 0) {
             m_autoClose = false;
         } else {
             m_autoClose = true;
@@ -183,6 +220,46 @@ void HttpRequest::initClose() {
     }
 }
 
+const HttpRequest::MapType &HttpRequest::getHeaders() const {
+    m_headers.clear();
+    for (auto &i: m_fields) {
+        m_headers[std::string(i.name)] = i.value;
+    }
+    return m_headers;
+}
+
+void HttpRequest::setHeaders(const MapType &mHeaders) {
+    m_fields.clear();
+    for (auto &i: mHeaders) {
+        m_fields.add(store(i.first), store(i.second));
+    }
+}
+
+void HttpRequest::detach() {
+    size_t total = m_path.size() + m_query.size() + m_fragment.size();
+    for (auto &i: m_fields) {
+        total += i.name.size() + i.value.size();
+    }
+    //先全部拷到一块新内存，再释放旧的，字段可能引用着旧的m_storage
+    std::forward_list<std::string> storage;
+    std::string &data = storage.emplace_front();
+    data.reserve(total);
+    auto copy = [&data](std::string_view &view) {
+        size_t pos = data.size();
+        data.append(view);
+        view = std::string_view(data.data() + pos, view.size());
+    };
+    copy(m_path);
+    copy(m_query);
+    copy(m_fragment);
+    for (auto &i: m_fields) {
+        copy(i.name);
+        copy(i.value);
+    }
+    m_storage.swap(storage);
+    m_buffer.reset();
+}
+
 void HttpRequest::initPram() {
 
 }
@@ -217,6 +294,141 @@ void HttpResponse::delHeader(const std::string &key) {
     m_headers.erase(key);
 }
 
+namespace {
+
+/**
+ *@brief 预先拼好的状态行"HTTP/1.x code reason\r\n"，下标是[版本][状态码 - 100]
+ */
+struct StatusLines {
+    static constexpr int MIN_CODE = 100;
+    static constexpr int MAX_CODE = 599;
+
+    std::string lines[2][MAX_CODE - MIN_CODE + 1];
+
+    StatusLines() {
+        for (int v = 0; v < 2; ++v) {
+#define XX(code, name, msg) \
+            lines[v][code - MIN_CODE] = std::string(v ? "HTTP/1.1 " : "HTTP/1.0 ") + #code " " #msg "\r\n";
+            HTTP_STATUS_MAP(XX)
+#undef XX
+        }
+    }
+
+    /**
+     *@return 没有预先拼好时返回nullptr
+     */
+    [[nodiscard]] const std::string *find(uint8_t version, HttpStatus status) const {
+        auto code = static_cast<int>(status);
+        if ((version != 0x10 && version != 0x11) || code < MIN_CODE || code > MAX_CODE) {
+            return nullptr;
+        }
+        const std::string &line = lines[version & 0x0F][code - MIN_CODE];
+        return line.empty() ? nullptr : &line;
+    }
+};
+
+const StatusLines s_status_lines;
+
+//序列化时自己加的头部，名字和分隔符一起预先拼好
+constexpr std::string_view CONNECTION_CLOSE = "connection: close\r\n";
+constexpr std::string_view CONNECTION_KEEP_ALIVE = "connection: keep-alive\r\n";
+constexpr std::string_view CONTENT_LENGTH = "content-length: ";
+constexpr std::string_view SET_COOKIE = "Set-Cookie: ";
+constexpr std::string_view DATE = "date: ";
+constexpr std::string_view SEPARATOR = ": ";
+constexpr std::string_view CRLF = "\r\n";
+
+/**
+ *@brief 往调用者的缓冲区里写，放不下时只记长度
+ */
+class HeadWriter {
+public:
+    HeadWriter(char *buf, size_t len) : m_buf(buf), m_len(len) {
+    }
+
+    void append(const char *data, size_t len) {
+        if (m_pos + len <= m_len) {
+            memcpy(m_buf + m_pos, data, len);
+        }
+        m_pos += len;
+    }
+
+    void append(std::string_view str) {
+        append(str.data(), str.size());
+    }
+
+    void append(uint64_t value) {
+        char tmp[20];
+        auto rt = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        append(tmp, rt.ptr - tmp);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return m_pos;
+    }
+
+private:
+    char *m_buf;
+    size_t m_len;
+    size_t m_pos = 0;
+};
+
+/**
+ *@brief 每个线程缓存的日期，秒数变了才重新格式化
+ */
+struct DateCache {
+    time_t second = -1;
+    char buf[32]{};
+    size_t len = 0;
+};
+
+thread_local DateCache t_date;
+
+/**
+ *@brief 写两位十进制数
+ */
+char *FormatTwoDigits(char *p, int value) {
+    p[0] = static_cast<char>('0' + value / 10);
+    p[1] = static_cast<char>('0' + value % 10);
+    return p + 2;
+}
+
+} // namespace
+
+std::string_view HttpDateNow() {
+    time_t now = time(nullptr);
+    if (now != t_date.second) {
+        //IMF-fixdate，不用strftime，免得受locale影响
+        static const char *const days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+        static const char *const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                             "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+        struct tm tm{};
+        gmtime_r(&now, &tm);
+        char *p = t_date.buf;
+        memcpy(p, days[tm.tm_wday], 3);
+        p += 3;
+        *p++ = ',';
+        *p++ = ' ';
+        p = FormatTwoDigits(p, tm.tm_mday);
+        *p++ = ' ';
+        memcpy(p, months[tm.tm_mon], 3);
+        p += 3;
+        *p++ = ' ';
+        p = std::to_chars(p, p + 4, tm.tm_year + 1900).ptr;
+        *p++ = ' ';
+        p = FormatTwoDigits(p, tm.tm_hour);
+        *p++ = ':';
+        p = FormatTwoDigits(p, tm.tm_min);
+        *p++ = ':';
+        p = FormatTwoDigits(p, tm.tm_sec);
+        memcpy(p, " GMT", 4);
+        p += 4;
+        t_date.len = p - t_date.buf;
+        t_date.second = now;
+    }
+    return {t_date.buf, t_date.len};
+}
+
 //HTTP/1.1 200 OK\r\n
 //Content-Type: text/html\r\n
 //Content-Length: 1024\r\n
@@ -224,32 +436,82 @@ void HttpResponse::delHeader(const std::string &key) {
 //...
 //\r\n
 std::ostream &HttpResponse::dump(std::ostream &os) const {
-    os << "HTTP/" << static_cast<uint32_t>((m_version >> 4)) << "." << static_cast<uint32_t>((m_version & 0x0F)) << " "
-       << (uint32_t) m_status << " " << (m_reason.empty() ? HttpStatusToString(m_status) : m_reason) << "\r\n";
+    std::string head;
+    dumpHead(head);
+    return os << head << m_body;
+}
+
+void HttpResponse::dumpHead(std::string &out) const {
+    //大多数响应头部不超过256字节，放不下时按需要的长度再写一次
+    size_t old = out.size();
+    out.resize(old + 256);
+    size_t len = serializeHead(&out[old], 256);
+    if (len > 256) {
+        out.resize(old + len);
+        serializeHead(&out[old], len);
+    }
+    out.resize(old + len);
+}
+
+size_t HttpResponse::serializeHead(char *buf, size_t len) const {
+    HeadWriter writer(buf, len);
+    const std::string *line = m_reason.empty() ? s_status_lines.find(m_version, m_status) : nullptr;
+    if (line) {
+        writer.append(*line);
+    } else {
+        writer.append("HTTP/", 5);
+        writer.append(static_cast<uint64_t>(m_version >> 4));
+        writer.append(".", 1);
+        writer.append(static_cast<uint64_t>(m_version & 0x0F));
+        writer.append(" ", 1);
+        writer.append(static_cast<uint64_t>(m_status));
+        writer.append(" ", 1);
+        writer.append(m_reason.empty() ? std::string_view(HttpStatusToString(m_status)) : m_reason);
+        writer.append(CRLF);
+    }
     for (auto &i: m_headers) {
         if (!m_websocket && strcasecmp(i.first.c_str(), "connection") == 0) {
             continue;
         }
-        os << i.first << ": " << i.second << "\r\n";
+        writer.append(i.first);
+        writer.append(SEPARATOR);
+        writer.append(i.second);
+        writer.append(CRLF);
     }
     for (auto &i: m_cookies) {
-        os << "Set-Cookie: " << i << "\r\n";
+        writer.append(SET_COOKIE);
+        writer.append(i);
+        writer.append(CRLF);
+    }
+    if (m_sendDate) {
+        writer.append(DATE);
+        writer.append(HttpDateNow());
+        writer.append(CRLF);
     }
     if (!m_websocket) {
-        os << "connection: " << (m_autoClose ? "close" : "keep-alive") << "\r\n";
+        writer.append(m_autoClose ? CONNECTION_CLOSE : CONNECTION_KEEP_ALIVE);
     }
     if (!m_body.empty()) {
-        os << "content-length: " << m_body.size() << "\r\n\r\n"
-           << m_body;
-    } else {
-        os << "\r\n";
+        writer.append(CONTENT_LENGTH);
+        writer.append(static_cast<uint64_t>(m_body.size()));
+        writer.append(CRLF);
     }
-    return os;
+    writer.append(CRLF);
+    return writer.size();
+}
+
+size_t HttpResponse::serialize(char *buf, size_t len) const {
+    size_t head = serializeHead(buf, len);
+    if (head + m_body.size() <= len) {
+        memcpy(buf + head, m_body.data(), m_body.size());
+    }
+    return head + m_body.size();
 }
 
 std::string HttpResponse::toString() const {
-    std::stringstream ss;
-    dump(ss);
-    return ss.str();
+    std::string str;
+    dumpHead(str);
+    str.append(m_body);
+    return str;
 }
-} // hyn::http
\ No newline at end of file
+} // hyn::http
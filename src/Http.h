@@ -11,12 +11,18 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <forward_list>
 #include <map>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <boost/lexical_cast.hpp>
 
+namespace hyn {
+class Stream;
+}
+
 namespace hyn::http {
 
 /* Request Methods */
@@ -183,6 +189,12 @@ const char *HttpMethodToString(const HttpMethod &httpMethod);
  */
 const char *HttpStatusToString(const HttpStatus &httpStatus);
 
+/**
+ * @brief 当前时间的HTTP日期，如"Sat, 10 Jun 2023 08:49:37 GMT"
+ * @attention 每个线程缓存一份，同一秒内不重新格式化；返回值到这个线程下次调用前有效
+ */
+std::string_view HttpDateNow();
+
 /**
  *@brief 忽略大小写比较字符串的仿函数
  */
@@ -227,7 +239,7 @@ bool checkGetAs(const MapType &m, const std::string &key, T &value, const T &def
         return false;
     }
     try {
-        value = boost::lexical_cast<T>(it->second());
+        value = boost::lexical_cast<T>(it->second);
         return true;
     } catch (...) {
         value = def;
@@ -235,6 +247,130 @@ bool checkGetAs(const MapType &m, const std::string &key, T &value, const T &def
     return false;
 }
 
+/**
+ *@brief 头部名字的哈希，忽略大小写(FNV-1a)，常用头部可以在编译期算好
+ */
+constexpr uint32_t HeaderHash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c: name) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ *@brief 常用头部名字的哈希
+ */
+namespace header {
+constexpr uint32_t CONNECTION = HeaderHash("connection");
+constexpr uint32_t CONTENT_LENGTH = HeaderHash("content-length");
+constexpr uint32_t CONTENT_TYPE = HeaderHash("content-type");
+constexpr uint32_t HOST = HeaderHash("host");
+constexpr uint32_t TRANSFER_ENCODING = HeaderHash("transfer-encoding");
+constexpr uint32_t UPGRADE = HeaderHash("upgrade");
+} // header
+
+/**
+ *@brief 平铺存放的头部字段，名字和值都是string_view，不超过INLINE_SIZE个时不分配内存
+ *@attention 不管理字段指向的内存；同名字段按出现顺序保存，查找时后出现的优先
+ */
+class HeaderFields {
+public:
+    struct Field {
+        std::string_view name;
+        std::string_view value;
+        ///HeaderHash(name)
+        uint32_t hash;
+    };
+
+    static constexpr size_t INLINE_SIZE = 16;
+
+    HeaderFields() = default;
+
+    HeaderFields(const HeaderFields &) = delete;
+
+    HeaderFields &operator=(const HeaderFields &) = delete;
+
+    /**
+     *@brief 追加一个字段，不检查重名
+     */
+    void add(std::string_view name, std::string_view value, uint32_t hash) {
+        if (m_more.empty()) {
+            if (m_size < INLINE_SIZE) {
+                m_inline[m_size++] = {name, value, hash};
+                return;
+            }
+            m_more.reserve(INLINE_SIZE * 2);
+            m_more.assign(m_inline, m_inline + m_size);
+        }
+        m_more.push_back({name, value, hash});
+        ++m_size;
+    }
+
+    void add(std::string_view name, std::string_view value) {
+        add(name, value, HeaderHash(name));
+    }
+
+    /**
+     *@brief 查找名字为name的字段，hash必须是HeaderHash(name)
+     */
+    [[nodiscard]] const Field *find(std::string_view name, uint32_t hash) const;
+
+    Field *find(std::string_view name, uint32_t hash) {
+        return const_cast<Field *>(static_cast<const HeaderFields *>(this)->find(name, hash));
+    }
+
+    [[nodiscard]] const Field *find(std::string_view name) const {
+        return find(name, HeaderHash(name));
+    }
+
+    /**
+     *@brief 删除所有名字为name的字段，保持其余字段的顺序
+     *@return 删除的个数
+     */
+    size_t erase(std::string_view name);
+
+    void clear() {
+        m_size = 0;
+        m_more.clear();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return m_size;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return m_size == 0;
+    }
+
+    Field *begin() {
+        return m_more.empty() ? m_inline : m_more.data();
+    }
+
+    Field *end() {
+        return begin() + m_size;
+    }
+
+    [[nodiscard]] const Field *begin() const {
+        return m_more.empty() ? m_inline : m_more.data();
+    }
+
+    [[nodiscard]] const Field *end() const {
+        return begin() + m_size;
+    }
+
+private:
+    ///字段数
+    size_t m_size = 0;
+    ///前INLINE_SIZE个字段
+    Field m_inline[INLINE_SIZE];
+    ///超过INLINE_SIZE后所有字段都搬到这里
+    std::vector<Field> m_more;
+};
+
 class HttpRequest {
 public:
     using ptr = std::shared_ptr<HttpRequest>;
@@ -247,6 +383,10 @@ public:
      */
     explicit HttpRequest(uint8_t version = 0x11, bool close = true);
 
+    HttpRequest(const HttpRequest &) = delete;
+
+    HttpRequest &operator=(const HttpRequest &) = delete;
+
     /**
      *@brief 创建一个与该请求相关联的响应对象
      */
@@ -258,7 +398,22 @@ public:
     * @param[in] def 默认值
     * @return 如果存在则返回对应值,否则返回默认值
     */
-    [[nodiscard]] std::string getHeader(const std::string &key, const std::string &def = "") const;
+    [[nodiscard]] std::string getHeader(std::string_view key, const std::string &def = "") const;
+
+    /**
+     *@brief 获取HTTP请求的头部参数，不拷贝
+     *@param key 关键字
+     *@param hash HeaderHash(key)，常用头部用header::里算好的值
+     *@return 不存在时返回空
+     */
+    [[nodiscard]] std::string_view getHeaderView(std::string_view key, uint32_t hash) const {
+        auto field = m_fields.find(key, hash);
+        return field ? field->value : std::string_view();
+    }
+
+    [[nodiscard]] std::string_view getHeaderView(std::string_view key) const {
+        return getHeaderView(key, HeaderHash(key));
+    }
 
     /**
     * @brief 获取HTTP请求的参数
@@ -282,7 +437,15 @@ public:
      * @param[in] key 关键字
      * @param[in] val 值
      */
-    void setHeader(const std::string &key, const std::string &value);
+    void setHeader(std::string_view key, std::string_view value);
+
+    /**
+     *@brief 追加一个头部参数，只保存引用，不拷贝
+     *@attention name和value指向的内存要在请求的生命周期内有效，见holdBuffer
+     */
+    void addHeaderRef(std::string_view name, std::string_view value) {
+        m_fields.add(name, value);
+    }
 
 
     /**
@@ -303,7 +466,7 @@ public:
     * @brief 删除HTTP请求的头部参数
     * @param[in] key 关键字
     */
-    void delHeader(const std::string &key);
+    void delHeader(std::string_view key);
 
     /**
     * @brief 删除HTTP请求的参数
@@ -323,7 +486,7 @@ public:
      * @param[out] val 如果存在,val非空则赋值
      * @return 是否存在
      */
-    bool hasHeader(const std::string &key, std::string *value = nullptr);
+    bool hasHeader(std::string_view key, std::string *value = nullptr);
 
     /**
      * @brief 判断HTTP请求的参数是否存在
@@ -349,8 +512,13 @@ public:
      *@return 如果存在且转换成功返回true，否则false
      */
     template<typename T>
-    bool checkGetHeaderAs(const std::string &key, T &value, const T &def = T()) {
-        return checkGetAs(m_headers, key, value, def);
+    bool checkGetHeaderAs(std::string_view key, T &value, const T &def = T()) {
+        auto field = m_fields.find(key);
+        if (field && boost::conversion::try_lexical_convert(field->value.data(), field->value.size(), value)) {
+            return true;
+        }
+        value = def;
+        return false;
     }
 
     /**
@@ -361,8 +529,10 @@ public:
     * @return 如果存在且转换成功返回对应的值,否则返回def
     */
     template<class T>
-    T getHeaderAs(const std::string &key, const T &def = T()) {
-        return getAs(m_headers, key, def);
+    T getHeaderAs(std::string_view key, const T &def = T()) {
+        T value;
+        checkGetHeaderAs(key, value, def);
+        return value;
     }
 
     /**
@@ -388,6 +558,18 @@ public:
 
     void initCookies();
 
+    /**
+     *@brief 持有接收缓冲区，请求里引用的路径、头部在请求释放前一直有效
+     */
+    void holdBuffer(std::shared_ptr<char> buffer) {
+        m_buffer = std::move(buffer);
+    }
+
+    /**
+     *@brief 把路径、参数和头部引用的内容拷贝到请求自己的内存里，之后可以复用接收缓冲区
+     */
+    void detach();
+
 public:
     /****************       Getter and Setter       ****************/
 
@@ -431,27 +613,48 @@ public:
         m_version = mVersion;
     }
 
-    [[nodiscard]] const std::string &getPath() const {
+    [[nodiscard]] std::string_view getPath() const {
         return m_path;
     }
 
-    void setPath(const std::string &mPath) {
+    void setPath(std::string_view mPath) {
+        m_path = restore(m_path, mPath);
+    }
+
+    /**
+     *@brief 只保存引用，不拷贝
+     */
+    void setPathRef(std::string_view mPath) {
         m_path = mPath;
     }
 
-    [[nodiscard]] const std::string &getQuery() const {
+    [[nodiscard]] std::string_view getQuery() const {
         return m_query;
     }
 
-    void setQuery(const std::string &mQuery) {
+    void setQuery(std::string_view mQuery) {
+        m_query = restore(m_query, mQuery);
+    }
+
+    /**
+     *@brief 只保存引用，不拷贝
+     */
+    void setQueryRef(std::string_view mQuery) {
         m_query = mQuery;
     }
 
-    [[nodiscard]] const std::string &getFragment() const {
+    [[nodiscard]] std::string_view getFragment() const {
         return m_fragment;
     }
 
-    void setFragment(const std::string &mFragment) {
+    void setFragment(std::string_view mFragment) {
+        m_fragment = restore(m_fragment, mFragment);
+    }
+
+    /**
+     *@brief 只保存引用，不拷贝
+     */
+    void setFragmentRef(std::string_view mFragment) {
         m_fragment = mFragment;
     }
 
@@ -463,12 +666,27 @@ public:
         m_body = mBody;
     }
 
-    [[nodiscard]] const MapType &getHeaders() const {
-        return m_headers;
+    /**
+     *@brief 消息体太大或者是chunked编码时不读进getBody()，由这个流按需从连接上读，读完返回0
+     *@return 消息体已经在getBody()里时为空
+     */
+    [[nodiscard]] const std::shared_ptr<Stream> &getBodyStream() const {
+        return m_bodyStream;
     }
 
-    void setHeaders(const MapType &mHeaders) {
-        m_headers = mHeaders;
+    void setBodyStream(const std::shared_ptr<Stream> &mBodyStream) {
+        m_bodyStream = mBodyStream;
+    }
+
+    /**
+     *@brief 头部转成MAP，每次调用都重新生成，重名时取最后一个
+     */
+    [[nodiscard]] const MapType &getHeaders() const;
+
+    void setHeaders(const MapType &mHeaders);
+
+    [[nodiscard]] const HeaderFields &getHeaderFields() const {
+        return m_fields;
     }
 
     [[nodiscard]] const MapType &getParams() const {
@@ -487,6 +705,30 @@ public:
         m_cookies = mCookies;
     }
 
+private:
+    /**
+     *@brief 拷贝一份str，返回指向拷贝的string_view
+     */
+    std::string_view store(std::string_view str) {
+        return m_storage.emplace_front(str);
+    }
+
+    /**
+     *@brief 用str替换old：old是之前store单独拷贝出来的就在原来的位置覆盖，否则新拷贝一份
+     *@note 反复设置同一个值时m_storage不会一直增长
+     */
+    std::string_view restore(std::string_view old, std::string_view str) {
+        if (!old.empty()) {
+            for (auto &i: m_storage) {
+                if (i.data() == old.data() && i.size() == old.size()) {
+                    i.assign(str);
+                    return i;
+                }
+            }
+        }
+        return store(str);
+    }
+
 private:
     //https://www.example.com:8080/index.html?search=keyword#section1
     //协议为HTTPS，主机名为www.example.com，端口号为8080，路径为/index.html，查询参数为search=keyword，片段标识符为section1。
@@ -502,15 +744,23 @@ private:
     ///HTTP版本：1.0:0x10 1.1:0x11 ......
     uint8_t m_version;
     ///请求路径
-    std::string m_path;
+    std::string_view m_path;
     ///请求参数
-    std::string m_query{};
+    std::string_view m_query{};
     ///片段标识符（请求fragment）
-    std::string m_fragment{};
+    std::string_view m_fragment{};
     ///请求消息体
     std::string m_body{};
-    ///请求头部 MAP
-    MapType m_headers;
+    ///流式读取的消息体
+    std::shared_ptr<Stream> m_bodyStream;
+    ///请求头部，解析时直接引用接收缓冲区
+    HeaderFields m_fields;
+    ///getHeaders()生成的MAP
+    mutable MapType m_headers;
+    ///解析时用的接收缓冲区
+    std::shared_ptr<char> m_buffer;
+    ///setXXX拷贝进来的内容，节点地址不变
+    std::forward_list<std::string> m_storage;
     ///请求参数 MAP
     MapType m_params;
     ///请求Cookie MAP
@@ -553,6 +803,24 @@ public:
      */
     std::ostream &dump(std::ostream &os) const;
 
+    /**
+     *@brief 把状态行和头部(包括结尾的空行)追加到out，不包括消息体
+     *@note 发送时消息体直接引用getBody()，不拷贝
+     */
+    void dumpHead(std::string &out) const;
+
+    /**
+     *@brief 把状态行和头部写进buf，不包括消息体
+     *@return 需要的长度，大于len时buf里的内容不完整，换一块足够大的再调用
+     */
+    size_t serializeHead(char *buf, size_t len) const;
+
+    /**
+     *@brief 把整个响应(包括消息体)写进buf
+     *@return 需要的长度，大于len时buf里的内容不完整
+     */
+    size_t serialize(char *buf, size_t len) const;
+
     /**
      *@brief 转成字符串
      */
@@ -616,6 +884,17 @@ public:
         m_websocket = mWebsocket;
     }
 
+    [[nodiscard]] bool isSendDate() const {
+        return m_sendDate;
+    }
+
+    /**
+     *@brief 序列化时是否加上当前时间的date头部
+     */
+    void setSendDate(bool mSendDate) {
+        m_sendDate = mSendDate;
+    }
+
     [[nodiscard]] const std::string &getBody() const {
         return m_body;
     }
@@ -656,6 +935,8 @@ private:
     bool m_autoClose;
     ///是否websocket
     bool m_websocket{false};
+    ///是否发送date头部
+    bool m_sendDate{false};
     ///消息体
     std::string m_body{};
     ///原因
@@ -18,6 +18,10 @@ namespace hyn::http {
 static uint64_t s_http_request_buffer_size = 0;
 ///限制HTTP请求最大正文大小
 static uint64_t s_http_request_max_body_size = 0;
+///HTTP请求消息体超过这个大小时不整个读进内存
+static uint64_t s_http_request_stream_body_size = 0;
+///新建的HttpRequestParser使用的实现
+static HttpRequestParser::Backend s_http_request_backend = HttpRequestParser::Backend::SIMD;
 ///限制HTTP响应的缓冲区大小
 static uint64_t s_http_response_buffer_size = 0;
 ///限制HTTP响应的最大正文大小
@@ -31,6 +35,7 @@ struct RequestSizeIniter {
         s_http_request_buffer_size = 4096;
         //int b = hyn::singleton::Singleton<hyn::ini::IniFile>::get_instance()->get("HTTP", "request_max_body_size");
         s_http_request_max_body_size = 67108864;
+        s_http_request_stream_body_size = 65536;
         //int c = hyn::singleton::Singleton<hyn::ini::IniFile>::get_instance()->get("HTTP", "response_buffer_size");
         s_http_response_buffer_size = 4096;
         //int d = hyn::singleton::Singleton<hyn::ini::IniFile>::get_instance()->get("HTTP", "response_max_body_size");
@@ -40,7 +45,7 @@ struct RequestSizeIniter {
 
 static RequestSizeIniter init;
 
-HttpRequestParser::HttpRequestParser() : m_error(0) {
+HttpRequestParser::HttpRequestParser() : m_backend(s_http_request_backend), m_error(0) {
     m_data.reset(new hyn::http::HttpRequest);
     http_parser_init(&m_parser);
     m_parser.request_method = on_request_method;
@@ -54,17 +59,55 @@ HttpRequestParser::HttpRequestParser() : m_error(0) {
     m_parser.data = this;
 }
 
+void HttpRequestParser::reset() {
+    m_error = 0;
+    m_scan = simd::ScanState();
+    m_simdDone = false;
+    m_fallback = false;
+    m_data.reset(new hyn::http::HttpRequest);
+    http_parser_init(&m_parser);
+}
+
 
 size_t HttpRequestParser::execute(char *data, size_t len) {
     //http_parser_execute函数返回一个size_t类型的值，表示解析器实际处理的数据长度。在函数内部，该值被保存在offset变量中。
-    size_t offset = http_parser_execute(&m_parser, data, len, 0);
+    size_t offset = parse(data, len, 0);
+    //请求引用着data，下面会覆盖已解析的部分，先拷出来
+    m_data->detach();
 
     //接下来，函数调用memmove函数，将缓冲区中未被解析的数据向前移动（覆盖已经解析过的数据）。这样，下一次解析时就可以继续从缓冲区剩余的数据开始解析。
     memmove(data, data + offset, (len - offset));
     return offset;
 }
 
+size_t HttpRequestParser::execute(const char *data, size_t len, size_t off) {
+    return parse(data, len, off);
+}
+
+size_t HttpRequestParser::parse(const char *data, size_t len, size_t off) {
+    if (m_backend == Backend::RAGEL || m_fallback) {
+        return http_parser_execute(&m_parser, data, len, off);
+    }
+    if (m_simdDone) {
+        return 0;
+    }
+    //快速路径在请求头完整之前不消费数据，off总是0
+    int64_t rt = simd::ParseRequest(&m_parser, data, len, m_scan);
+    if (rt > 0) {
+        m_simdDone = true;
+        return rt;
+    }
+    if (rt == simd::INCOMPLETE) {
+        return 0;
+    }
+    m_fallback = true;
+    return http_parser_execute(&m_parser, data, len, 0);
+}
+
 int HttpRequestParser::isFinished() {
+    if (m_simdDone) {
+        return 1;
+    }
     return http_parser_finish(&m_parser);
 }
 
@@ -84,13 +127,25 @@ uint64_t HttpRequestParser::GetHttpRequestMaxBodySize() {
     return s_http_request_max_body_size;
 }
 
+uint64_t HttpRequestParser::GetHttpRequestStreamBodySize() {
+    return s_http_request_stream_body_size;
+}
+
+void HttpRequestParser::SetDefaultBackend(Backend backend) {
+    s_http_request_backend = backend;
+}
+
+HttpRequestParser::Backend HttpRequestParser::GetDefaultBackend() {
+    return s_http_request_backend;
+}
+
 void on_request_http_field(void *data, const char *field, size_t flen, const char *value, size_t vlen) {
     auto *parser = static_cast<HttpRequestParser *>(data);
     if (flen == 0) {
         warn("invalid http request field length == 0");
         return;
     }
-    parser->getData()->setHeader(std::string(field, flen), std::string(value, vlen));
+    parser->getData()->addHeaderRef(std::string_view(field, flen), std::string_view(value, vlen));
 }
 
 void on_request_method(void *data, const char *at, size_t length) {
@@ -110,17 +165,17 @@ void on_request_uri(void *data, const char *at, size_t length) {
 
 void on_request_fragment(void *data, const char *at, size_t length) {
     auto *parser = static_cast<HttpRequestParser *>(data);
-    parser->getData()->setFragment(std::string(at, length));
+    parser->getData()->setFragmentRef(std::string_view(at, length));
 }
 
 void on_request_path(void *data, const char *at, size_t length) {
     auto *parser = static_cast<HttpRequestParser *>(data);
-    parser->getData()->setPath(std::string(at, length));
+    parser->getData()->setPathRef(std::string_view(at, length));
 }
 
 void on_request_query_string(void *data, const char *at, size_t length) {
     auto *parser = static_cast<HttpRequestParser *>(data);
-    parser->getData()->setQuery(std::string(at, length));
+    parser->getData()->setQueryRef(std::string_view(at, length));
 }
 
 void on_request_http_version(void *data, const char *at, size_t length) {
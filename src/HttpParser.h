@@ -11,6 +11,7 @@
 #pragma once
 
 #include "Http.h"
+#include "HttpSimdParser.h"
 #include "http11_parser.h"
 #include "httpclient_parser.h"
 
@@ -24,11 +25,26 @@ class HttpRequestParser {
 public:
     using ptr = std::shared_ptr<HttpRequestParser>;
 
+    /**
+     *@brief 请求头的解析实现
+     */
+    enum class Backend {
+        ///ragel生成的状态机
+        RAGEL,
+        ///SIMD快速路径，遇到不常见的格式自动交给ragel
+        SIMD,
+    };
+
     /**
      *@brief 构造函数
      */
     HttpRequestParser();
 
+    /**
+     * @brief 重置状态，准备解析下一个请求(换一个新的HttpRequest)
+     */
+    void reset();
+
     /**
      * @brief 解析HTTP响应协议
      * @param[in, out] data 协议数据内存
@@ -38,6 +54,17 @@ public:
      */
     size_t execute(char *data, size_t len);
 
+    /**
+     * @brief 从data + off继续解析HTTP请求，不移动数据
+     * @param[in] data 到目前为止收到的全部数据
+     * @param[in] len data的长度
+     * @param[in] off 之前已经解析过的长度
+     * @return 这次解析的长度
+     * @attention 请求的路径、头部直接引用data，请求使用期间data不能释放或改写，
+     *            否则先调用HttpRequest::detach
+     */
+    size_t execute(const char *data, size_t len, size_t off);
+
     /**
      * @brief 是否解析完成
      */
@@ -63,7 +90,37 @@ public:
      */
     static uint64_t GetHttpRequestMaxBodySize();
 
+    /**
+     * @brief 返回HTTP请求消息体超过多大时改成流式读取
+     */
+    static uint64_t GetHttpRequestStreamBodySize();
+
+    /**
+     * @brief 设置之后新建的解析器使用的实现，默认SIMD
+     */
+    static void SetDefaultBackend(Backend backend);
+
+    static Backend GetDefaultBackend();
+
     /***************** getter and setter *****************/
+    [[nodiscard]] Backend getBackend() const {
+        return m_backend;
+    }
+
+    /**
+     * @brief 换实现，只能在开始解析一个请求之前调用
+     */
+    void setBackend(Backend backend) {
+        m_backend = backend;
+    }
+
+    /**
+     * @brief 当前请求是否由SIMD快速路径解析完成
+     */
+    [[nodiscard]] bool isSimdParsed() const {
+        return m_simdDone;
+    }
+
     [[nodiscard]] const http_parser &getParser() const {
         return m_parser;
     }
@@ -88,9 +145,23 @@ public:
         m_error = mError;
     }
 
+private:
+    /**
+     * @brief 按m_backend解析，SIMD不认识的请求从头交给ragel
+     */
+    size_t parse(const char *data, size_t len, size_t off);
+
 private:
     /// http_parser
     http_parser m_parser{};
+    /// 使用的实现
+    Backend m_backend;
+    /// SIMD快速路径的扫描进度
+    simd::ScanState m_scan;
+    /// SIMD快速路径已经解析完当前请求
+    bool m_simdDone = false;
+    /// 当前请求已经交给ragel
+    bool m_fallback = false;
     /// HttpRequest结构
     HttpRequest::ptr m_data;
     /// 错误码
@@ -40,12 +40,15 @@ void HttpServer::handleClient(const Socket::ptr &client) {
         }
         http::HttpResponse::ptr rsp(new http::HttpResponse(req->getVersion(), req->isAutoClose() || !m_isKeepalive));
         rsp->setHeader("Server", getName());
+        rsp->setSendDate(true);
         m_dispatch->handle(req, rsp, session);
-        session->sendResponse(rsp);
-        if (!m_isKeepalive || req->isAutoClose()) {
+        //pipeline的请求的响应攒起来，recvRequest要阻塞读之前一起发出去；servlet用beginResponse流式发送时这里结束消息体
+        session->queueResponse(rsp);
+        if (!m_isKeepalive || req->isAutoClose() || rsp->isAutoClose()) {
             break;
         }
     }
+    session->flushResponses();
     session->close();
 }
 } // hyn
\ No newline at end of file
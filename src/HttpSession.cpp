@@ -13,6 +13,9 @@
 #include "HttpSession.h"
 #include "HttpParser.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <utility>
 
 namespace hyn {
@@ -20,66 +23,455 @@ using namespace http;
 HttpSession::HttpSession(Socket::ptr sock, bool owner) : SocketStream(std::move(sock), owner) {
 }
 
+HttpSession::~HttpSession() {
+    if (m_bodyReader) {
+        m_bodyReader->m_session = nullptr;
+    }
+    if (m_bodyWriter) {
+        m_bodyWriter->m_session = nullptr;
+    }
+}
+
 http::HttpRequest::ptr HttpSession::recvRequest() {
-    HttpRequestParser::ptr parser(new HttpRequestParser);
+    finishStreamResponse();
+    if (m_bodyReader) {
+        //上一个请求的消息体没读完，读出来丢掉
+        m_bodyReader->close();
+        bool done = m_bodyReader->isDone();
+        m_bodyReader->m_session = nullptr;
+        m_bodyReader.reset();
+        if (!done) {
+            flushResponses();
+            close();
+            return nullptr;
+        }
+    }
     auto buff_size = HttpRequestParser::GetHttpRequestBufferSize();
-    std::shared_ptr<char> buffer(new char[buff_size], [](char *p) {
-        delete[] p;
-    });
-    char *data = buffer.get();
-    int offset = 0;
-    for (;;) {
-        int len = read(data + offset, buff_size - offset);
-        if (len <= 0) {
+    if (!m_buffer) {
+        m_buffer.reset(new char[buff_size], [](char *p) {
+            delete[] p;
+        });
+        m_parser.reset(new HttpRequestParser);
+    } else {
+        m_parser->reset();
+    }
+    if (m_begin == m_end && m_buffer.use_count() == 1) {
+        m_begin = m_end = 0;
+    }
+    //解析从m_begin开始，请求头引用着缓冲区，解析过程中不挪动数据
+    size_t parsed = 0;
+    if (m_begin != m_end) {
+        parsed = m_parser->execute(m_buffer.get() + m_begin, m_end - m_begin, 0);
+    }
+    while (!m_parser->isFinished()) {
+        if (m_parser->hasError()) {
+            flushResponses();
             close();
             return nullptr;
         }
-        len += offset;
-        auto npar = parser->execute(data, len);
-        if (parser->hasError()) {
+        if (m_end == buff_size) {
+            if (m_begin == 0) { //请求过大
+                flushResponses();
+                close();
+                return nullptr;
+            }
+            //已经记下的字段指向挪动前的位置，挪完从头重新解析
+            compactBuffer();
+            m_parser->reset();
+            parsed = m_parser->execute(m_buffer.get(), m_end, 0);
+            continue;
+        }
+        if (!flushBeforeRead()) {
             close();
             return nullptr;
         }
-        offset = len - npar;
-        if (offset == buff_size) { //请求过大
+        int len = read(m_buffer.get() + m_end, buff_size - m_end);
+        if (len <= 0) {
             close();
             return nullptr;
         }
-        if (parser->isFinished())
-            break;
+        m_end += len;
+        parsed += m_parser->execute(m_buffer.get() + m_begin, m_end - m_begin, parsed);
+    }
+    if (m_parser->hasError()) {
+        flushResponses();
+        close();
+        return nullptr;
     }
-    int64_t length = parser->getContentLength();
-    if (length > 0) {
+    auto request = m_parser->getData();
+    char *data = m_buffer.get() + m_begin + parsed;
+    m_begin += parsed;
+    int64_t length = m_parser->getContentLength();
+    std::string_view encoding = request->getHeaderView("transfer-encoding", header::TRANSFER_ENCODING);
+    bool chunked = encoding.size() >= 7 && strncasecmp(encoding.data() + encoding.size() - 7, "chunked", 7) == 0;
+    if (chunked || length > (int64_t) HttpRequestParser::GetHttpRequestStreamBodySize()) {
+        //大的消息体留在socket里，servlet边读边处理
+        m_bodyReader = std::make_shared<HttpBodyReader>(this, chunked, length);
+        request->setBodyStream(m_bodyReader);
+    } else if (length > 0) {
+        //缓冲区里已经有的部分直接拷贝，剩下的直接读进消息体
         std::string body;
         body.resize(length);
-
-        int len = 0;
-        if (length >= offset) {
-            memcpy(&body[0], data, offset);
-            len = offset;
-        } else {
-            memcpy(&body[0], data, length);
-            len = length;
-        }
-        length -= offset;
-        if (length > 0) {
-            if (readFixSize(&body[len], length) <= 0) {
+        size_t len = std::min<size_t>(length, m_end - m_begin);
+        memcpy(&body[0], data, len);
+        m_begin += len;
+        if (length > (int64_t) len) {
+            if (!flushBeforeRead()) {
+                close();
+                return nullptr;
+            }
+            if (readFixSize(&body[len], length - len) <= 0) {
                 close();
                 return nullptr;
             }
         }
-        parser->getData()->setBody(body);
+        request->setBody(body);
     }
 
-    parser->getData()->initClose();
-    return parser->getData();
+    request->initClose();
+    request->holdBuffer(m_buffer);
+    return request;
+}
 
+void HttpSession::compactBuffer() {
+    size_t left = m_end - m_begin;
+    if (m_buffer.use_count() > 1) {
+        //之前返回的请求还引用着旧缓冲区，不能覆盖
+        std::shared_ptr<char> buffer(new char[HttpRequestParser::GetHttpRequestBufferSize()], [](char *p) {
+            delete[] p;
+        });
+        memcpy(buffer.get(), m_buffer.get() + m_begin, left);
+        m_buffer.swap(buffer);
+    } else {
+        memmove(m_buffer.get(), m_buffer.get() + m_begin, left);
+    }
+    m_begin = 0;
+    m_end = left;
+}
+
+bool HttpSession::readLine(std::string_view &line) {
+    auto buff_size = HttpRequestParser::GetHttpRequestBufferSize();
+    size_t searched = m_begin;
+    for (;;) {
+        char *data = m_buffer.get();
+        auto *end = static_cast<char *>(memmem(data + searched, m_end - searched, "\r\n", 2));
+        if (end) {
+            line = std::string_view(data + m_begin, end - data - m_begin);
+            m_begin = end + 2 - data;
+            return true;
+        }
+        //最后一个字节可能是\r
+        searched = std::max(m_begin, m_end ? m_end - 1 : 0);
+        if (m_end == buff_size) {
+            if (m_begin == 0) {
+                return false;
+            }
+            searched -= m_begin;
+            compactBuffer();
+        }
+        if (!flushBeforeRead()) {
+            return false;
+        }
+        int len = read(m_buffer.get() + m_end, buff_size - m_end);
+        if (len <= 0) {
+            return false;
+        }
+        m_end += len;
+    }
+}
+
+std::shared_ptr<HttpBodyWriter> HttpSession::beginResponse(const http::HttpResponse::ptr &rsp) {
+    finishStreamResponse();
+    bool chunked = rsp->getHeader("content-length").empty();
+    if (chunked) {
+        if (rsp->getVersion() < 0x11) {
+            //没有长度也不能分块，只能靠关闭连接表示结束
+            rsp->setAutoClose(true);
+            chunked = false;
+        } else {
+            rsp->setHeader("Transfer-Encoding", "chunked");
+        }
+    }
+    //已经设置的消息体作为流的第一段发出去，不能让dumpHead按它再写一个content-length
+    std::string body;
+    if (!rsp->getBody().empty()) {
+        body = rsp->getBody();
+        rsp->setBody("");
+    }
+    //前面pipeline的响应先发出去，保证顺序
+    if (!m_pending.empty() && flushResponses() <= 0) {
+        return nullptr;
+    }
+    m_head.clear();
+    rsp->dumpHead(m_head);
+    if (writeFixSize(m_head.data(), m_head.size()) <= 0) {
+        return nullptr;
+    }
+    m_streamResponse = rsp;
+    m_bodyWriter = std::make_shared<HttpBodyWriter>(this, chunked);
+    if (!body.empty()) {
+        iovec iov{body.data(), body.size()};
+        if (m_bodyWriter->writeFixSize(&iov, 1) <= 0) {
+            finishStreamResponse();
+            return nullptr;
+        }
+    }
+    return m_bodyWriter;
+}
+
+void HttpSession::finishStreamResponse() {
+    if (m_bodyWriter) {
+        m_bodyWriter->close();
+        m_bodyWriter->m_session = nullptr;
+        m_bodyWriter.reset();
+    }
+    m_streamResponse.reset();
 }
 
 int HttpSession::sendResponse(http::HttpResponse::ptr rsp) {
-    std::stringstream ss;
-    ss << rsp->toString();
-    std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+    queueResponse(rsp);
+    return flushResponses();
 }
+
+void HttpSession::queueResponse(const http::HttpResponse::ptr &rsp) {
+    if (m_streamResponse && rsp == m_streamResponse) {
+        //头部和消息体已经发过了
+        finishStreamResponse();
+        return;
+    }
+    if (m_pending.empty()) {
+        m_head.clear();
+        m_headEnds.clear();
+    }
+    rsp->dumpHead(m_head);
+    m_headEnds.push_back(m_head.size());
+    m_pending.push_back(rsp);
+    if (m_pending.size() >= MAX_PENDING) {
+        flushResponses();
+    }
+}
+
+int HttpSession::flushResponses() {
+    if (m_pending.empty()) {
+        return 0;
+    }
+    //m_head在攒的过程中可能扩容，到发送时才取地址；连续的没有消息体的响应，头部合成一个iovec
+    m_iovs.clear();
+    size_t head_begin = 0;
+    for (size_t i = 0; i < m_pending.size(); ++i) {
+        const std::string &body = m_pending[i]->getBody();
+        if (body.empty()) {
+            continue;
+        }
+        m_iovs.push_back({m_head.data() + head_begin, m_headEnds[i] - head_begin});
+        m_iovs.push_back({const_cast<char *>(body.data()), body.size()});
+        head_begin = m_headEnds[i];
+    }
+    if (head_begin < m_head.size()) {
+        m_iovs.push_back({m_head.data() + head_begin, m_head.size() - head_begin});
+    }
+    int64_t rt = writeFixSize(m_iovs.data(), (int) m_iovs.size());
+    m_pending.clear();
+    return rt > 0 ? (int) std::min<int64_t>(rt, INT32_MAX) : (int) rt;
+}
+HttpBodyReader::HttpBodyReader(HttpSession *session, bool chunked, uint64_t length)
+        : m_session(session), m_chunked(chunked), m_left(chunked ? 0 : length), m_done(!chunked && length == 0) {
+}
+
+int HttpBodyReader::read(void *buff, size_t len) {
+    if (m_done) {
+        return 0;
+    }
+    if (!m_session) {
+        return -1;
+    }
+    if (!m_left) {
+        if (!nextChunk()) {
+            return -1;
+        }
+        if (m_done) {
+            return 0;
+        }
+    }
+    size_t n = std::min<uint64_t>({len, m_left, INT32_MAX});
+    size_t buffered = m_session->getBufferedSize();
+    int rt;
+    if (buffered) {
+        rt = (int) std::min(n, buffered);
+        memcpy(buff, m_session->m_buffer.get() + m_session->m_begin, rt);
+        m_session->m_begin += rt;
+    } else {
+        //缓冲区空了直接读进调用者的内存
+        if (!m_session->flushBeforeRead()) {
+            return -1;
+        }
+        rt = m_session->SocketStream::read(buff, n);
+        if (rt <= 0) {
+            return -1;
+        }
+    }
+    m_left -= rt;
+    if (!m_chunked && !m_left) {
+        m_done = true;
+    }
+    return rt;
+}
+
+int HttpBodyReader::read(ByteArray::ptr ba, size_t len) {
+    if (!len) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    ba->getWriteBuffers(iovs, len);
+    int rt = read(iovs[0].iov_base, iovs[0].iov_len);
+    if (rt > 0) {
+        ba->setPos(ba->getPos() + rt);
+    }
+    return rt;
+}
+
+void HttpBodyReader::close() {
+    char buff[4096];
+    while (read(buff, sizeof(buff)) > 0) {
+    }
+}
+
+bool HttpBodyReader::nextChunk() {
+    std::string_view line;
+    if (m_chunkEnd) {
+        if (!m_session->readLine(line) || !line.empty()) {
+            return false;
+        }
+        m_chunkEnd = false;
+    }
+    if (!m_session->readLine(line)) {
+        return false;
+    }
+    //块长度是十六进制，后面可能跟着;扩展
+    uint64_t size = 0;
+    size_t i = 0;
+    for (; i < line.size(); ++i) {
+        char c = line[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : -1;
+        if (v < 0) {
+            break;
+        }
+        if (size >> 60) {
+            return false;
+        }
+        size = size * 16 + v;
+    }
+    if (i == 0 || (i < line.size() && line[i] != ';' && line[i] != ' ' && line[i] != '\t')) {
+        return false;
+    }
+    if (size == 0) {
+        //最后一个块，trailer到空行为止
+        do {
+            if (!m_session->readLine(line)) {
+                return false;
+            }
+        } while (!line.empty());
+        m_done = true;
+        return true;
+    }
+    m_left = size;
+    m_chunkEnd = true;
+    return true;
+}
+
+HttpBodyWriter::HttpBodyWriter(HttpSession *session, bool chunked) : m_session(session), m_chunked(chunked) {
+}
+
+int HttpBodyWriter::write(const void *buff, size_t len) {
+    iovec iov{const_cast<void *>(buff), std::min<size_t>(len, INT32_MAX)};
+    return (int) writeFixSize(&iov, 1);
+}
+
+int HttpBodyWriter::write(ByteArray::ptr ba, size_t len) {
+    std::vector<iovec> iovs;
+    if (ba->getReadBuffers(iovs, std::min<size_t>(len, INT32_MAX)) == 0) {
+        return 0;
+    }
+    int64_t rt = writeFixSize(iovs.data(), (int) iovs.size());
+    if (rt > 0) {
+        ba->setPos(ba->getPos() + rt);
+    }
+    return (int) rt;
+}
+
+int64_t HttpBodyWriter::write(const iovec *iov, int iovcnt) {
+    std::vector<iovec> iovs(iov, iov + iovcnt);
+    return writeFixSize(iovs.data(), iovcnt);
+}
+
+int64_t HttpBodyWriter::writeFixSize(iovec *iov, int iovcnt) {
+    if (!m_session || m_closed) {
+        return -1;
+    }
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+    }
+    if (!len) {
+        //长度为0的块表示结束，不能发
+        return 0;
+    }
+    if (!m_chunked) {
+        return m_session->writeFixSize(iov, iovcnt);
+    }
+    //块头、数据、\r\n一次writev发出，数据不拷贝
+    char head[24];
+    int n = snprintf(head, sizeof(head), "%zx\r\n", len);
+    static char crlf[] = "\r\n";
+    iovec stack[8];
+    std::vector<iovec> more;
+    iovec *iovs = stack;
+    if (iovcnt + 2 > 8) {
+        more.resize(iovcnt + 2);
+        iovs = more.data();
+    }
+    iovs[0] = {head, (size_t) n};
+    std::copy(iov, iov + iovcnt, iovs + 1);
+    iovs[iovcnt + 1] = {crlf, 2};
+    int64_t rt = m_session->writeFixSize(iovs, iovcnt + 2);
+    return rt > 0 ? (int64_t) len : rt;
+}
+
+int64_t HttpBodyWriter::sendFile(int fd, off_t offset, size_t len) {
+    if (!m_session || m_closed) {
+        return -1;
+    }
+    if (!len) {
+        return 0;
+    }
+    if (!m_chunked) {
+        return m_session->sendFile(fd, offset, len);
+    }
+    char head[24];
+    int n = snprintf(head, sizeof(head), "%zx\r\n", len);
+    if (m_session->writeFixSize(head, n) <= 0) {
+        return -1;
+    }
+    int64_t rt = m_session->sendFile(fd, offset, len);
+    if (rt != (int64_t) len) {
+        //块已经声明了长度，发不够就没法接着写了
+        m_closed = true;
+        return rt < 0 ? rt : -1;
+    }
+    if (m_session->writeFixSize("\r\n", 2) <= 0) {
+        return -1;
+    }
+    return rt;
+}
+
+void HttpBodyWriter::close() {
+    if (m_closed) {
+        return;
+    }
+    m_closed = true;
+    if (m_chunked && m_session) {
+        m_session->writeFixSize("0\r\n\r\n", 5);
+    }
+}
+
 } // hyn
\ No newline at end of file
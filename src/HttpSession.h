@@ -13,12 +13,24 @@
 #include "SocketStream.h"
 #include "Http.h"
 
+#include <vector>
+
 namespace hyn {
 
+namespace http {
+class HttpRequestParser;
+}
+
+class HttpBodyReader;
+
+class HttpBodyWriter;
+
 /**
  *@brief HttpSession
  */
 class HttpSession : public SocketStream {
+    friend class HttpBodyReader;
+
 public:
     using ptr = std::shared_ptr<HttpSession>;
 
@@ -29,19 +41,226 @@ public:
       */
     explicit HttpSession(Socket::ptr sock, bool owner = true);
 
+    ~HttpSession() override;
+
     /**
      * @brief 接收HTTP请求
+     * @note 连接上的缓冲区和解析器一直复用，一次读到的多个请求(pipeline)依次返回，
+     *       缓冲区里没有完整的请求、要阻塞读之前，先把queueResponse攒下的响应发出去；
+     *       消息体超过HttpRequestParser::GetHttpRequestStreamBodySize或者是chunked编码时，
+     *       不读进getBody()，通过request->getBodyStream()按需读取，上一个请求没读完的消息体在这里丢掉
      */
     http::HttpRequest::ptr recvRequest();
 
     /**
      * @brief 发送HTTP响应
+     * @note 头部写进复用的缓冲区，消息体直接引用，一次writev发出
      * @param[in] rsp HTTP响应
      * @return >0 发送成功
      *         =0 对方关闭
      *         <0 Socket异常
      */
     int sendResponse(http::HttpResponse::ptr rsp);
+
+    /**
+     * @brief 把响应放进待发送队列，和后面的响应合成一次writev发出
+     * @note 在recvRequest要阻塞读、调用flushResponses或sendResponse时发送，攒到MAX_PENDING个时也会发送
+     */
+    void queueResponse(const http::HttpResponse::ptr &rsp);
+
+    /**
+     * @brief 发送队列里的所有响应
+     * @return 同sendResponse，队列为空时返回0
+     */
+    int flushResponses();
+
+    /**
+     * @brief 先发出响应头，消息体之后通过返回的流边生成边写
+     * @note 响应没有content-length头部时用chunked编码；HTTP/1.0不支持chunked，写完后关闭连接。
+     *       rsp里已经设置的消息体会从rsp里拿出来，作为流的第一段发送。
+     *       写完后把rsp交给queueResponse或sendResponse结束这个响应
+     * @return 失败返回nullptr
+     */
+    std::shared_ptr<HttpBodyWriter> beginResponse(const http::HttpResponse::ptr &rsp);
+
+    /**
+     * @brief 缓冲区里还没处理的字节数
+     */
+    [[nodiscard]] size_t getBufferedSize() const {
+        return m_end - m_begin;
+    }
+
+    [[nodiscard]] size_t getPendingResponses() const {
+        return m_pending.size();
+    }
+
+    ///待发送队列最多攒的响应数，每个响应占两个iovec
+    static constexpr size_t MAX_PENDING = 64;
+
+private:
+    /**
+     * @brief 把[m_begin, m_end)挪到缓冲区开头，有请求还引用着旧缓冲区时换一块新的
+     */
+    void compactBuffer();
+
+    /**
+     * @brief 从缓冲区取一行(不含\r\n)，不够时从socket读
+     * @return 成功返回true，连接断开或者一行超过缓冲区时返回false
+     */
+    bool readLine(std::string_view &line);
+
+    /**
+     * @brief 要阻塞读socket之前，把攒下的响应发出去
+     */
+    bool flushBeforeRead() {
+        return m_pending.empty() || flushResponses() > 0;
+    }
+
+    /**
+     * @brief 结束beginResponse开始的响应
+     */
+    void finishStreamResponse();
+
+private:
+    ///状态行和头部的缓冲区，每次响应复用
+    std::string m_head;
+    ///解析器，每个请求reset一次
+    std::shared_ptr<http::HttpRequestParser> m_parser;
+    ///接收缓冲区，返回的请求引用着它
+    std::shared_ptr<char> m_buffer;
+    ///[m_begin, m_end)是收到了还没处理的数据
+    size_t m_begin = 0;
+    size_t m_end = 0;
+    ///待发送的响应
+    std::vector<http::HttpResponse::ptr> m_pending;
+    ///每个待发送响应的头部在m_head里的结束位置
+    std::vector<size_t> m_headEnds;
+    ///flushResponses用的iovec
+    std::vector<iovec> m_iovs;
+    ///当前请求的消息体
+    std::shared_ptr<HttpBodyReader> m_bodyReader;
+    ///beginResponse开始的响应和它的消息体
+    http::HttpResponse::ptr m_streamResponse;
+    std::shared_ptr<HttpBodyWriter> m_bodyWriter;
+};
+
+/**
+ *@brief 请求消息体，按Content-Length或者chunked编码从HttpSession上读
+ *@attention 只占用HttpSession的接收缓冲区，内存不随消息体大小增长；HttpSession析构或者读下一个请求后失效
+ */
+class HttpBodyReader : public Stream {
+    friend class HttpSession;
+
+public:
+    using ptr = std::shared_ptr<HttpBodyReader>;
+
+    /**
+     *@param session 连接
+     *@param chunked 是否chunked编码
+     *@param length 不是chunked时消息体的长度
+     */
+    HttpBodyReader(HttpSession *session, bool chunked, uint64_t length);
+
+    /**
+     *@return >0 读到的长度，=0 消息体读完了，<0 出错或者消息体没读完连接就断了
+     */
+    int read(void *buff, size_t len) override;
+
+    int read(ByteArray::ptr ba, size_t len) override;
+
+    int write(const void *, size_t) override {
+        return -1;
+    }
+
+    int write(ByteArray::ptr, size_t) override {
+        return -1;
+    }
+
+    /**
+     *@brief 丢掉没读的部分
+     */
+    void close() override;
+
+    [[nodiscard]] bool isDone() const {
+        return m_done;
+    }
+
+    [[nodiscard]] bool isChunked() const {
+        return m_chunked;
+    }
+
+private:
+    /**
+     *@brief 读下一个块的长度，最后一个块之后读完trailer
+     */
+    bool nextChunk();
+
+private:
+    ///所属连接，失效后为空
+    HttpSession *m_session;
+    ///是否chunked编码
+    bool m_chunked;
+    ///当前块(或者整个消息体)还没读的长度
+    uint64_t m_left;
+    ///上一个块的数据后面还有\r\n没读
+    bool m_chunkEnd = false;
+    ///消息体是否读完
+    bool m_done;
+};
+
+/**
+ *@brief 响应消息体，chunked时每次写是一个块，close时写最后一个块
+ */
+class HttpBodyWriter : public Stream {
+    friend class HttpSession;
+
+public:
+    using ptr = std::shared_ptr<HttpBodyWriter>;
+
+    HttpBodyWriter(HttpSession *session, bool chunked);
+
+    int read(void *, size_t) override {
+        return -1;
+    }
+
+    int read(ByteArray::ptr, size_t) override {
+        return -1;
+    }
+
+    int write(const void *buff, size_t len) override;
+
+    int write(ByteArray::ptr ba, size_t len) override;
+
+    int64_t write(const iovec *iov, int iovcnt) override;
+
+    using Stream::writeFixSize;
+
+    /**
+     *@brief 整个写完才返回，chunked时作为一个块
+     */
+    int64_t writeFixSize(iovec *iov, int iovcnt) override;
+
+    /**
+     *@brief 文件内容用sendfile发出，chunked时作为一个块；文件不够len时出错
+     */
+    int64_t sendFile(int fd, off_t offset, size_t len) override;
+
+    /**
+     *@brief 结束消息体，chunked时写最后一个块
+     */
+    void close() override;
+
+    [[nodiscard]] bool isChunked() const {
+        return m_chunked;
+    }
+
+private:
+    ///所属连接
+    HttpSession *m_session;
+    ///是否chunked编码
+    bool m_chunked;
+    ///是否已经结束
+    bool m_closed = false;
 };
 
 } // hyn
@@ -0,0 +1,435 @@
+/**
+  ******************************************************************************
+  * @file           : HttpSimdParser.cpp
+  * @author         : hyn
+  * @brief          : None
+  * @attention      : None
+  * @date           : 2023/6/10
+  ******************************************************************************
+  */
+
+
+#include "HttpSimdParser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HYN_HTTP_X86 1
+#define HYN_TARGET_AVX2 __attribute__((target("avx2,bmi")))
+#endif
+
+namespace hyn::http::simd {
+
+namespace {
+
+/**
+ *@brief 一类字符，scalar用256项的表，avx2用高低4位各查一次表(pshufb)
+ */
+struct CharClass {
+    ///在s_table里的位
+    uint8_t bit;
+    ///0x80以上的字节是否属于这一类
+    bool nonAscii;
+    ///低4位查到的组
+    alignas(16) uint8_t lo[16];
+    ///高4位查到的组，0x80以上都是0
+    alignas(16) uint8_t hi[16];
+};
+
+enum : uint8_t {
+    METHOD = 1,
+    PATH = 2,
+    QUERY = 4,
+    TOKEN = 8,
+    VALUE = 16,
+};
+
+uint8_t s_table[256];
+CharClass s_method, s_path, s_query, s_token, s_value;
+
+/**
+ *@brief 按s_table里的bit生成高低4位的表，ASCII只有8个高4位，分组不会超过8个
+ */
+void BuildClass(CharClass &c, uint8_t bit, bool non_ascii) {
+    c.bit = bit;
+    c.nonAscii = non_ascii;
+    memset(c.lo, 0, sizeof(c.lo));
+    memset(c.hi, 0, sizeof(c.hi));
+    uint16_t groups[8];
+    int count = 0;
+    for (int h = 0; h < 8; ++h) {
+        uint16_t mask = 0;
+        for (int l = 0; l < 16; ++l) {
+            if (s_table[h << 4 | l] & bit) {
+                mask |= 1 << l;
+            }
+        }
+        if (!mask) {
+            continue;
+        }
+        int g = 0;
+        while (g < count && groups[g] != mask) {
+            ++g;
+        }
+        if (g == count) {
+            groups[count++] = mask;
+        }
+        c.hi[h] = 1 << g;
+    }
+    for (int g = 0; g < count; ++g) {
+        for (int l = 0; l < 16; ++l) {
+            if (groups[g] >> l & 1) {
+                c.lo[l] |= 1 << g;
+            }
+        }
+    }
+}
+
+struct TableIniter {
+    TableIniter() {
+        for (int c = 0; c < 256; ++c) {
+            bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            bool digit = c >= '0' && c <= '9';
+            bool ascii = c < 0x80;
+            bool ctl = c < 0x20 || c == 0x7f;
+            uint8_t v = 0;
+            if ((c >= 'A' && c <= 'Z') || digit) {
+                v |= METHOD;
+            }
+            //pchar | "/"，%后面的两个十六进制数另外检查
+            if (!ascii || alpha || digit || strchr("-._~!$&'()*+,;=:@%/", c)) {
+                v |= PATH | QUERY;
+            }
+            if (c == '?') {
+                v |= QUERY;
+            }
+            if (ascii && !ctl && !strchr("()<>@,;:\\\"/[]?={} \t", c)) {
+                v |= TOKEN;
+            }
+            if (!ctl || c == '\t') {
+                v |= VALUE;
+            }
+            //strchr会匹配到结尾的\0
+            s_table[c] = c ? v : 0;
+        }
+        BuildClass(s_method, METHOD, false);
+        BuildClass(s_path, PATH, true);
+        BuildClass(s_query, QUERY, true);
+        BuildClass(s_token, TOKEN, false);
+        BuildClass(s_value, VALUE, true);
+    }
+};
+
+TableIniter s_initer;
+
+/**
+ *@brief 从p开始跳过属于c的字符，最多到limit
+ */
+const char *ScanScalar(const char *p, const char *limit, const CharClass &c) {
+    while (p < limit && (s_table[static_cast<uint8_t>(*p)] & c.bit)) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef HYN_HTTP_X86
+
+/**
+ *@brief 一次检查32个字节，limit是可以读的末尾
+ */
+HYN_TARGET_AVX2 const char *ScanAvx2(const char *p, const char *limit, const CharClass &c) {
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(c.lo)));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(c.hi)));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i allow = c.nonAscii ? _mm256_set1_epi8(-1) : zero;
+    while (limit - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, nibble));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i out = _mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero);
+        //0x80以上的字节按nonAscii决定
+        __m256i high = _mm256_and_si256(_mm256_cmpgt_epi8(zero, v), allow);
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_andnot_si256(high, out)));
+        if (mask) {
+            return p + _tzcnt_u32(mask);
+        }
+        p += 32;
+    }
+    return ScanScalar(p, limit, c);
+}
+
+#endif
+
+struct Impl {
+    const char *(*scan)(const char *, const char *, const CharClass &);
+    const char *name;
+};
+
+const Impl s_scalar{ScanScalar, "scalar"};
+
+#ifdef HYN_HTTP_X86
+const Impl s_avx2{ScanAvx2, "avx2"};
+#endif
+
+/**
+ *@brief 按CPU支持的指令集选一次实现
+ */
+const Impl &Select() {
+#ifdef HYN_HTTP_X86
+    static const Impl &impl = __builtin_cpu_supports("avx2") ? s_avx2 : s_scalar;
+    return impl;
+#else
+    return s_scalar;
+#endif
+}
+
+struct Span {
+    const char *at = nullptr;
+    size_t len = 0;
+};
+
+struct RequestLine {
+    Span method;
+    Span path;
+    Span query;
+    Span uri;
+    Span fragment;
+    Span version;
+    bool hasQuery = false;
+    bool hasFragment = false;
+};
+
+///一次最多处理的头部个数，更多的交给ragel
+constexpr size_t MAX_FIELDS = 64;
+
+struct Field {
+    Span name;
+    Span value;
+};
+
+/**
+ *@brief [p, end)里的每个%后面都要跟两个十六进制数，partial为true时最后一个%可以还没收完
+ */
+bool CheckPercent(const char *p, const char *end, bool partial) {
+    while ((p = static_cast<const char *>(memchr(p, '%', end - p)))) {
+        for (int i = 1; i < 3; ++i) {
+            if (p + i == end) {
+                return partial;
+            }
+            if (!isxdigit(static_cast<uint8_t>(p[i]))) {
+                return false;
+            }
+        }
+        p += 3;
+    }
+    return true;
+}
+
+/**
+ *@brief 解析从data开始的请求行
+ *@return 下一行的开头；[data, limit)是还没收完的合法前缀时返回limit；格式不对返回nullptr
+ */
+const char *ParseRequestLine(const Impl &impl, const char *data, const char *limit, RequestLine &line) {
+    const char *p = impl.scan(data, limit, s_method);
+    line.method = {data, static_cast<size_t>(p - data)};
+    if (line.method.len > 20) {
+        return nullptr;
+    }
+    if (p == limit) {
+        return limit;
+    }
+    if (!line.method.len || *p != ' ') {
+        return nullptr;
+    }
+    //只处理以/开头的路径，//开头是authority
+    const char *path = p + 1;
+    if (path == limit || (path[0] == '/' && path + 1 == limit)) {
+        return limit;
+    }
+    if (path[0] != '/' || path[1] == '/') {
+        return nullptr;
+    }
+    p = impl.scan(path, limit, s_path);
+    if (!CheckPercent(path, p, p == limit)) {
+        return nullptr;
+    }
+    line.path = {path, static_cast<size_t>(p - path)};
+    if (p != limit && *p == '?') {
+        const char *query = p + 1;
+        p = impl.scan(query, limit, s_query);
+        if (!CheckPercent(query, p, p == limit)) {
+            return nullptr;
+        }
+        line.query = {query, static_cast<size_t>(p - query)};
+        line.hasQuery = true;
+    }
+    line.uri = {path, static_cast<size_t>(p - path)};
+    if (p != limit && *p == '#') {
+        const char *fragment = p + 1;
+        p = impl.scan(fragment, limit, s_query);
+        if (!CheckPercent(fragment, p, p == limit)) {
+            return nullptr;
+        }
+        line.fragment = {fragment, static_cast<size_t>(p - fragment)};
+        line.hasFragment = true;
+    }
+    if (p == limit) {
+        return limit;
+    }
+    if (*p != ' ') {
+        return nullptr;
+    }
+    ++p;
+    //HTTP/1.0或HTTP/1.1，后面紧跟\r\n
+    static const char version[] = "HTTP/1.0\r\n";
+    size_t rest = std::min<size_t>(limit - p, 10);
+    for (size_t i = 0; i < rest; ++i) {
+        if (p[i] != version[i] && !(i == 7 && p[i] == '1')) {
+            return nullptr;
+        }
+    }
+    if (rest < 10) {
+        return limit;
+    }
+    line.version = {p, 8};
+    return p + 10;
+}
+
+/**
+ *@brief 解析从p开始的一个头部
+ *@return 下一行的开头；[p, limit)是还没收完的合法前缀时返回limit；格式不对返回nullptr
+ */
+const char *ParseField(const Impl &impl, const char *p, const char *limit, Field &field) {
+    const char *colon = impl.scan(p, limit, s_token);
+    if (colon == limit) {
+        return limit;
+    }
+    if (colon == p || *colon != ':') {
+        return nullptr;
+    }
+    //值前面的空白不算，后面的算(和ragel一样)
+    const char *value = colon + 1;
+    while (value < limit && (*value == ' ' || *value == '\t')) {
+        ++value;
+    }
+    const char *value_end = impl.scan(value, limit, s_value);
+    if (value_end == limit || (value_end[0] == '\r' && value_end + 1 == limit)) {
+        return limit;
+    }
+    if (value_end[0] != '\r' || value_end[1] != '\n') {
+        return nullptr;
+    }
+    field = {{p, static_cast<size_t>(colon - p)}, {value, static_cast<size_t>(value_end - value)}};
+    return value_end + 2;
+}
+
+/**
+ *@brief 从data + begin开始逐行解析，begin为0时先解析请求行
+ *@param[in, out] begin 没收完时更新为最后一行的开头，下次从这里继续
+ *@return 请求头的长度，INCOMPLETE或FALLBACK
+ */
+int64_t ParseLines(const Impl &impl, const char *data, size_t len, size_t &begin, RequestLine &line,
+                   Field *fields, size_t &count) {
+    const char *limit = data + len;
+    const char *p = data + begin;
+    if (begin == 0) {
+        p = ParseRequestLine(impl, data, limit, line);
+        if (!p) {
+            return FALLBACK;
+        }
+        if (p == limit) {
+            return INCOMPLETE;
+        }
+    }
+    for (;;) {
+        begin = p - data;
+        if (p == limit) {
+            return INCOMPLETE;
+        }
+        if (*p == '\r') {
+            if (p + 1 == limit) {
+                return INCOMPLETE;
+            }
+            //\r\n之外的换行、折行都在这里或者ParseField里失败
+            return p[1] == '\n' ? p + 2 - data : FALLBACK;
+        }
+        if (count == MAX_FIELDS) {
+            return FALLBACK;
+        }
+        const char *next = ParseField(impl, p, limit, fields[count]);
+        if (!next) {
+            return FALLBACK;
+        }
+        if (next == limit) {
+            return INCOMPLETE;
+        }
+        ++count;
+        p = next;
+    }
+}
+
+/**
+ *@brief 按ragel的顺序调用回调
+ */
+void Emit(http_parser *parser, const RequestLine &line, const Field *fields, size_t count, const char *data,
+          size_t end, size_t len) {
+    if (parser->request_method) {
+        parser->request_method(parser->data, line.method.at, line.method.len);
+    }
+    if (parser->request_path) {
+        parser->request_path(parser->data, line.path.at, line.path.len);
+    }
+    if (line.hasQuery && parser->query_string) {
+        parser->query_string(parser->data, line.query.at, line.query.len);
+    }
+    if (parser->request_uri) {
+        parser->request_uri(parser->data, line.uri.at, line.uri.len);
+    }
+    if (line.hasFragment && parser->fragment) {
+        parser->fragment(parser->data, line.fragment.at, line.fragment.len);
+    }
+    if (parser->http_version) {
+        parser->http_version(parser->data, line.version.at, line.version.len);
+    }
+    if (parser->http_field) {
+        for (size_t i = 0; i < count; ++i) {
+            parser->http_field(parser->data, fields[i].name.at, fields[i].name.len, fields[i].value.at,
+                               fields[i].value.len);
+        }
+    }
+    parser->body_start = end;
+    parser->nread = end;
+    if (parser->header_done) {
+        parser->header_done(parser->data, data + end, len - end);
+    }
+}
+
+} // namespace
+
+int64_t ParseRequest(http_parser *parser, const char *data, size_t len, ScanState &state) {
+    const Impl &impl = Select();
+    RequestLine line;
+    Field fields[MAX_FIELDS];
+    size_t count = 0;
+    size_t resume = state.validated;
+    int64_t end = ParseLines(impl, data, len, state.validated, line, fields, count);
+    if (end > 0 && resume != 0) {
+        //前面的行是上次检查的，收完之后从头再解析一遍拿到所有字段
+        size_t begin = 0;
+        count = 0;
+        end = ParseLines(impl, data, len, begin, line, fields, count);
+    }
+    if (end > 0) {
+        Emit(parser, line, fields, count, data, end, len);
+    }
+    return end;
+}
+
+const char *Implementation() {
+    return Select().name;
+}
+
+} // hyn::http::simd
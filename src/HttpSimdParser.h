@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file           : HttpSimdParser.h
+  * @author         : hyn
+  * @brief          : 手写的HTTP请求解析，用AVX2一次检查32个字节
+  * @attention      : 只处理常见格式(origin-form的路径、CRLF换行、没有折行)，其余返回FALLBACK交给ragel解析；
+  *                   接受的请求和ragel回调出的内容完全一样
+  * @date           : 2023/6/10
+  ******************************************************************************
+  */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "http11_parser.h"
+
+namespace hyn::http::simd {
+
+///数据不完整
+constexpr int64_t INCOMPLETE = 0;
+///快速路径处理不了
+constexpr int64_t FALLBACK = -1;
+
+/**
+ *@brief 多次调用之间保存的扫描进度，换请求时重置
+ */
+struct ScanState {
+    ///这之前的完整行都检查过格式
+    size_t validated = 0;
+};
+
+/**
+ *@brief 解析[data, data + len)里的请求头，完整时按ragel的顺序调用parser里的回调
+ *@attention 数据不完整时不消费任何字节，下次调用时data的前len个字节不能变；
+ *           收到的部分已经不可能是合法请求时返回FALLBACK，由ragel报告错误
+ *@return 请求头的长度(包括最后的空行)，INCOMPLETE或FALLBACK
+ */
+int64_t ParseRequest(http_parser *parser, const char *data, size_t len, ScanState &state);
+
+/**
+ *@brief 当前使用的实现："avx2"或"scalar"
+ */
+const char *Implementation();
+
+} // hyn::http::simd
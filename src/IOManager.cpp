@@ -11,91 +11,171 @@
 
 #include "Logger.h"
 #include "IOManager.h"
+#include "FDManger.h"
+#include "util.h"
 #include <sys/epoll.h>
 #include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 
 namespace hyn::iomanager {
 /**
-管道是一个字节流的传输通道，它具有以下特点：
-只能在具有亲缘关系的进程之间使用（如父子进程）。
-管道是半双工的，即只能单向传输数据，一端只能写，另一端只能读。
-管道中的数据是先进先出（FIFO）的。
-在使用管道时，我们通常会使用pipe系统调用创建一个管道，这个系统调用会返回两个文件描述符，分别表示管道的读端和写端。在父进程中，我们通常会
- 关闭管道的读端，只保留写端。在子进程中，我们通常会关闭管道的写端，只保留读端。这样，父进程就可以通过管道向子进程传递数据，而子进程则可以
- 通过管道接收数据。
-在Linux系统中，管道是一种非常常用的进程间通信机制，它不仅可以用于在同一台机器上的进程间通信，也可以用于不同机器之间的进程间通信，比如通过
- 网络套接字实现的管道。管道不仅可以传输普通的文本数据，也可以传输二进制数据和文件等多种类型的数据。
- */
-/**
- *pipe[0] 读 pipe[1]写
+ *每个调度线程有自己的eventfd，空闲时只有一个线程在epoll_wait(m_epfd)上等待IO和定时器，
+ *其他线程在自己的eventfd上等待，tickle只唤醒其中一个，避免所有空闲线程一起被唤醒
  */
 IOManager::IOManager(size_t thread, bool use_call, const std::string &name) : Scheduler(thread, use_call, name) {
     m_epfd = epoll_create(5000);
     THROW_RUNTIME_ERROR_IF(m_epfd < 0, "epoll create error");
 
-    int rt = pipe(m_tickleFds);
-    THROW_RUNTIME_ERROR_IF(rt, "pipe error");
+    m_tickleFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    THROW_RUNTIME_ERROR_IF(m_tickleFd < 0, "eventfd error");
 
     epoll_event ep_event{};
     memset(&ep_event, 0, sizeof(epoll_event));
     ep_event.events = EPOLLIN | EPOLLET;
-    ep_event.data.fd = m_tickleFds[0];
-
-    rt = fcntl(m_tickleFds[0], F_SETFL, O_NONBLOCK);//设置非阻塞
-    THROW_RUNTIME_ERROR_IF(rt, "fcntl error");
+    ep_event.data.fd = m_tickleFd;
 
-    rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &ep_event);
+    int rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFd, &ep_event);
     THROW_RUNTIME_ERROR_IF(rt, "epoll ctl error");
 
-    contextResize(32);
+    for (size_t i = 0; i < getWorkerCount(); ++i) {
+        auto *reactor = new Reactor;
+        m_reactors.emplace_back(reactor);
+        reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+        THROW_RUNTIME_ERROR_IF(reactor->epfd < 0, "epoll create error");
+        reactor->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        THROW_RUNTIME_ERROR_IF(reactor->eventfd < 0, "eventfd error");
+        ep_event.events = EPOLLIN;
+        ep_event.data.fd = reactor->eventfd;
+        rt = epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->eventfd, &ep_event);
+        THROW_RUNTIME_ERROR_IF(rt, "epoll ctl error");
+    }
+
     start();
 }
 
 IOManager::~IOManager() {
     stop();
     close(m_epfd);
-    close(m_tickleFds[0]);
-    close(m_tickleFds[1]);
-    for (auto &m_fdContext: m_fdContexts_vertor) {
-        delete m_fdContext;
+    close(m_tickleFd);
+    for (auto &reactor: m_reactors) {
+        close(reactor->epfd);
+        close(reactor->eventfd);
+    }
+}
+
+void IOManager::setMultiReactor(bool v) {
+    if (m_multiReactor.exchange(v) == v) {
+        return;
+    }
+    //共享epoll上的fd和定时器交给第0个线程
+    epoll_event ep_event{};
+    ep_event.events = EPOLLIN;
+    ep_event.data.fd = m_epfd;
+    int rt = epoll_ctl(m_reactors[0]->epfd, v ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, m_epfd, &ep_event);
+    THROW_RUNTIME_ERROR_IF(rt, "epoll ctl error");
+    tickle(0);
+}
+
+int IOManager::nextReactorThread() {
+    if (!m_multiReactor) {
+        return -1;
+    }
+    size_t n = m_reactors.size();
+    size_t start = m_nextReactor++;
+    size_t best = start % n;
+    for (size_t i = 1; i < n; ++i) {
+        size_t index = (start + i) % n;
+        if (m_reactors[index]->pendingEventCount < m_reactors[best]->pendingEventCount) {
+            best = index;
+        }
     }
+    return getWorkerThreadId(best);
 }
 
-//首先通过文件描述符fd找到对应的FdContext，如果找到则加锁并将fd对应的事件添加到epoll事件循环中，如果未找到则先扩展
-//FdContext数组，再加锁后添加事件到epoll事件循环中。如果添加事件成功，将事件与回调函数绑定，以便在事件发生时回调。
+IOManager::FdContext *IOManager::getFdContext(int fd, bool auto_create) {
+    FdCtx *ctx = FdMgr::GetInstance()->record(fd, auto_create);
+    return ctx ? &ctx->m_io : nullptr;
+}
+
+//首先通过文件描述符fd找到对应的FdContext，不存在则创建，再加锁后添加事件到epoll事件循环中。
+//如果添加事件成功，将事件与回调函数绑定，以便在事件发生时回调。
 int IOManager::addEvent(int fd, IOManager::Event event, std::function<void()> cb) {
-    FdContext *fd_ctx = nullptr;
-    RWMutexType::ReadLock lock(m_rw_mutex);
-    if ((int) m_fdContexts_vertor.size() > fd) {
-        fd_ctx = m_fdContexts_vertor[fd];
-        lock.unlock();
-    } else {
-        lock.unlock();
-        RWMutexType::WriteLock lock2(m_rw_mutex);
-        contextResize(fd * 1.5);
-        fd_ctx = m_fdContexts_vertor[fd];
+    int rt = addEvent(getFdContext(fd, true), fd, event, cb, static_cast<uint64_t>(-1));
+    if (rt == 1) {
+        //事件已经就绪，直接调度，和事件在别的线程上触发一样
+        if (cb) {
+            schedule(std::move(cb));
+        } else {
+            schedule(fiber::Fiber::GetThis());
+        }
+        return 0;
     }
+    return rt;
+}
 
+int IOManager::addEvent(FdContext *fd_ctx, int fd, Event event, std::function<void()> cb, uint64_t timeout_ms) {
+    if (!fd_ctx) {
+        error("addEvent fd:%d out of range", fd);
+        return -1;
+    }
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if (fd_ctx->m_event & event) {
         error("addEvent error fd :%d", fd);
         assert(!(fd_ctx->m_event & event));
     }
-
-    int op = fd_ctx->m_event ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
-    epoll_event epevent{};
-    epevent.events = EPOLLET | fd_ctx->m_event | event;
-    epevent.data.ptr = fd_ctx;
-
-    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-    if (rt) {
-        error(" error epoll_ctl :epfd:%d,op:%d,fd:%d,errno:%d", m_epfd, op, fd, errno);
+    bool persistent = fd_ctx->m_registered && fd_ctx->m_iom == this;
+    if (fd_ctx->m_event == NONE && !persistent) {
+        //没有注册任何事件时重新绑定，多reactor模式下注册到当前线程的epoll
+        int index = m_multiReactor ? getWorkerIndex() : -1;
+        fd_ctx->m_fd = fd;
+        fd_ctx->m_iom = this;
+        fd_ctx->m_reactor = index >= 0 ? m_reactors[index].get() : nullptr;
+        fd_ctx->m_registered = false;
+        fd_ctx->m_ready = NONE;
+    } else if (fd_ctx->m_iom != this) {
+        error("addEvent fd:%d registered in another IOManager", fd);
         return -1;
     }
 
-    ++m_pendingEventCount;
+    int epfd = getEpfd(fd_ctx);
+    if (persistent) {
+        //已经一直注册着，就绪过的事件直接返回，不用等也不用epoll_ctl
+        if (fd_ctx->m_ready & event) {
+            fd_ctx->m_ready = (Event) (fd_ctx->m_ready & ~event);
+            return 1;
+        }
+    } else if (m_persistentEvents) {
+        epoll_event epevent{};
+        epevent.events = static_cast<uint32_t>(EPOLLET) | static_cast<uint32_t>(READ) | static_cast<uint32_t>(WRITE);
+        epevent.data.ptr = fd_ctx;
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent);
+        if (rt && errno == EEXIST) {
+            ++m_epollCtlCount;
+            rt = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epevent);
+        }
+        if (rt) {
+            error(" error epoll_ctl :epfd:%d,op:%d,fd:%d,errno:%d", epfd, EPOLL_CTL_ADD, fd, errno);
+            return -1;
+        }
+        fd_ctx->m_registered = true;
+    } else {
+        int op = fd_ctx->m_event ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        epoll_event epevent{};
+        epevent.events = EPOLLET | fd_ctx->m_event | event;
+        epevent.data.ptr = fd_ctx;
+
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(epfd, op, fd, &epevent);
+        if (rt) {
+            error(" error epoll_ctl :epfd:%d,op:%d,fd:%d,errno:%d", epfd, op, fd, errno);
+            return -1;
+        }
+    }
+
+    ++getPendingCount(fd_ctx);
     fd_ctx->m_event = (Event) (fd_ctx->m_event | event);
     FdContext::EventContext &event_ctx = fd_ctx->get_context(event);
     assert(event_ctx.scheduler == nullptr && !event_ctx.fiber && !event_ctx.cb);
@@ -106,38 +186,81 @@ int IOManager::addEvent(int fd, IOManager::Event event, std::function<void()> cb
     } else {
         event_ctx.fiber = fiber::Fiber::GetThis();
         assert(event_ctx.fiber->getState() == fiber::Fiber::EXEC);
+        if (fd_ctx->m_reactor) {
+            //处理这个fd的协程留在这个reactor上
+            event_ctx.fiber->setOwnerThread(util::GetThreadId());
+        }
+    }
+    if (timeout_ms != static_cast<uint64_t>(-1)) {
+        FdContext::EventTimer &timer = event_ctx.timer;
+        timer.m_onExpire = &IOManager::OnEventTimeout;
+        timer.iom = this;
+        timer.fd_ctx = fd_ctx;
+        timer.event = event;
+        timer.expired = false;
+        armTimer(&timer, timeout_ms);
     }
     return 0;
 }
 
+int IOManager::waitEvent(int fd, IOManager::Event event, uint64_t timeout_ms) {
+    FdContext *fd_ctx = getFdContext(fd, true);
+    int rt = addEvent(fd_ctx, fd, event, nullptr, timeout_ms);
+    if (rt) {
+        return rt == 1 ? 0 : -1;
+    }
+    fiber::Fiber::YieldToHold();
+    if (timeout_ms == static_cast<uint64_t>(-1)) {
+        return 0;
+    }
+    FdContext::EventTimer &timer = fd_ctx->get_context(event).timer;
+    disarmTimer(&timer);
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    return timer.expired ? ETIMEDOUT : 0;
+}
+
+void IOManager::OnEventTimeout(TimerNode *node, uint64_t seq) {
+    auto *timer = static_cast<FdContext::EventTimer *>(node);
+    FdContext *fd_ctx = timer->fd_ctx;
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    //事件已经到了，或者定时器已经为下一次等待重新挂上了
+    if (timer->m_seq != seq || !(fd_ctx->m_event & timer->event)) {
+        return;
+    }
+    timer->expired = true;
+    timer->iom->cancelEvent(fd_ctx, timer->event);
+}
+
 bool IOManager::delEvent(int fd, IOManager::Event event) {
     //判断fd是否存在
-    RWMutexType::ReadLock lock(m_rw_mutex);
-    if ((int) m_fdContexts_vertor.size() <= fd)
+    FdContext *fdContext = getFdContext(fd, false);
+    if (!fdContext)
         return false;
-    FdContext *fdContext = m_fdContexts_vertor[fd];
-    lock.unlock();
 
     //判断event是否存在
     FdContext::MutexType::Lock lock1(fdContext->mutex);
-    if (!(fdContext->m_event & event))
+    if (fdContext->m_iom != this || !(fdContext->m_event & event))
         return false;
 
     //构造一个新的事件列表 new_events，删除要删除的事件 event。
     //如果新的事件列表 new_events 不为空，就调用 epoll_ctl 修改事件列表为新的列表；否则，就调用 epoll_ctl 删除事件。
+    //一直注册着的fd不用改epoll
     auto new_event = (Event) (fdContext->m_event & ~event);
-    int op = new_event ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event ep_event{};
-    ep_event.events = EPOLLET | new_event;
-    ep_event.data.ptr = &fdContext;
-    int rt = epoll_ctl(m_epfd, op, fd, &ep_event);
-
-    if (rt) {
-        error("epoll_ctl :%d,op:%d,fd:%d", m_epfd, op, fd);
-        return false;
+    if (!fdContext->m_registered) {
+        int op = new_event ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        epoll_event ep_event{};
+        ep_event.events = EPOLLET | new_event;
+        ep_event.data.ptr = fdContext;
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(getEpfd(fdContext), op, fd, &ep_event);
+
+        if (rt) {
+            error("epoll_ctl :%d,op:%d,fd:%d", getEpfd(fdContext), op, fd);
+            return false;
+        }
     }
 
-    --m_pendingEventCount;
+    --getPendingCount(fdContext);
     fdContext->m_event = new_event;
     FdContext::EventContext &eventContext = fdContext->get_context(event);
     fdContext->ResetContext(eventContext);
@@ -146,70 +269,79 @@ bool IOManager::delEvent(int fd, IOManager::Event event) {
 
 bool IOManager::cancelEvent(int fd, IOManager::Event event) {
     //判断fd是否存在
-    RWMutexType::ReadLock lock(m_rw_mutex);
-    if ((int) m_fdContexts_vertor.size() <= fd)
+    FdContext *fdContext = getFdContext(fd, false);
+    if (!fdContext)
         return false;
-    FdContext *fdContext = m_fdContexts_vertor[fd];
-    lock.unlock();
 
-    //判断event是否存在
     FdContext::MutexType::Lock lock1(fdContext->mutex);
+    if (fdContext->m_iom != this)
+        return false;
+    return cancelEvent(fdContext, event);
+}
+
+bool IOManager::cancelEvent(FdContext *fdContext, IOManager::Event event) {
+    //判断event是否存在
     if (!(fdContext->m_event & event))
         return false;
 
     //构造一个新的事件列表 new_events，删除要删除的事件 event。
     //如果新的事件列表 new_events 不为空，就调用 epoll_ctl 修改事件列表为新的列表；否则，就调用 epoll_ctl 删除事件。
-    auto new_event = (Event) (fdContext->m_event & ~event);
-    int op = new_event ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-    epoll_event ep_event{};
-    ep_event.events = EPOLLET | new_event;
-    ep_event.data.ptr = &fdContext;
-    int rt = epoll_ctl(m_epfd, op, fd, &ep_event);
-
-    if (rt) {
-        error("epoll_ctl :%d,op:%d,fd:%d", m_epfd, op, fd);
-        return false;
+    if (!fdContext->m_registered) {
+        auto new_event = (Event) (fdContext->m_event & ~event);
+        int op = new_event ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        epoll_event ep_event{};
+        ep_event.events = EPOLLET | new_event;
+        ep_event.data.ptr = fdContext;
+        ++m_epollCtlCount;
+        int rt = epoll_ctl(getEpfd(fdContext), op, fdContext->m_fd, &ep_event);
+
+        if (rt) {
+            error("epoll_ctl :%d,op:%d,fd:%d", getEpfd(fdContext), op, fdContext->m_fd);
+            return false;
+        }
     }
 
     ///仅仅从这开始与delEvent不同
     fdContext->triggerEvent(event);
-    --m_pendingEventCount;
+    --getPendingCount(fdContext);
     return true;
 }
 
 bool IOManager::cancelAll(int fd) {
 //判断fd是否存在
-    RWMutexType::ReadLock lock(m_rw_mutex);
-    if ((int) m_fdContexts_vertor.size() <= fd)
+    FdContext *fdContext = getFdContext(fd, false);
+    if (!fdContext)
         return false;
-    FdContext *fdContext = m_fdContexts_vertor[fd];
-    lock.unlock();
 
     //判断event是否存在
     FdContext::MutexType::Lock lock1(fdContext->mutex);
-    if (!fdContext->m_event)
+    if (fdContext->m_iom != this || (!fdContext->m_event && !fdContext->m_registered))
         return false;
 
     //构造一个新的事件列表 new_events，删除要删除的事件 event。
     //如果新的事件列表 new_events 不为空，就调用 epoll_ctl 修改事件列表为新的列表；否则，就调用 epoll_ctl 删除
+    //一直注册着的fd在这里注销，一般是要close了
+    fdContext->m_registered = false;
+    fdContext->m_ready = NONE;
     epoll_event ep_event{};
     ep_event.events = 0;
-    ep_event.data.ptr = &fdContext;
-    int rt = epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, &ep_event);
+    ep_event.data.ptr = fdContext;
+    ++m_epollCtlCount;
+    int rt = epoll_ctl(getEpfd(fdContext), EPOLL_CTL_DEL, fd, &ep_event);
 
     if (rt) {
-        error("epoll_ctl :%d,op:%d,fd:%d", m_epfd, EPOLL_CTL_DEL, fd);
+        error("epoll_ctl :%d,op:%d,fd:%d", getEpfd(fdContext), EPOLL_CTL_DEL, fd);
         return false;
     }
 
     if (fdContext->m_event & READ) {
         fdContext->triggerEvent(READ);
-        --m_pendingEventCount;
+        --getPendingCount(fdContext);
     }
 
     if (fdContext->m_event & WRITE) {
         fdContext->triggerEvent(WRITE);
-        --m_pendingEventCount;
+        --getPendingCount(fdContext);
     }
 
     return true;
@@ -223,16 +355,235 @@ void IOManager::tickle() {
     if (!has_idle_thread()) {
         return;
     }
-    auto rt = write(m_tickleFds[1], "T", 1);
-    assert(rt == 1);
+    //优先唤醒一个在eventfd上等待的线程，都不空闲再唤醒epoll_wait的线程
+    if (!tickleParked()) {
+        ticklePoller();
+    }
+}
+
+bool IOManager::tickleParked() {
+    size_t n = m_reactors.size();
+    size_t start = m_nextParker++;
+    for (size_t i = 0; i < n; ++i) {
+        size_t index = (start + i) % n;
+        if (m_reactors[index]->parked.exchange(false)) {
+            uint64_t one = 1;
+            auto rt = write(m_reactors[index]->eventfd, &one, sizeof(one));
+            assert(rt == sizeof(one));
+            ++m_tickleSent;
+            return true;
+        }
+    }
+    return false;
+}
+
+void IOManager::tickle(size_t worker) {
+    if (m_reactors[worker]->parked.exchange(false)) {
+        uint64_t one = 1;
+        auto rt = write(m_reactors[worker]->eventfd, &one, sizeof(one));
+        assert(rt == sizeof(one));
+        ++m_tickleSent;
+    } else if (m_poller == (int) worker) {
+        ticklePoller();
+    }
+    //否则目标线程正在执行任务，下一轮调度会检查自己的inbox
+}
+
+void IOManager::ticklePoller() {
+    //即使现在没有线程在epoll_wait也要写，下一个进入epoll_wait的线程会马上返回
+    uint64_t one = 1;
+    auto rt = write(m_tickleFd, &one, sizeof(one));
+    assert(rt == sizeof(one));
+    ++m_tickleSent;
+}
+
+int IOManager::park(size_t index, epoll_event *events, int max_events, int timeout) {
+    Reactor &reactor = *m_reactors[index];
+    reactor.parked = true;
+    //设置parked之后再检查一次，避免tickle发生在设置之前而丢失
+    ++m_epollWaitCount;
+    int rt = epoll_wait(reactor.epfd, events, max_events, hasTask(index) ? 0 : timeout);
+    if (!reactor.parked.exchange(false)) {
+        //被tickle认领了，eventfd在processEvents里读掉
+        ++m_tickleWakeups;
+        if (hasTask(index)) {
+            ++m_tickleUseful;
+        }
+    }
+    return rt;
+}
+
+IOManager::TickleStats IOManager::getTickleStats() const {
+    return {m_tickleSent, m_tickleWakeups, m_tickleUseful};
+}
+
+IOManager::IoStats IOManager::getIoStats() const {
+    uint64_t enter = 0;
+    for (auto &reactor: m_reactors) {
+        mutex::Mutex::Lock lock(reactor->ringMutex);
+        if (reactor->ring) {
+            enter += reactor->ring->getEnterCount();
+        }
+    }
+    return {m_epollCtlCount, m_epollWaitCount, enter};
+}
+
+bool IOManager::setIoUring(bool v) {
+    if (v && !m_ioUring) {
+        IoUring probe(2);
+        if (!probe.valid()) {
+            warn("io_uring not supported errno=%d, fall back to epoll", errno);
+            return false;
+        }
+        //cancelIo按fd取消需要5.19以上的内核，不支持时关闭fd唤醒不了等在io_uring上的协程
+        io_uring_sqe *sqe = probe.getSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = probe.fd();
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        int res = -EINVAL;
+        if (probe.submit(1) == 1) {
+            probe.reap([&res](const io_uring_cqe &cqe) {
+                res = cqe.res;
+            });
+        }
+        if (res == -EINVAL) {
+            warn("io_uring async cancel by fd not supported, fall back to epoll");
+            return false;
+        }
+    }
+    m_ioUring = v;
+    return true;
+}
+
+IOManager::Reactor *IOManager::getRing() {
+    int index = getWorkerIndex();
+    if (index < 0) {
+        return nullptr;
+    }
+    Reactor *reactor = m_reactors[index].get();
+    if (reactor->ring) {
+        return reactor;
+    }
+    //只有本线程会创建自己的io_uring
+    auto ring = std::make_unique<IoUring>(256);
+    if (!ring->valid()) {
+        warn("io_uring setup errno=%d, fall back to epoll", errno);
+        m_ioUring = false;
+        return nullptr;
+    }
+    //完成队列有数据时io_uring的fd可读，和其他fd一起在epoll里等
+    epoll_event ep_event{};
+    ep_event.events = EPOLLIN;
+    ep_event.data.u64 = reinterpret_cast<uint64_t>(reactor) | RING_TAG;
+    int rt = epoll_ctl(m_multiReactor ? reactor->epfd : m_epfd, EPOLL_CTL_ADD, ring->fd(), &ep_event);
+    if (rt) {
+        error("epoll_ctl io_uring fd:%d errno:%d", ring->fd(), errno);
+        m_ioUring = false;
+        return nullptr;
+    }
+    mutex::Mutex::Lock lock(reactor->ringMutex);
+    reactor->ring = std::move(ring);
+    return reactor;
+}
+
+int IOManager::submitIo(const io_uring_sqe &sqe, uint64_t timeout_ms) {
+    //共享栈协程挂起后栈会被别的协程覆盖，内核不能往上面写
+    fiber::Fiber::ptr cur = fiber::Fiber::GetThis();
+    if (!m_ioUring || cur->isSharedStack()) {
+        return -ENOSYS;
+    }
+    Reactor *reactor = getRing();
+    if (!reactor) {
+        return -ENOSYS;
+    }
+
+    IoRequest req;
+    req.fiber = cur;
+    cur.reset();
+    __kernel_timespec ts{};
+    {
+        mutex::Mutex::Lock lock(reactor->ringMutex);
+        IoUring &ring = *reactor->ring;
+        //请求和超时要么一起提交要么都不提交，先确认有足够的空位再取
+        bool has_timeout = timeout_ms != static_cast<uint64_t>(-1);
+        if (ring.getSqeSpace() < (has_timeout ? 2u : 1u)) {
+            return -ENOSYS;
+        }
+        io_uring_sqe *io = ring.getSqe();
+        *io = sqe;
+        io->user_data = reinterpret_cast<uint64_t>(&req);
+        if (has_timeout) {
+            //超时由链接在后面的定时请求负责，超时后前一个请求以-ECANCELED完成
+            ts.tv_sec = static_cast<int64_t>(timeout_ms / 1000);
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000 * 1000000);
+            io->flags |= IOSQE_IO_LINK;
+            io_uring_sqe *link = ring.getSqe();
+            link->opcode = IORING_OP_LINK_TIMEOUT;
+            link->fd = -1;
+            link->addr = reinterpret_cast<uint64_t>(&ts);
+            link->len = 1;
+            link->user_data = 0;
+        }
+        ++reactor->ringPending;
+        //内核一个都没取走时提交项已经被撤回，req不会再被引用；取走了请求就一定会有完成项，等它回来
+        int rt = ring.submit();
+        if (rt <= 0) {
+            --reactor->ringPending;
+            rt = rt ? rt : -EAGAIN;
+            error("io_uring_enter errno:%d", -rt);
+            return rt;
+        }
+    }
+    fiber::Fiber::YieldToHold();
+    return req.res;
+}
+
+void IOManager::cancelIo(int fd) {
+    for (auto &reactor: m_reactors) {
+        if (!reactor->ringPending) {
+            continue;
+        }
+        mutex::Mutex::Lock lock(reactor->ringMutex);
+        if (!reactor->ring) {
+            continue;
+        }
+        io_uring_sqe *sqe = reactor->ring->getSqe();
+        if (!sqe) {
+            continue;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = 0;
+        reactor->ring->submit();
+    }
+}
+
+void IOManager::reapRing(Reactor &reactor, scheduler::Scheduler::TaskList &ready) {
+    mutex::Mutex::Lock lock(reactor.ringMutex);
+    reactor.ring->reap([&](const io_uring_cqe &cqe) {
+        //超时和取消请求的user_data是0
+        if (!cqe.user_data) {
+            return;
+        }
+        auto *req = reinterpret_cast<IoRequest *>(cqe.user_data);
+        req->res = cqe.res;
+        ready.add(&req->fiber);
+        --reactor.ringPending;
+    });
 }
 
 bool IOManager::stopping(uint64_t &timeout) {
     timeout = getNextTimer();
-    return timeout == ~0ull
-           && m_pendingEventCount == 0
-           && Scheduler::stopping();
-
+    if (timeout != ~0ull || m_pendingEventCount != 0) {
+        return false;
+    }
+    for (auto &reactor: m_reactors) {
+        if (reactor->pendingEventCount != 0 || reactor->ringPending != 0) {
+            return false;
+        }
+    }
+    return Scheduler::stopping();
 }
 
 bool IOManager::stopping() {
@@ -242,10 +593,14 @@ bool IOManager::stopping() {
 
 void IOManager::idle() {
     const uint64_t MAX_EVENTS = 256;
-    auto *events = new epoll_event[MAX_EVENTS]();
+    auto *events = new epoll_event[MAX_EVENTS * 2]();
     std::shared_ptr<epoll_event> shared_events(events, [](epoll_event *ptr) {
         delete[] ptr;
     });
+    //后一半用来取共享epoll上的事件(多reactor模式下的第0个线程)
+    epoll_event *nested_events = events + MAX_EVENTS;
+    int index = getWorkerIndex();
+    assert(index >= 0);
 
 
     for (;;) {
@@ -254,53 +609,122 @@ void IOManager::idle() {
             info("name = %s idle stopping exit", get_name().c_str());
             break;
         }
-        int rt;
-        do {
-            static const int MAX_TIMEOUT = 3000;
-            if (next_timeout != ~0ul) {
-                next_timeout = (int) next_timeout > MAX_TIMEOUT ? MAX_TIMEOUT : next_timeout;
-            } else {
-                next_timeout = MAX_TIMEOUT;
-            }
-            rt = epoll_wait(m_epfd, events, MAX_EVENTS, (int) next_timeout);
-            if (!(rt < 0 && errno == EINTR)) {
-                break;
-            }
-        } while (true);
+        static const int MAX_TIMEOUT = 3000;
+        if (next_timeout != ~0ul) {
+            next_timeout = (int) next_timeout > MAX_TIMEOUT ? MAX_TIMEOUT : next_timeout;
+        } else {
+            next_timeout = MAX_TIMEOUT;
+        }
+
+        int rt = 0;
+        int poller = -1;
+        bool polled = false;
+        if (m_multiReactor) {
+            //每个线程等自己的epoll，定时器由第0个线程负责
+            rt = park(index, events, MAX_EVENTS, index == 0 ? (int) next_timeout : MAX_TIMEOUT);
+        } else if (m_poller.compare_exchange_strong(poller, index)) {
+            do {
+                //设置m_poller之后再检查一次任务，避免tickle(worker)以为本线程在忙而丢失
+                ++m_epollWaitCount;
+                rt = epoll_wait(m_epfd, events, MAX_EVENTS, hasTask(index) ? 0 : (int) next_timeout);
+                if (!(rt < 0 && errno == EINTR)) {
+                    break;
+                }
+            } while (true);
+            m_poller = -1;
+            polled = true;
+        } else {
+            //已经有线程在等IO了，在自己的eventfd上等tickle
+            rt = park(index, events, MAX_EVENTS, MAX_TIMEOUT);
+        }
 
+        //这一轮就绪的定时器和fd事件攒在一起，一次入队、一次tickle
+        scheduler::Scheduler::TaskList ready;
         std::vector<std::function<void()> > cbs;
         listExpiredCb(cbs);
-        if (!cbs.empty()) {
-            schedule(cbs.begin(), cbs.end());
-            cbs.clear();
+        for (auto &cb: cbs) {
+            ready.add(&cb);
         }
 
         for (int i = 0; i < rt; ++i) {
-            epoll_event &event = events[i];
-
-            if (event.data.fd == m_tickleFds[0]) {
-                uint8_t dummy[256];
-                while (read(m_tickleFds[0], dummy, sizeof(dummy)) > 0);
-                continue;
+            if (events[i].data.u64 == (uint64_t) m_epfd) {
+                //共享epoll上有事件，取出来一起处理
+                ++m_epollWaitCount;
+                int nested = epoll_wait(m_epfd, nested_events, MAX_EVENTS, 0);
+                processEvents(nested_events, nested, index, ready);
+                events[i].data.ptr = nullptr;
             }
+        }
+        processEvents(events, rt, index, ready);
+        bool has_ready = !ready.empty();
+        scheduleBatch(ready);
+        if (polled && has_ready) {
+            //本线程去执行任务了，没有线程在等m_epfd；任务都绑定在本线程上时enqueue不会tickle，
+            //叫醒一个停在eventfd上的线程接替epoll_wait
+            tickleParked();
+        }
 
-            auto *fd_ctx = static_cast<FdContext *>(event.data.ptr);
-            FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        fiber::Fiber::ptr cur = fiber::Fiber::GetThis();
+        auto raw_ptr = cur.get();
+        cur.reset();
+        raw_ptr->swapOut();
+    }
+}
 
-            if (event.events & (EPOLLERR | EPOLLHUP)) {
-                event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->m_event;
-            }
+void IOManager::processEvents(epoll_event *events, int count, int index, scheduler::Scheduler::TaskList &ready) {
+    for (int i = 0; i < count; ++i) {
+        epoll_event &event = events[i];
+        if (!event.data.ptr) {
+            continue;
+        }
 
-            int real_events = NONE;
+        if (event.data.u64 & RING_TAG) {
+            reapRing(*reinterpret_cast<Reactor *>(event.data.u64 & ~RING_TAG), ready);
+            continue;
+        }
 
-            if (event.events & EPOLLIN) {
-                real_events |= READ;
+        if (event.data.u64 == (uint64_t) m_tickleFd) {
+            uint64_t dummy;
+            while (read(m_tickleFd, &dummy, sizeof(dummy)) > 0);
+            ++m_tickleWakeups;
+            if (hasTask(index)) {
+                ++m_tickleUseful;
             }
+            continue;
+        }
 
-            if (event.events & EPOLLOUT) {
-                real_events |= WRITE;
-            }
+        if (event.data.u64 == (uint64_t) m_reactors[index]->eventfd) {
+            uint64_t dummy;
+            while (read(m_reactors[index]->eventfd, &dummy, sizeof(dummy)) > 0);
+            continue;
+        }
+
+        auto *fd_ctx = static_cast<FdContext *>(event.data.ptr);
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        //fd已经换到别的IOManager上了
+        if (fd_ctx->m_iom != this) {
+            continue;
+        }
+
+        if (event.events & (EPOLLERR | EPOLLHUP)) {
+            event.events |= fd_ctx->m_registered ? (EPOLLIN | EPOLLOUT) : (EPOLLIN | EPOLLOUT) & fd_ctx->m_event;
+        }
+
+        int real_events = NONE;
 
+        if (event.events & EPOLLIN) {
+            real_events |= READ;
+        }
+
+        if (event.events & EPOLLOUT) {
+            real_events |= WRITE;
+        }
+
+        if (fd_ctx->m_registered) {
+            //一直注册着的fd不用改epoll，没人等的事件记下来，下次addEvent直接返回
+            fd_ctx->m_ready = (Event) (fd_ctx->m_ready | (real_events & ~fd_ctx->m_event));
+            real_events &= fd_ctx->m_event;
+        } else {
             if ((fd_ctx->m_event & real_events) == NONE)
                 continue;
 
@@ -308,41 +732,33 @@ void IOManager::idle() {
             int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
             event.events = EPOLLET | left_events;
 
-            int rt2 = epoll_ctl(m_epfd, op, fd_ctx->m_fd, &event);
+            ++m_epollCtlCount;
+            int rt2 = epoll_ctl(getEpfd(fd_ctx), op, fd_ctx->m_fd, &event);
             if (rt2) {
-                error("epoll_ctl :%d,op:%d,fd:%d", m_epfd, op, fd_ctx->m_fd);
+                error("epoll_ctl :%d,op:%d,fd:%d", getEpfd(fd_ctx), op, fd_ctx->m_fd);
                 continue;
             }
+        }
 
-            if (real_events & READ) {
-                fd_ctx->triggerEvent(READ);
-                --m_pendingEventCount;
-            }
-
-            if (real_events & WRITE) {
-                fd_ctx->triggerEvent(WRITE);
-                --m_pendingEventCount;
-            }
+        if (real_events & READ) {
+            fd_ctx->triggerEvent(READ, this, ready);
+            --getPendingCount(fd_ctx);
         }
-        fiber::Fiber::ptr cur = fiber::Fiber::GetThis();
-        auto raw_ptr = cur.get();
-        cur.reset();
-        raw_ptr->swapOut();
-    }
-}
 
-void IOManager::contextResize(size_t size) {
-    m_fdContexts_vertor.resize(size);
-    for (int i = 0; i < m_fdContexts_vertor.size(); ++i) {
-        if (!m_fdContexts_vertor[i]) {
-            m_fdContexts_vertor[i] = new FdContext;
-            m_fdContexts_vertor[i]->m_fd = i;
+        if (real_events & WRITE) {
+            fd_ctx->triggerEvent(WRITE, this, ready);
+            --getPendingCount(fd_ctx);
         }
     }
 }
 
 void IOManager::onTimerInsertedAtFront() {
-    tickle();
+    //超时时间只有epoll_wait的线程关心，多reactor模式下是第0个线程
+    if (m_multiReactor) {
+        tickle(0);
+    } else {
+        ticklePoller();
+    }
 }
 
 IOManager::FdContext::EventContext &IOManager::FdContext::get_context(IOManager::Event event) {
@@ -375,4 +791,21 @@ void IOManager::FdContext::triggerEvent(IOManager::Event event) {
 
     ctx.scheduler = nullptr;
 }
+
+void IOManager::FdContext::triggerEvent(IOManager::Event event, scheduler::Scheduler *owner,
+                                        scheduler::Scheduler::TaskList &tasks) {
+    EventContext &ctx = get_context(event);
+    if (ctx.scheduler != owner) {
+        triggerEvent(event);
+        return;
+    }
+    assert(m_event & event);
+    m_event = (Event) (m_event & ~event);
+    if (ctx.cb) {
+        tasks.add(&ctx.cb);
+    } else {
+        tasks.add(&ctx.fiber);
+    }
+    ctx.scheduler = nullptr;
+}
 } // iomanager
\ No newline at end of file
@@ -9,8 +9,10 @@
   */
 #pragma once
 
+#include <sys/epoll.h>
 #include "Scheduler.h"
 #include "Timer.h"
+#include "IoUring.h"
 namespace hyn::iomanager {
 
 /**
@@ -38,11 +40,27 @@ public:
     };
 
 private:
+    struct Reactor;
+
+public:
+
     /**
      * @brife 存储了一个文件句柄的事件上下文，其中包括读和写两个事件的协程、调度器和回调函数。还包括事件关联的句柄、当前的事件和一个互斥锁。
+     * @note 嵌在FdCtx里，和hook的状态共用一条记录，由FDManger统一管理
      */
     struct FdContext {
         typedef mutex::Mutex MutexType;
+        /**
+         *@brief：等待事件的超时定时器，嵌在上下文里，挂上摘下都不分配内存
+         */
+        struct EventTimer : TimerNode {
+            IOManager *iom = nullptr;
+            FdContext *fd_ctx = nullptr;
+            Event event = NONE;
+            ///是否因为超时被取消
+            bool expired = false;
+        };
+
         struct EventContext {
             ///待执行scheduler
             scheduler::Scheduler *scheduler = nullptr;
@@ -50,6 +68,8 @@ private:
             fiber::Fiber::ptr fiber;
             ///事件回调函数
             std::function<void()> cb;
+            ///超时定时器
+            EventTimer timer;
         };
 
         /**
@@ -71,16 +91,32 @@ private:
          */
         void triggerEvent(Event event);
 
+        /**
+         *@brief：触发事件，要回到owner上执行的任务放进tasks，由调用者统一提交
+         *@parma：事件类型
+         *@parma：调用者所在的调度器
+         *@parma：收集任务的链表
+         */
+        void triggerEvent(Event event, scheduler::Scheduler *owner, scheduler::Scheduler::TaskList &tasks);
+
         ///事件关联句柄
         int m_fd = 0;
-        ///读事件
-        EventContext read;
-        ///写事件
-        EventContext write;
         ///已经注册的事件
         Event m_event = NONE;
+        ///一直注册着时，没有人等的时候来过的事件
+        Event m_ready = NONE;
+        ///是否以EPOLLIN|EPOLLOUT|EPOLLET一直注册在epoll上
+        bool m_registered = false;
+        ///注册在哪个IOManager上，m_event不为NONE时有效
+        IOManager *m_iom = nullptr;
+        ///所在的reactor，nullptr表示注册在共享的m_epfd上
+        Reactor *m_reactor = nullptr;
 
         MutexType mutex;
+        ///读事件
+        EventContext read;
+        ///写事件
+        EventContext write;
     };
 
 public:
@@ -103,6 +139,16 @@ public:
      */
     int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
 
+    /**
+     *@brief：当前协程等待事件，带超时
+     *@parma：socket句柄
+     *@parma：事件类型
+     *@parma：超时时间ms，-1表示不超时
+     *@return：事件到达或者被取消返回0，超时返回ETIMEDOUT，添加失败返回-1
+     *@note：超时用fd上下文里的定时器，不分配内存
+     */
+    int waitEvent(int fd, Event event, uint64_t timeout_ms);
+
     /**
      *@brief：删除事件
      *@parma：socket句柄
@@ -130,9 +176,89 @@ public:
      *@brief：返回当前的IOManager
      */
     static IOManager *GetThis();
+
+    /**
+     *@brief：tickle统计
+     *@parma：sent：实际发出的唤醒次数
+     *@parma：wakeups：空闲线程被唤醒的次数
+     *@parma：useful：唤醒后确实有任务可取的次数
+     */
+    struct TickleStats {
+        uint64_t sent;
+        uint64_t wakeups;
+        uint64_t useful;
+    };
+
+    [[nodiscard]] TickleStats getTickleStats() const;
+
+    /**
+     *@brief：多reactor模式，需要在添加事件之前设置
+     *@note：每个调度线程有自己的epoll，fd第一次在调度线程上注册时加到本线程的epoll里，
+     *       等待该fd的协程固定在这个线程上恢复，不再跨线程epoll_ctl；
+     *       非调度线程注册的fd仍然放在共享的epoll里，由第0个线程负责
+     */
+    void setMultiReactor(bool v);
+
+    [[nodiscard]] bool isMultiReactor() const { return m_multiReactor; }
+
+    /**
+     *@brief：常驻注册模式，需要在添加事件之前设置
+     *@note：fd第一次等待时以EPOLLIN|EPOLLOUT|EPOLLET加到epoll里，之后一直不动，直到cancelAll(一般是close)；
+     *       没有人等的时候来的事件记在fd上下文里，下次等待直接返回，稳定后等待不再调用epoll_ctl；
+     *       要求调用者读写已经返回EAGAIN之后才等待，hook的IO都满足
+     */
+    void setPersistentEvents(bool v) { m_persistentEvents = v; }
+
+    [[nodiscard]] bool isPersistentEvents() const { return m_persistentEvents; }
+
+    /**
+     *@brief：给新连接挑一个reactor，选等待事件最少的线程
+     *@return：线程id，不是多reactor模式返回-1
+     */
+    int nextReactorThread();
+
+    /**
+     *@brief：io_uring模式，需要在添加事件之前设置
+     *@note：被hook的socket IO遇到EAGAIN时不再addEvent等可读写后重试，而是把这次IO作为请求提交给
+     *       当前线程的io_uring，完成后直接带着结果恢复协程；共享栈的协程仍然走epoll
+     *@return：内核不支持io_uring时返回false，继续使用epoll
+     */
+    bool setIoUring(bool v);
+
+    [[nodiscard]] bool isIoUring() const { return m_ioUring; }
+
+    /**
+     *@brief：提交一个io_uring请求并挂起当前协程，完成后恢复
+     *@parma：请求，user_data由这里填写
+     *@parma：超时时间ms，-1表示不超时
+     *@return：请求的结果，失败返回-errno，超时返回-ECANCELED；当前协程不能用io_uring时返回-ENOSYS
+     */
+    int submitIo(const io_uring_sqe &sqe, uint64_t timeout_ms);
+
+    /**
+     *@brief：取消fd上所有还没完成的io_uring请求，关闭fd之前调用
+     */
+    void cancelIo(int fd);
+
+    /**
+     *@brief：IO路径上的系统调用统计
+     *@parma：epollCtl：epoll_ctl次数
+     *@parma：epollWait：epoll_wait次数
+     *@parma：uringEnter：io_uring_enter次数
+     */
+    struct IoStats {
+        uint64_t epollCtl;
+        uint64_t epollWait;
+        uint64_t uringEnter;
+    };
+
+    [[nodiscard]] IoStats getIoStats() const;
+
 protected:
     void tickle() override;
 
+    void tickle(size_t worker) override;
+
     bool stopping() override;
 
     void idle() override;
@@ -140,24 +266,144 @@ protected:
     void onTimerInsertedAtFront() override;
 
     /**
-     *@brief：重置socket上下文句柄容器大小
-     *@param：大小
-     *@return：null
+     *@brief：找到fd的事件上下文，在FDManger的记录里，不加锁
+     *@param：句柄
+     *@param：不存在时是否创建
+     *@return：事件上下文，不存在返回nullptr；可能注册在别的IOManager上，要在锁里检查m_iom
+     */
+    FdContext *getFdContext(int fd, bool auto_create);
+
+    /**
+     *@brief：fd上下文注册在哪个epoll上
+     */
+    int getEpfd(FdContext *fd_ctx) const { return fd_ctx->m_reactor ? fd_ctx->m_reactor->epfd : m_epfd; }
+
+    /**
+     *@brief：fd上下文所在epoll的等待事件计数
      */
-    void contextResize(size_t size);
+    std::atomic<size_t> &getPendingCount(FdContext *fd_ctx) {
+        return fd_ctx->m_reactor ? fd_ctx->m_reactor->pendingEventCount : m_pendingEventCount;
+    }
+
+    /**
+     *@brief：处理epoll_wait返回的事件
+     *@param：事件数组
+     *@param：事件个数
+     *@param：当前线程的下标
+     *@param：收集就绪的任务
+     */
+    void processEvents(epoll_event *events, int count, int index, scheduler::Scheduler::TaskList &ready);
 
     bool stopping(uint64_t &timeout);
+
+    /**
+     *@brief：空闲线程在自己的epoll上等待，tickle通过eventfd只唤醒这一个线程
+     *@parma：当前线程的下标
+     *@parma：事件数组
+     *@parma：事件数组大小
+     *@parma：超时时间ms
+     *@return：epoll_wait返回的事件数
+     */
+    int park(size_t index, epoll_event *events, int max_events, int timeout);
+
+    /**
+     *@brief：唤醒正在epoll_wait的线程
+     */
+    void ticklePoller();
+
+    /**
+     *@brief：唤醒一个在自己eventfd上等待的线程
+     *@return：没有这样的线程返回false
+     */
+    bool tickleParked();
+
+    /**
+     *@brief：当前线程的io_uring，第一次使用时创建
+     *@return：不是调度线程或者创建失败返回nullptr
+     */
+    Reactor *getRing();
+
+    /**
+     *@brief：收割io_uring上完成的请求
+     *@parma：io_uring所在的reactor
+     *@parma：收集就绪的协程
+     */
+    void reapRing(Reactor &reactor, scheduler::Scheduler::TaskList &ready);
+
 private:
+    /**
+     *@brief：添加事件，timeout_ms不为-1时挂上超时定时器
+     *@return：成功返回0，失败-1；常驻注册的fd上事件已经就绪时返回1，什么都没有添加
+     */
+    int addEvent(FdContext *fd_ctx, int fd, Event event, std::function<void()> cb, uint64_t timeout_ms);
+
+    /**
+     *@brief：取消事件，调用者已经加了fd_ctx->mutex
+     */
+    bool cancelEvent(FdContext *fd_ctx, Event event);
+
+    /**
+     *@brief：等待事件超时，取消事件让协程恢复
+     */
+    static void OnEventTimeout(TimerNode *node, uint64_t seq);
+
+    /**
+     *@brief：等待io_uring完成的请求，放在协程栈上
+     */
+    struct IoRequest {
+        fiber::Fiber::ptr fiber;
+        int res = 0;
+    };
+
+    /**
+     *@brief：每个调度线程自己的epoll
+     *@note：默认模式下只注册了eventfd，空闲时在上面等待tickle；
+     *       多reactor模式下本线程的fd也注册在这里，第0个还会注册共享的m_epfd
+     */
+    struct Reactor {
+        int epfd = -1;
+        int eventfd = -1;
+        ///正在等待，tickle时用exchange(false)认领，保证一次只唤醒一个线程
+        std::atomic<bool> parked{false};
+        ///本reactor上等待的事件数量
+        std::atomic<size_t> pendingEventCount{0};
+        ///本线程的io_uring，提交和收割都要加ringMutex
+        std::unique_ptr<IoUring> ring;
+        mutex::Mutex ringMutex;
+        ///已经提交还没完成的io_uring请求数量
+        std::atomic<size_t> ringPending{0};
+    };
+
+    ///epoll_event里io_uring的标记，和FdContext的指针、eventfd区分开
+    static constexpr uint64_t RING_TAG = 1ull << 63;
+
     ///epoll句柄
     int m_epfd;
-    ///pipe句柄
-    int m_tickleFds[2]{};
+    ///唤醒正在epoll_wait(m_epfd)的线程
+    int m_tickleFd;
+    ///每个调度线程的epoll和eventfd
+    std::vector<std::unique_ptr<Reactor>> m_reactors;
+    ///是否多reactor模式
+    std::atomic<bool> m_multiReactor{false};
+    ///是否io_uring模式
+    std::atomic<bool> m_ioUring{false};
+    ///是否常驻注册模式
+    std::atomic<bool> m_persistentEvents{false};
+    ///正在epoll_wait(m_epfd)的线程下标，同一时间只有一个，-1表示没有
+    std::atomic<int> m_poller{-1};
+    ///下一次优先唤醒的线程，轮流唤醒
+    std::atomic<size_t> m_nextParker{0};
+    ///下一个新连接优先分配的reactor
+    std::atomic<size_t> m_nextReactor{0};
+    ///tickle统计
+    std::atomic<uint64_t> m_tickleSent{0};
+    std::atomic<uint64_t> m_tickleWakeups{0};
+    std::atomic<uint64_t> m_tickleUseful{0};
+    ///IO统计
+    std::atomic<uint64_t> m_epollCtlCount{0};
+    std::atomic<uint64_t> m_epollWaitCount{0};
     ///当前等待执行的事件数量
     std::atomic<size_t> m_pendingEventCount{0};
-    ///IOManger的mutex
-    RWMutexType m_rw_mutex;
-    ///socket事件上下文的容器
-    std::vector<FdContext *> m_fdContexts_vertor;
 };
 
 } /// iomanager
@@ -0,0 +1,141 @@
+/**
+  ******************************************************************************
+  * @file           : IoUring.cpp
+  * @author         : hyn
+  * @brief          : None
+  * @attention      : None
+  * @date           : 2023/5/26
+  ******************************************************************************
+  */
+
+#include "IoUring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hyn::iomanager {
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params{};
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        m_sqRing = nullptr;
+        close(fd);
+        return;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            m_cqRing = nullptr;
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = nullptr;
+            close(fd);
+            return;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = m_cqRing = nullptr;
+        close(fd);
+        return;
+    }
+
+    auto *sq = static_cast<char *>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_sqes = static_cast<io_uring_sqe *>(sqes);
+    m_sqEntries = params.sq_entries;
+
+    auto *cq = static_cast<char *>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    m_fd = fd;
+}
+
+IoUring::~IoUring() {
+    if (m_fd < 0) {
+        return;
+    }
+    munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    munmap(m_sqRing, m_sqRingSize);
+    close(m_fd);
+}
+
+io_uring_sqe *IoUring::getSqe() {
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (m_sqeTail - head >= m_sqEntries) {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &m_sqes[m_sqeTail & *m_sqMask];
+    ++m_sqeTail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned IoUring::getSqeSpace() const {
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    return m_sqEntries - (m_sqeTail - head);
+}
+
+int IoUring::submit(unsigned wait) {
+    //提交项的下标按顺序放进array，再一次性推进tail
+    unsigned begin = *m_sqTail;
+    unsigned tail = begin;
+    unsigned count = m_sqeTail - m_sqeHead;
+    for (; m_sqeHead != m_sqeTail; ++m_sqeHead, ++tail) {
+        m_sqArray[tail & *m_sqMask] = m_sqeHead & *m_sqMask;
+    }
+    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+    if (!count && !wait) {
+        return 0;
+    }
+    ++m_enterCount;
+    int rt;
+    do {
+        rt = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, count, wait, wait ? IORING_ENTER_GETEVENTS : 0,
+                                      nullptr, 0));
+    } while (rt < 0 && errno == EINTR);
+    int err = rt < 0 ? errno : 0;
+    //没有SQPOLL，内核只在io_uring_enter里取提交项；没取走的撤回，免得引用已经失效的user_data
+    unsigned consumed = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) - begin;
+    if (consumed < count) {
+        __atomic_store_n(m_sqTail, begin + consumed, __ATOMIC_RELEASE);
+        m_sqeHead = m_sqeTail = begin + consumed;
+    }
+    if (err && !consumed) {
+        return -err;
+    }
+    return static_cast<int>(consumed);
+}
+
+} // hyn::iomanager
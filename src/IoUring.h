@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file           : IoUring.h
+  * @author         : hyn
+  * @brief          : 直接用系统调用封装的io_uring，不依赖liburing
+  * @attention      : 提交和收割都不是线程安全的，由调用者加锁
+  * @date           : 2023/5/26
+  ******************************************************************************
+  */
+#pragma once
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <boost/noncopyable.hpp>
+
+namespace hyn::iomanager {
+
+class IoUring : boost::noncopyable {
+public:
+    /**
+     *@brief：创建io_uring
+     *@parma：队列长度
+     *@note：内核不支持时不抛异常，valid()返回false，由调用者回退到epoll
+     */
+    explicit IoUring(unsigned entries);
+
+    ~IoUring();
+
+    [[nodiscard]] bool valid() const { return m_fd >= 0; }
+
+    [[nodiscard]] int fd() const { return m_fd; }
+
+    /**
+     *@brief：取一个空闲的提交项，已经清零
+     *@return：提交队列满了返回nullptr
+     */
+    io_uring_sqe *getSqe();
+
+    /**
+     *@brief：提交队列里还能取的提交项个数
+     */
+    [[nodiscard]] unsigned getSqeSpace() const;
+
+    /**
+     *@brief：把getSqe拿到的提交项交给内核
+     *@parma：至少等这么多个完成项再返回
+     *@return：内核取走的个数，一个都没取走时返回-errno
+     *@note：没有被内核取走的提交项会被丢弃(从队列尾部撤回)，不会在下次提交时被执行
+     */
+    int submit(unsigned wait = 0);
+
+    /**
+     *@brief：收割所有已经完成的请求
+     *@parma：对每个完成项调用cb(const io_uring_cqe &)
+     *@return：收割的个数
+     */
+    template<typename Callback>
+    unsigned reap(Callback &&cb) {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = tail - head;
+        for (; head != tail; ++head) {
+            cb(m_cqes[head & *m_cqMask]);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    /**
+     *@brief：io_uring_enter的调用次数
+     */
+    [[nodiscard]] uint64_t getEnterCount() const { return m_enterCount; }
+
+private:
+    int m_fd = -1;
+    ///提交队列
+    void *m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    unsigned *m_sqHead = nullptr;
+    unsigned *m_sqTail = nullptr;
+    unsigned *m_sqMask = nullptr;
+    unsigned *m_sqArray = nullptr;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    ///还没有交给内核的提交项
+    unsigned m_sqeTail = 0;
+    unsigned m_sqeHead = 0;
+    unsigned m_sqEntries = 0;
+    ///完成队列，IORING_FEAT_SINGLE_MMAP时和提交队列共用一块映射
+    void *m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned *m_cqMask = nullptr;
+    io_uring_cqe *m_cqes = nullptr;
+    std::atomic<uint64_t> m_enterCount{0};
+};
+
+} // hyn::iomanager
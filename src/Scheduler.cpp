@@ -11,6 +11,7 @@
 
 
 #include <cassert>
+#include <vector>
 #include "Scheduler.h"
 #include "util.h"
 #include "Logger.h"
@@ -22,6 +23,124 @@ namespace hyn::scheduler {
 static thread_local Scheduler *t_scheduler = nullptr;
 ///记录当前线程正在执行的协程对象指针，用于协程的切换和状态保存
 static thread_local fiber::Fiber *t_fiber = nullptr;
+///当前线程在所属调度器里的任务队列,只在run期间有效
+static thread_local void *t_worker = nullptr;
+
+/**
+ *@brief：释放一串用第一个字链起来的空闲Task
+ */
+static void FreeTaskList(void *head) {
+    while (head) {
+        void *next = *static_cast<void **>(head);
+        ::operator delete(head);
+        head = next;
+    }
+}
+
+/**
+ *@brief：线程之间转移空闲Task的公共池，整批存取
+ *@note：Task一般在一个线程分配(epoll_wait的线程、外部提交任务的线程)，在执行它的线程释放，
+ *       只靠线程本地缓存的话分配的一方总是空的、释放的一方总是满的
+ */
+struct TaskPool {
+    static const size_t MAX_BATCHES = 64;
+    mutex::Mutex mutex;
+    ///每一批是BATCH_SIZE个Task串成的链表
+    std::vector<void *> batches;
+    ///batches的大小，空的时候不用加锁
+    std::atomic<size_t> count{0};
+
+    ~TaskPool() {
+        for (auto *batch: batches) {
+            FreeTaskList(batch);
+        }
+    }
+
+    /**
+     *@brief：放入一批，池满了直接释放
+     */
+    void put(void *batch) {
+        {
+            mutex::Mutex::Lock lock(mutex);
+            if (batches.size() < MAX_BATCHES) {
+                batches.push_back(batch);
+                ++count;
+                return;
+            }
+        }
+        FreeTaskList(batch);
+    }
+
+    /**
+     *@brief：取出一批，没有返回nullptr
+     */
+    void *take() {
+        if (!count.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        mutex::Mutex::Lock lock(mutex);
+        if (batches.empty()) {
+            return nullptr;
+        }
+        void *batch = batches.back();
+        batches.pop_back();
+        --count;
+        return batch;
+    }
+};
+
+static TaskPool &GetTaskPool() {
+    static TaskPool pool;
+    return pool;
+}
+
+/**
+ *@brief：当前线程缓存的空闲Task，线程退出时释放；满了拿出一批放进公共池，空了从公共池取一批
+ */
+struct TaskCache {
+    static const size_t MAX_SIZE = 1024;
+    static const size_t BATCH_SIZE = 256;
+    void *head = nullptr;
+    size_t size = 0;
+
+    ~TaskCache() {
+        FreeTaskList(head);
+    }
+
+    void *pop() {
+        if (!head) {
+            head = GetTaskPool().take();
+            if (!head) {
+                return nullptr;
+            }
+            size = BATCH_SIZE;
+        }
+        void *ptr = head;
+        head = *static_cast<void **>(ptr);
+        --size;
+        return ptr;
+    }
+
+    void push(void *ptr) {
+        if (size >= MAX_SIZE) {
+            //前BATCH_SIZE个摘下来交给公共池
+            void *batch = head;
+            void *last = head;
+            for (size_t i = 1; i < BATCH_SIZE; ++i) {
+                last = *static_cast<void **>(last);
+            }
+            head = *static_cast<void **>(last);
+            *static_cast<void **>(last) = nullptr;
+            size -= BATCH_SIZE;
+            GetTaskPool().put(batch);
+        }
+        *static_cast<void **>(ptr) = head;
+        head = ptr;
+        ++size;
+    }
+};
+
+static thread_local TaskCache t_task_cache;
 
 Scheduler::Scheduler(size_t thread, bool use_caller, const std::string &name) : m_name(name) {
     assert(thread > 0);
@@ -37,14 +156,34 @@ Scheduler::Scheduler(size_t thread, bool use_caller, const std::string &name) :
         t_fiber = m_rootFiber.get();
         m_root_thread_id = util::GetThreadId();
         m_thread_id_vector.emplace_back(m_root_thread_id);
+        m_workers.emplace_back(new Worker);
+        m_workers.back()->threadId = m_root_thread_id;
     } else {
         m_root_thread_id = -1;
     }
     m_threadCount = thread;
+    for (size_t i = 0; i < thread; ++i) {
+        m_workers.emplace_back(new Worker);
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->index = i;
+    }
 }
 
 Scheduler::~Scheduler() {
     assert(m_stopping);
+    //没来得及执行的任务，连同它们持有的协程一起释放
+    for (auto &worker: m_workers) {
+        while (Task *task = worker->queue.steal()) {
+            delete task;
+        }
+        mutexType::Lock lock(worker->inboxMutex);
+        worker->inbox.clear();
+        worker->inboxSize = 0;
+    }
+    mutexType::Lock lock(m_mutex);
+    m_task_queue.clear();
+    m_globalTaskCount = 0;
     if (GetThis() == this) {
         t_scheduler = nullptr;
     }
@@ -60,8 +199,15 @@ void Scheduler::start() {
     assert(m_thread_pool.empty());
 
     m_thread_pool.resize(m_threadCount);
+    size_t offset = m_workers.size() - m_threadCount;
     for (size_t i = 0; i < m_threadCount; ++i) {
-        m_thread_pool[i].reset(new thread::Thread([this] { run(); }, m_name + "_" + std::to_string(i)));
+        Worker *worker = m_workers[offset + i].get();
+        m_thread_pool[i].reset(new thread::Thread([this, worker] {
+            worker->threadId = util::GetThreadId();
+            run();
+        }, m_name + "_" + std::to_string(i)));
+        //Thread构造返回时线程id已经确定，但回调可能还没开始执行，这里先设置好，start返回后就能按线程id投递任务
+        worker->threadId = m_thread_pool[i]->getId();
         m_thread_id_vector.push_back(m_thread_pool[i]->getId());
     }
     lock.unlock();
@@ -125,6 +271,39 @@ void Scheduler::tickle() {
     debug("tickle");
 }
 
+void Scheduler::tickle(size_t worker) {
+    //基类没有可唤醒的等待，和tickle()一样只记录
+    debug("tickle worker:%zu", worker);
+}
+
+void *Scheduler::Task::operator new(size_t size) {
+    void *ptr = t_task_cache.pop();
+    return ptr ? ptr : ::operator new(size);
+}
+
+void Scheduler::Task::operator delete(void *ptr) {
+    t_task_cache.push(ptr);
+}
+
+int Scheduler::getWorkerIndex() const {
+    if (t_scheduler != this || !t_worker) {
+        return -1;
+    }
+    return static_cast<int>(static_cast<Worker *>(t_worker)->index);
+}
+
+bool Scheduler::hasTask(size_t worker) const {
+    if (m_workers[worker]->inboxSize > 0 || m_globalTaskCount > 0) {
+        return true;
+    }
+    for (auto &i: m_workers) {
+        if (!i->queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * 设置当前线程的scheduler
  * 设置当前线程的run,fiber
@@ -142,43 +321,30 @@ void Scheduler::run() {
     }
     fiber::Fiber::ptr idle_fiber(new fiber::Fiber([this] { idle(); })); //当调度任务都完成之后去做
     fiber::Fiber::ptr cb_fiber;
+    Worker *worker = getWorker(util::GetThreadId());
+    assert(worker);
+    t_worker = worker;
     Task task;
     while (true) {
         task.reset();
-        bool tickle_me = false;
-        bool is_active = false;
-        {
-            mutexType::Lock lock(m_mutex);
-            auto it = m_task_queue.begin();
-            while (it != m_task_queue.end()) {
-                if (it->thread != -1 && it->thread != util::GetThreadId()) {
-                    //当前执行run的线程id不等于期望的线程id，不能处理，通知别人处理
-                    ++it;
-                    tickle_me = true;
-                    continue;
-                }
-
-                assert(it->fiber || it->cb);
-
-                if (it->fiber && it->fiber->getState() == fiber::Fiber::EXEC) {
-                    //如果是fiber ,并且正在执行，不处理
-                    ++it;
-                    continue;
-                }
-
-                //把任务拿出来
-                task = *it;
-                m_task_queue.erase(it++);
-                ++m_active_thread_count;
-                is_active = true;
-                break;
+        //先计入活跃线程再取任务，保证stopping()不会在任务出队后、开始执行前误判
+        ++m_active_thread_count;
+        Task *next = takeTask(worker);
+        if (next) {
+            if (next->fiber && next->fiber->getState() == fiber::Fiber::EXEC) {
+                //协程还没有在别的线程上切出，放回去稍后再处理
+                enqueue(next);
+                --m_active_thread_count;
+                continue;
             }
-            tickle_me |= it != m_task_queue.end();
-
-        }
-
-        if (tickle_me) {
-            tickle();
+            task = std::move(*next);
+            delete next;
+            if (!worker->queue.empty() || m_globalTaskCount > 0) {
+                //还有剩余任务，唤醒其他线程来窃取
+                tickle();
+            }
+        } else {
+            --m_active_thread_count;
         }
 
         if (task.fiber && task.fiber->getState() != fiber::Fiber::TERM &&
@@ -201,9 +367,13 @@ void Scheduler::run() {
             if (cb_fiber) {
                 cb_fiber->reset(task.cb);
             } else {
-                cb_fiber.reset(new fiber::Fiber(task.cb));
+                cb_fiber.reset(new fiber::Fiber(task.cb, 0, false, m_sharedStack));
             }
 
+            if (task.thread != -1) {
+                //绑定线程的任务切出后也回到这个线程
+                cb_fiber->setOwnerThread(task.thread);
+            }
             task.reset();
             cb_fiber->swapIn();
             --m_active_thread_count;
@@ -221,7 +391,7 @@ void Scheduler::run() {
 
         } else {
 
-            if (is_active) {
+            if (next) {
                 --m_active_thread_count;
                 continue;
             }
@@ -241,11 +411,188 @@ void Scheduler::run() {
             }
         }
     }
+    t_worker = nullptr;
 }
 
-bool Scheduler::stopping() {
+bool Scheduler::enqueue(Task *task) {
+    ++m_taskCount;
+    Worker *target = task->thread != -1 ? getWorker(task->thread) : nullptr;
+    if (!target && task->thread != -1 && !(task->fiber && task->fiber->isSharedStack())) {
+        //固定在其他调度器线程上的协程切换过来，按普通任务处理
+        task->thread = -1;
+    }
+    if (target) {
+        //绑定线程的任务直接放进目标线程的inbox
+        bool need_tickle;
+        {
+            mutexType::Lock lock(target->inboxMutex);
+            need_tickle = target->inbox.empty() && target != t_worker;
+            target->inbox.push_back(task);
+            ++target->inboxSize;
+        }
+        if (need_tickle) {
+            //只有目标线程能执行，直接唤醒它
+            tickle(target->index);
+        }
+        return false;
+    }
+    if (task->thread == -1 && t_worker && t_scheduler == this) {
+        auto *worker = static_cast<Worker *>(t_worker);
+        bool need_tickle = worker->queue.empty();
+        worker->queue.push(task);
+        return need_tickle;
+    }
+    mutexType::Lock lock(m_mutex);
+    bool need_tickle = m_task_queue.empty();
+    m_task_queue.push_back(task);
+    ++m_globalTaskCount;
+    return need_tickle;
+}
+
+void Scheduler::scheduleBatch(TaskList &tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    if (enqueue(tasks)) {
+        tickle();
+    }
+}
+
+bool Scheduler::enqueue(TaskList &tasks) {
+    m_taskCount += tasks.size();
+    auto *self = t_scheduler == this ? static_cast<Worker *>(t_worker) : nullptr;
+    bool need_tickle = false;
+    TaskList global;
+    //按目标线程分组，每个inbox只加一次锁
+    std::unique_ptr<TaskList[]> pinned;
+    while (Task *task = tasks.pop_front()) {
+        Worker *target = task->thread != -1 ? getWorker(task->thread) : nullptr;
+        if (!target && task->thread != -1 && !(task->fiber && task->fiber->isSharedStack())) {
+            task->thread = -1;
+        }
+        if (target) {
+            if (!pinned) {
+                pinned.reset(new TaskList[m_workers.size()]);
+            }
+            pinned[target->index].push_back(task);
+            continue;
+        } else if (task->thread == -1 && self) {
+            need_tickle = need_tickle || self->queue.empty();
+            self->queue.push(task);
+            continue;
+        }
+        global.push_back(task);
+    }
+    for (size_t i = 0; pinned && i < m_workers.size(); ++i) {
+        if (pinned[i].empty()) {
+            continue;
+        }
+        Worker *target = m_workers[i].get();
+        size_t count = pinned[i].size();
+        bool need_tickle_target;
+        {
+            mutexType::Lock lock(target->inboxMutex);
+            need_tickle_target = target->inbox.empty() && target != self;
+            target->inbox.append(pinned[i]);
+            target->inboxSize += count;
+        }
+        if (need_tickle_target) {
+            tickle(target->index);
+        }
+    }
+    if (!global.empty()) {
+        mutexType::Lock lock(m_mutex);
+        need_tickle = need_tickle || m_task_queue.empty();
+        m_task_queue.append(global);
+        m_globalTaskCount = m_task_queue.size();
+    }
+    return need_tickle;
+}
+
+Scheduler::Task *Scheduler::takeTask(Worker *worker) {
+    Task *task = nullptr;
+    if (worker->inboxSize > 0) {
+        mutexType::Lock lock(worker->inboxMutex);
+        if (!worker->inbox.empty()) {
+            task = worker->inbox.pop_front();
+            --worker->inboxSize;
+        }
+    }
+    if (!task) {
+        task = worker->queue.steal();
+    }
+    if (!task && m_globalTaskCount > 0) {
+        task = takeGlobal(worker);
+    }
+    if (!task) {
+        task = stealTask(worker);
+    }
+    if (task) {
+        --m_taskCount;
+    }
+    return task;
+}
+
+Scheduler::Task *Scheduler::takeGlobal(Worker *worker) {
+    static const size_t MAX_BATCH = 32;
+    Task *task = nullptr;
+    size_t count = 0;
+    //绑定到不属于本调度器的线程的任务，不能处理，放回队头
+    TaskList skipped;
     mutexType::Lock lock(m_mutex);
-    return m_auto_stop && m_stopping && m_task_queue.empty() && m_active_thread_count == 0;
+    while (count < MAX_BATCH && !m_task_queue.empty()) {
+        Task *next = m_task_queue.pop_front();
+        if (next->thread != -1 && (task || next->thread != worker->threadId)) {
+            skipped.push_back(next);
+            continue;
+        }
+        if (!task) {
+            task = next;
+        } else {
+            //多拿一些放到本线程队列，其他线程可以再来窃取
+            worker->queue.push(next);
+        }
+        ++count;
+    }
+    skipped.append(m_task_queue);
+    m_task_queue.swap(skipped);
+    m_globalTaskCount = m_task_queue.size();
+    return task;
+}
+
+Scheduler::Task *Scheduler::stealTask(Worker *worker) {
+    static thread_local uint32_t s_seed = util::GetThreadId();
+    size_t n = m_workers.size();
+    if (n < 2) {
+        return nullptr;
+    }
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    size_t start = s_seed % n;
+    for (size_t i = 0; i < n; ++i) {
+        Worker *victim = m_workers[(start + i) % n].get();
+        if (victim == worker) {
+            continue;
+        }
+        if (Task *task = victim->queue.steal()) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+Scheduler::Worker *Scheduler::getWorker(int thread) {
+    for (auto &worker: m_workers) {
+        if (worker->threadId == thread) {
+            return worker.get();
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::stopping() {
+    return m_auto_stop && m_stopping && m_taskCount == 0 && m_active_thread_count == 0;
 }
 
 void Scheduler::SetThis() {
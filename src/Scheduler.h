@@ -16,6 +16,7 @@
 #include "mutex.h"
 #include "fiber.h"
 #include "thread.h"
+#include "WorkStealingQueue.h"
 
 namespace hyn::scheduler {
 
@@ -30,7 +31,8 @@ N-M协程调度器的优点是可以充分利用多核处理器的性能，实
  *@brief：Scheduler
  *@parma：mutexType m_mutex;
  *@parma：std::vector<thread::Thread::ptr> m_thread_pool;     线程对象列表
- *@parma：std::list<Task> m_task_queue;                       任务集合
+ *@parma：std::vector<std::unique_ptr<Worker>> m_workers;     每个线程的任务队列
+ *@parma：TaskList m_task_queue;                             外部线程提交的任务集合
  *@parma：std::string m_name;
  */
 
@@ -39,6 +41,147 @@ public:
     typedef std::shared_ptr<Scheduler> ptr;
     typedef ::hyn::mutex::Mutex mutexType;
 
+    /**
+     *@brief：调度任务，协程和回调函数二选一
+     */
+    struct Task {
+        fiber::Fiber::ptr fiber;
+        std::function<void()> cb;
+        int thread;
+        ///TaskList中的下一个任务
+        Task *next = nullptr;
+
+        Task(fiber::Fiber::ptr f, int thr) : fiber(std::move(f)), thread(thr) {
+            pin();
+        }
+
+        Task(fiber::Fiber::ptr *f, int thr) : thread(thr) {
+            fiber.swap(*f);
+            pin();
+        }
+
+        Task(std::function<void()> f, int thr) : cb(std::move(f)), thread(thr) {}
+
+        Task(std::function<void()> *f, int thr) : thread(thr) {
+            cb.swap(*f);
+        }
+
+        Task() : thread(-1) {}
+
+        /**
+         *@作用：每次调度都要分配Task，用线程本地的空闲链表复用
+         */
+        static void *operator new(size_t size);
+
+        static void operator delete(void *ptr);
+
+        /**
+         *@作用：固定了线程的协程回到该线程执行，共享栈协程忽略调用者指定的线程
+         */
+        void pin() {
+            if (fiber && fiber->getOwnerThread() != -1 && (thread == -1 || fiber->isSharedStack())) {
+                thread = fiber->getOwnerThread();
+            }
+        }
+
+        /**
+         *@作用：重置
+         *@参数：null
+         *@返回值：null
+         */
+        void reset() {
+            fiber = nullptr;
+            cb = nullptr;
+            thread = -1;
+        }
+    };
+
+    /**
+     *@brief：用Task::next串起来的任务链表，整体拼接是O(1)的，用来批量提交任务
+     */
+    class TaskList : boost::noncopyable {
+    public:
+        TaskList() = default;
+
+        ~TaskList() { clear(); }
+
+        /**
+         *@brief：添加一个任务，参数和schedule相同
+         */
+        template<typename fiber_or_callback>
+        void add(fiber_or_callback fc, int thread = -1) {
+            auto *task = new Task(fc, thread);
+            if (!task->fiber && !task->cb) {
+                delete task;
+                return;
+            }
+            push_back(task);
+        }
+
+        void push_back(Task *task) {
+            task->next = nullptr;
+            if (m_tail) {
+                m_tail->next = task;
+            } else {
+                m_head = task;
+            }
+            m_tail = task;
+            ++m_size;
+        }
+
+        Task *pop_front() {
+            Task *task = m_head;
+            if (task) {
+                m_head = task->next;
+                if (!m_head) {
+                    m_tail = nullptr;
+                }
+                task->next = nullptr;
+                --m_size;
+            }
+            return task;
+        }
+
+        /**
+         *@brief：把other整个接到末尾，other变为空
+         */
+        void append(TaskList &other) {
+            if (!other.m_head) {
+                return;
+            }
+            if (m_tail) {
+                m_tail->next = other.m_head;
+            } else {
+                m_head = other.m_head;
+            }
+            m_tail = other.m_tail;
+            m_size += other.m_size;
+            other.m_head = other.m_tail = nullptr;
+            other.m_size = 0;
+        }
+
+        void swap(TaskList &other) {
+            std::swap(m_head, other.m_head);
+            std::swap(m_tail, other.m_tail);
+            std::swap(m_size, other.m_size);
+        }
+
+        void clear() {
+            while (Task *task = pop_front()) {
+                delete task;
+            }
+        }
+
+        [[nodiscard]] bool empty() const { return m_size == 0; }
+
+        [[nodiscard]] size_t size() const { return m_size; }
+
+    private:
+        Task *m_head = nullptr;
+        Task *m_tail = nullptr;
+        size_t m_size = 0;
+    };
+
     /**
      *@brief：构造函数
      *@parma：创建的线程数
@@ -68,12 +211,7 @@ public:
      */
     template<typename fiber_or_callback>
     void schedule(fiber_or_callback fc, int thread = -1) {
-        bool need_tickle = false;
-        {
-            mutexType::Lock lock(m_mutex);
-            need_tickle = scheduleNoLock(fc, thread);
-        }
-        if (need_tickle) {
+        if (scheduleNoTickle(fc, thread)) {
             tickle();
         }
     }
@@ -86,21 +224,32 @@ public:
      */
     template<typename InputIter>
     void schedule(InputIter begin, InputIter end) {
-        bool need_tickle = false;
-        {
-            mutexType::Lock lock(m_mutex);
-            while (begin != end) {
-                ///全部添加完成之后是否需要tickle
-                need_tickle = scheduleNoLock(&(*begin), -1) || need_tickle;
-                ++begin;
-            }
+        TaskList tasks;
+        while (begin != end) {
+            tasks.add(&(*begin), -1);
+            ++begin;
         }
-        if (need_tickle)
-            tickle();
+        scheduleBatch(tasks);
     }
 
+    /**
+     *@作用：批量添加任务，每个目标队列只加一次锁，全部放完之后最多tickle一次，
+     *      绑定线程的任务直接唤醒目标线程
+     *@参数：tasks：任务链表，调用后为空
+     */
+    void scheduleBatch(TaskList &tasks);
+
     void switchTo(int thread = -1);
 
+    /**
+     *@brief：设置回调任务是否运行在共享栈协程上，需要在schedule任务之前设置
+     *@note：共享栈协程挂起时只保存实际用到的栈，适合大量空闲长连接；协程会固定在创建它的线程上恢复，
+     *       挂起期间不能把栈上变量的地址交给其他协程使用
+     */
+    void setSharedStack(bool v) { m_sharedStack = v; }
+
+    [[nodiscard]] bool isSharedStack() const { return m_sharedStack; }
+
 public:
     static Scheduler *GetThis();
 
@@ -114,6 +263,13 @@ protected:
      */
     virtual void tickle();
 
+    /**
+     *@作用：通知指定的调度线程，有绑定到它的任务
+     *@参数：worker：线程在调度器中的下标
+     *@返回值：null
+     */
+    virtual void tickle(size_t worker);
+
     /**
      *@作用：协程调度器
      *@参数：null
@@ -147,52 +303,93 @@ protected:
         return m_idle_thread_count > 0;
     }
 
+    /**
+     *@作用：调度线程的个数，包括use_caller的主线程
+     */
+    [[nodiscard]] size_t getWorkerCount() const { return m_workers.size(); }
+
+    /**
+     *@作用：当前线程在调度器中的下标，不是本调度器的线程返回-1
+     */
+    [[nodiscard]] int getWorkerIndex() const;
+
+    /**
+     *@作用：指定调度线程的线程id，线程还没启动时返回-1
+     */
+    [[nodiscard]] int getWorkerThreadId(size_t worker) const { return m_workers[worker]->threadId; }
+
+    /**
+     *@作用：指定的调度线程现在是否有任务可以取
+     */
+    [[nodiscard]] bool hasTask(size_t worker) const;
+
 private:
     /**
-     *@作用：添加任务（无锁）
+     *@作用：添加任务，不唤醒调度器
      *@参数：fc：可执行实例
      *@参数：thread：要绑定id
      *@返回值：是否需要唤醒调度器
      */
     template<typename fiber_or_callback>
-    bool scheduleNoLock(fiber_or_callback fc, int thread) {
-        bool need_tickle = m_task_queue.empty();
-        Task task(fc, thread);
-        if (task.fiber || task.cb)
-            m_task_queue.push_back(task);
-        return need_tickle;
+    bool scheduleNoTickle(fiber_or_callback fc, int thread) {
+        auto *task = new Task(fc, thread);
+        if (!task->fiber && !task->cb) {
+            delete task;
+            return false;
+        }
+        return enqueue(task);
     }
 
-    struct Task {
-        fiber::Fiber::ptr fiber;
-        std::function<void()> cb;
-        int thread;
+    /**
+     *@brief：每个调度线程的任务队列
+     *@note：queue只有本线程push，空闲线程可以从中窃取；
+     *       inbox存放绑定到该线程的任务，其他线程也会往里放，不能被窃取
+     */
+    struct Worker {
+        ///在m_workers中的下标
+        size_t index = 0;
+        ///线程id,线程启动后设置
+        std::atomic<int> threadId{-1};
+        WorkStealingQueue<Task> queue;
+        mutexType inboxMutex;
+        TaskList inbox;
+        std::atomic<size_t> inboxSize{0};
+    };
 
-        Task(fiber::Fiber::ptr f, int thr) : fiber(std::move(f)), thread(thr) {}
+    /**
+     *@作用：把任务放进对应的队列
+     *@参数：task：堆上分配的任务，所有权交给调度器
+     *@返回值：是否需要唤醒调度器
+     */
+    bool enqueue(Task *task);
 
-        Task(fiber::Fiber::ptr *f, int thr) : thread(thr) {
-            fiber.swap(*f);
-        }
+    /**
+     *@作用：把一批任务按目标队列分组后放进去
+     *@返回值：是否需要唤醒调度器
+     */
+    bool enqueue(TaskList &tasks);
 
-        Task(std::function<void()> f, int thr) : cb(std::move(f)), thread(thr) {}
+    /**
+     *@作用：取一个任务：本线程inbox -> 本线程队列 -> 全局队列 -> 随机窃取其他线程
+     *@参数：worker：当前线程的队列
+     *@返回值：任务，没有返回nullptr
+     */
+    Task *takeTask(Worker *worker);
 
-        Task(std::function<void()> *f, int thr) : thread(thr) {
-            cb.swap(*f);
-        }
+    /**
+     *@作用：从全局队列取任务，多取的放到本线程队列里
+     */
+    Task *takeGlobal(Worker *worker);
 
-        Task() : thread(-1) {}
+    /**
+     *@作用：随机挑选其他线程窃取任务
+     */
+    Task *stealTask(Worker *worker);
 
-        /**
-         *@作用：重置
-         *@参数：null
-         *@返回值：null
-         */
-        void reset() {
-            fiber = nullptr;
-            cb = nullptr;
-            thread = -1;
-        }
-    };
+    /**
+     *@作用：根据线程id找到对应的队列
+     */
+    Worker *getWorker(int thread);
 
 protected:
     ///线程id数组
@@ -209,12 +406,20 @@ protected:
     bool m_auto_stop{false};
     ///主线程id
     int m_root_thread_id{0};
+    ///回调任务是否使用共享栈协程
+    bool m_sharedStack{false};
 private:
     mutexType m_mutex;
     ///线程池
     std::vector<thread::Thread::ptr> m_thread_pool;
-    ///待执行的协程队列
-    std::list<Task> m_task_queue;
+    ///每个调度线程的任务队列，use_caller时第0个属于主线程
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    ///非调度线程提交的任务
+    TaskList m_task_queue;
+    ///m_task_queue的大小，空的时候不用加锁
+    std::atomic<size_t> m_globalTaskCount{0};
+    ///还没有开始执行的任务总数
+    std::atomic<size_t> m_taskCount{0};
     ///协程调度器名称
     std::string m_name;
     ///use_caller为true有效，调度协程
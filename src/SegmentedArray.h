@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * @file           : SegmentedArray.h
+  * @author         : hyn
+  * @brief          : 只增不减的分段数组，按下标两级索引，查找不加锁
+  * @attention      : None
+  * @date           : 2023/5/29
+  ******************************************************************************
+  */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <boost/noncopyable.hpp>
+
+namespace hyn {
+
+/**
+ *@brief：分段数组
+ *@note：每段(1 << SEGMENT_BITS)个元素，段指针用原子变量发布，查找是两次数组下标，不加锁也不等待；
+ *       段分配之后不会移动也不会释放，元素的地址一直有效，元素自己的并发访问由T负责(一般是std::atomic)
+ */
+template<typename T, size_t SEGMENT_BITS = 12, size_t MAX_SEGMENTS = 4096>
+class SegmentedArray : boost::noncopyable {
+public:
+    static constexpr size_t SEGMENT_SIZE = 1 << SEGMENT_BITS;
+
+    SegmentedArray() {
+        for (auto &segment: m_segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SegmentedArray() {
+        for (auto &segment: m_segments) {
+            delete segment.load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     *@brief：下标对应的元素
+     *@param：下标
+     *@param：所在的段还没分配时是否分配
+     *@return：段不存在且不分配，或者下标超出容量时返回nullptr
+     */
+    T *at(size_t index, bool create) {
+        size_t seg = index >> SEGMENT_BITS;
+        if (seg >= MAX_SEGMENTS) {
+            return nullptr;
+        }
+        Segment *segment = m_segments[seg].load(std::memory_order_acquire);
+        if (!segment) {
+            if (!create) {
+                return nullptr;
+            }
+            //多个线程同时分配时只有一个能发布出去，其他的释放自己的
+            auto *created = new Segment;
+            if (m_segments[seg].compare_exchange_strong(segment, created, std::memory_order_acq_rel)) {
+                segment = created;
+            } else {
+                delete created;
+            }
+        }
+        return &segment->items[index & (SEGMENT_SIZE - 1)];
+    }
+
+    /**
+     *@brief：遍历已经分配的元素
+     */
+    template<typename Func>
+    void forEach(Func &&func) {
+        for (auto &seg: m_segments) {
+            Segment *segment = seg.load(std::memory_order_acquire);
+            if (!segment) {
+                continue;
+            }
+            for (auto &item: segment->items) {
+                func(item);
+            }
+        }
+    }
+
+    [[nodiscard]] static constexpr size_t capacity() { return MAX_SEGMENTS << SEGMENT_BITS; }
+
+private:
+    struct Segment {
+        T items[SEGMENT_SIZE]{};
+    };
+
+    std::atomic<Segment *> m_segments[MAX_SEGMENTS];
+};
+
+} // hyn
@@ -13,6 +13,7 @@
 #include "Servlet.h"
 
 #include <utility>
+#include <cstring>
 #include <fnmatch.h>
 
 namespace hyn {
@@ -122,14 +123,28 @@ Servlet::ptr ServletDispatch::getGlobServlet(const std::string &uri) {
     return nullptr;
 }
 
-Servlet::ptr ServletDispatch::getMatchedServlet(const std::string &uri) {
+Servlet::ptr ServletDispatch::getMatchedServlet(std::string_view uri) {
     RWMutexType::ReadLock lock(m_mutex);
     auto mit = m_datas.find(uri);
     if (mit != m_datas.end()) {
         return mit->second->get();
     }
+    if (m_globs.empty()) {
+        return m_default;
+    }
+    //fnmatch要以'\0'结尾的字符串，路径不长时拷到栈上
+    char buff[256];
+    std::string long_uri;
+    const char *path = buff;
+    if (uri.size() < sizeof(buff)) {
+        memcpy(buff, uri.data(), uri.size());
+        buff[uri.size()] = '\0';
+    } else {
+        long_uri.assign(uri);
+        path = long_uri.c_str();
+    }
     for (auto &m_glob: m_globs) {
-        if (!fnmatch(m_glob.first.c_str(), uri.c_str(), 0)) {
+        if (!fnmatch(m_glob.first.c_str(), path, 0)) {
             return m_glob.second->get();
         }
     }
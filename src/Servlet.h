@@ -9,6 +9,9 @@
   */
 #pragma once
 
+#include <functional>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 
 #include "Http.h"
@@ -250,8 +253,9 @@ public:
      * @brief 通过uri获取servlet
      * @param[in] uri uri
      * @return 优先精准匹配,其次模糊匹配,最后返回默认
+     * @note 直接用请求里的路径视图查找，不构造std::string
      */
-    Servlet::ptr getMatchedServlet(const std::string &uri);
+    Servlet::ptr getMatchedServlet(std::string_view uri);
 
     /**
      *@brief 将所有URI与对应的ServletCreator信息输出（m_datas）
@@ -266,9 +270,18 @@ public:
     void listAllGlobServletCreator(std::map<std::string, IServletCreator::ptr> &infos);
 
 private:
+    /**
+     *@brief 支持用std::string_view直接查找的哈希
+     */
+    struct UriHash {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view uri) const { return std::hash<std::string_view>()(uri); }
+    };
+
     RWMutexType m_mutex;
     ///存储 URL 路径与 IServletCreator 对象之间的映射关系
-    std::unordered_map<std::string, IServletCreator::ptr> m_datas;
+    std::unordered_map<std::string, IServletCreator::ptr, UriHash, std::equal_to<>> m_datas;
     ///存储全局的 URL 路径与 IServletCreator 对象之间的映射关系(支持通配符*)
     std::vector<std::pair<std::string, IServletCreator::ptr>> m_globs;
     ///默认servlet
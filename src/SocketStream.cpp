@@ -10,6 +10,9 @@
 
 #include "SocketStream.h"
 
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
 #include <utility>
 
 namespace hyn {
@@ -20,6 +23,7 @@ SocketStream::SocketStream(Socket::ptr sock, bool owner) : m_socket(std::move(so
 SocketStream::~SocketStream() {
     if (m_owner && m_socket)
         m_socket->close();
+    closePipe();
 }
 
 int SocketStream::read(void *buffer, size_t length) {
@@ -32,7 +36,7 @@ int SocketStream::read(ByteArray::ptr ba, size_t length) {
     if (!isConnected())
         return -1;
     std::vector<iovec> iovecs;
-    ba->getReadBuffers(iovecs, length);
+    ba->getWriteBuffers(iovecs, length);
     int rt = m_socket->recv(&iovecs[0], iovecs.size());
     if (rt > 0)
         ba->setPos(ba->getPos() + rt);
@@ -49,16 +53,76 @@ int SocketStream::write(ByteArray::ptr ba, size_t length) {
     if (!isConnected())
         return -1;
     std::vector<iovec> iovecs;
-    ba->getWriteBuffers(iovecs, length);
+    if (ba->getReadBuffers(iovecs, length) == 0)
+        return 0;
     int rt = m_socket->send(&iovecs[0], iovecs.size());
     if (rt > 0)
         ba->setPos(ba->getPos() + rt);
     return rt;
 }
 
+int64_t SocketStream::sendFile(int fd, off_t offset, size_t len) {
+    if (!isConnected())
+        return -1;
+    size_t done = 0;
+    while (done < len) {
+        //socket是hook过的，发送缓冲区满时让出协程
+        ssize_t n = ::sendfile(m_socket->getSocket(), fd, &offset, len - done);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return (int64_t) done;
+}
+
+int64_t SocketStream::spliceFrom(const Stream::ptr &src, size_t len) {
+    auto sock = std::dynamic_pointer_cast<SocketStream>(src);
+    if (!sock || !isConnected() || !sock->isConnected())
+        return Stream::spliceFrom(src, len);
+    if (m_pipe[0] < 0 && pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+        return Stream::spliceFrom(src, len);
+    int in = sock->getSocket()->getSocket();
+    int out = m_socket->getSocket();
+    size_t done = 0;
+    while (done < len) {
+        //每次都把管道排空，管道只会因为socket没数据而返回EAGAIN
+        ssize_t n = ::splice(in, nullptr, m_pipe[1], nullptr, len - done, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n <= 0)
+            return done ? (int64_t) done : n;
+        while (n > 0) {
+            ssize_t m = ::splice(m_pipe[0], nullptr, out, nullptr, n, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (m <= 0) {
+                //管道里剩下的数据没法再发出去，丢掉
+                closePipe();
+                return done ? (int64_t) done : m;
+            }
+            n -= m;
+            done += m;
+        }
+    }
+    return (int64_t) done;
+}
+
+int64_t SocketStream::write(const iovec *iov, int iovcnt) {
+    if (!isConnected())
+        return -1;
+    return m_socket->send(iov, iovcnt);
+}
+
 void SocketStream::close() {
     if (m_socket)
         m_socket->close();
+    closePipe();
+}
+
+void SocketStream::closePipe() {
+    if (m_pipe[0] >= 0) {
+        ::close(m_pipe[0]);
+        ::close(m_pipe[1]);
+        m_pipe[0] = m_pipe[1] = -1;
+    }
 }
 
 bool SocketStream::isConnected() const {
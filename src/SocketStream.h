@@ -78,6 +78,35 @@ public:
      */
     int write(ByteArray::ptr ba, size_t length) override;
 
+    /**
+     * @brief 一次writev写入多段内存
+     * @return
+     *      @retval >0 返回实际发送的数据长度
+     *      @retval =0 socket被远端关闭
+     *      @retval <0 socket错误
+     */
+    int64_t write(const iovec *iov, int iovcnt) override;
+
+    /**
+     * @brief 用sendfile把文件的一段直接发到socket，数据不经过用户态
+     * @return
+     *      @retval >0 实际发送的数据长度，文件不够len时小于len
+     *      @retval =0 文件从offset开始已经没有数据(len为0或者到了文件末尾)
+     *      @retval <0 socket或文件错误
+     */
+    int64_t sendFile(int fd, off_t offset, size_t len) override;
+
+    /**
+     * @brief 从src转发len字节到socket
+     * @note src也是SocketStream时经过管道splice，数据不经过用户态；否则走Stream的默认实现
+     * @return
+     *      @retval >0 转发的数据长度，src提前结束或中途出错时小于len
+     *      @retval =0 src已经到了结尾，一个字节也没有转发
+     *      @retval <0 一个字节也没有转发就出错
+     * @attention 中途出错时返回已经写到socket的长度，已经从src读出但还没写出去的部分丢失
+     */
+    int64_t spliceFrom(const Stream::ptr &src, size_t len) override;
+
     /**
      * @brief 关闭socket
      */
@@ -94,8 +123,15 @@ public:
     [[nodiscard]] bool isConnected() const;
 
 private:
+    /**
+     * @brief 关闭splice用的管道，管道里可能留着没转发完的数据
+     */
+    void closePipe();
+
     Socket::ptr m_socket;
     bool m_owner;
+    ///splice用的管道，第一次spliceFrom时创建
+    int m_pipe[2]{-1, -1};
 };
 
 
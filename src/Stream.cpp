@@ -11,6 +11,9 @@
 
 
 #include "Stream.h"
+#include <algorithm>
+#include <unistd.h>
+#include <vector>
 
 namespace hyn {
 
@@ -61,4 +64,74 @@ int Stream::writeFixSize(ByteArray::ptr ba, size_t len) {
     }
     return (int) len;
 }
-} // hyn
\ No newline at end of file
+
+int64_t Stream::write(const iovec *iov, int iovcnt) {
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len)
+            return write(iov[i].iov_base, iov[i].iov_len);
+    }
+    return 0;
+}
+
+int64_t Stream::writeFixSize(iovec *iov, int iovcnt) {
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        total += (int64_t) iov[i].iov_len;
+    }
+    int64_t left = total;
+    while (left > 0) {
+        //跳过已经写完的段
+        while (iov->iov_len == 0) {
+            ++iov;
+            --iovcnt;
+        }
+        int64_t length = write(iov, iovcnt);
+        if (length <= 0)
+            return length;
+        left -= length;
+        for (auto n = (size_t) length; n > 0;) {
+            size_t step = std::min(n, iov->iov_len);
+            iov->iov_base = static_cast<char *>(iov->iov_base) + step;
+            iov->iov_len -= step;
+            n -= step;
+            if (iov->iov_len == 0 && n > 0) {
+                ++iov;
+                --iovcnt;
+            }
+        }
+    }
+    return total;
+}
+
+int64_t Stream::sendFile(int fd, off_t offset, size_t len) {
+    std::vector<char> buff(std::min<size_t>(len, 64 * 1024));
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, buff.data(), std::min(buff.size(), len - done), offset + (off_t) done);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        int rt = writeFixSize(buff.data(), n);
+        if (rt <= 0)
+            return rt;
+        done += n;
+    }
+    return (int64_t) done;
+}
+
+int64_t Stream::spliceFrom(const Stream::ptr &src, size_t len) {
+    std::vector<char> buff(std::min<size_t>(len, 64 * 1024));
+    size_t done = 0;
+    while (done < len) {
+        int n = src->read(buff.data(), std::min(buff.size(), len - done));
+        if (n <= 0)
+            return done ? (int64_t) done : n;
+        int rt = writeFixSize(buff.data(), n);
+        if (rt <= 0)
+            return done ? (int64_t) done : rt;
+        done += n;
+    }
+    return (int64_t) done;
+}
+} // hyn
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <memory>
+#include <sys/uio.h>
 #include "ByteArray.h"
 
 
@@ -90,6 +91,16 @@ public:
      */
     virtual int write(ByteArray::ptr ba, size_t len) = 0;
 
+    /**
+     *@brief 聚集写，一次写多段内存
+     *@note 默认实现只写第一段非空的内存，SocketStream用一次writev
+     *@return
+     *          >0:写入到数据的实际大小
+     *          =0:被关闭
+     *          <0:出现流错误
+     */
+    virtual int64_t write(const iovec *iov, int iovcnt);
+
     /**
     *@brief 写固定大小数据
     *@param buff 写入数据的内存
@@ -112,6 +123,37 @@ public:
     */
     virtual int writeFixSize(ByteArray::ptr ba, size_t len);
 
+    /**
+    *@brief 把多段内存全部写完，部分写入时跳过已经写完的段继续写
+    *@param iov 会被修改，写完后内容不确定
+    *@return
+    *          >0:写入到数据的实际大小
+    *          =0:被关闭
+    *          <0:出现流错误
+    */
+    virtual int64_t writeFixSize(iovec *iov, int iovcnt);
+
+    /**
+    *@brief 把文件fd里[offset, offset + len)的数据写到流里
+    *@note 默认实现先pread到用户态再writeFixSize，SocketStream用sendfile不经过用户态
+    *@return
+    *          >0:写入的数据大小，文件不够len时小于len
+    *          =0:文件从offset开始已经没有数据
+    *          <0:出现流或文件错误
+    */
+    virtual int64_t sendFile(int fd, off_t offset, size_t len);
+
+    /**
+    *@brief 从src读len字节写到这个流里
+    *@note 默认实现经过用户态缓冲区，两端都是SocketStream时用splice经过管道转发
+    *@return
+    *          >0:转发的数据大小，src提前结束或中途出错时小于len
+    *          =0:src已经结束，没有转发任何数据
+    *          <0:没有转发任何数据就出错
+    *@attention 中途出错时返回已经写出的长度，已经从src读出但还没写出的部分丢失
+    */
+    virtual int64_t spliceFrom(const Stream::ptr &src, size_t len);
+
     /**
      *@brief 关闭流
      */
@@ -87,7 +87,9 @@ void TcpServer::startAccept(const Socket::ptr &sock) {
         Socket::ptr client = sock->accept();
         if (client) {
             client->setRecvTimeout(static_cast<int64_t>(m_recvTimeout));
-            m_ioWorker->schedule([capture0 = shared_from_this(), client] { capture0->handleClient(client); });
+            //多reactor模式下把连接交给最空闲的线程，之后这个连接的事件都在那个线程上处理
+            m_ioWorker->schedule([capture0 = shared_from_this(), client] { capture0->handleClient(client); },
+                                 m_ioWorker->nextReactorThread());
         } else {
             error("accept errno=%d,errstr=%s", errno, strerror(errno));
         }
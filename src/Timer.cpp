@@ -7,6 +7,7 @@
   * @date           : 2023/4/9
   ******************************************************************************
   */
+#include <algorithm>
 #include <utility>
 
 #include "Timer.h"
@@ -19,11 +20,7 @@ bool Timer::cancel() {
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
     if (m_cb) {
         m_cb = nullptr;
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it == m_manager->m_timers.end())
-            return false;
-        m_manager->m_timers.erase(it);
-        return true;
+        return m_manager->removeTimer(shared_from_this());
     }
     return false;
 }
@@ -32,12 +29,11 @@ bool Timer::refresh() {
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
     if (!m_cb)
         return false;
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if (it == m_manager->m_timers.end())
+    if (!m_manager->removeTimer(shared_from_this()))
         return false;
-    m_manager->m_timers.erase(it);
-    m_next = util::GetCurrentMS() + m_ms;
-    m_manager->m_timers.insert(shared_from_this());
+    uint64_t now_ms = util::GetCurrentMS();
+    m_next = now_ms + m_ms;
+    m_manager->insertTimer(shared_from_this(), now_ms);
     return true;
 }
 
@@ -48,10 +44,8 @@ bool Timer::reset(uint64_t ms, bool from_now) {
     TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
     if (!m_cb)
         return false;
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if (it == m_manager->m_timers.end())
+    if (!m_manager->removeTimer(shared_from_this()))
         return false;
-    m_manager->m_timers.erase(it);
     uint64_t start{};
     if (from_now) {
         start = util::GetCurrentMS();
@@ -65,10 +59,12 @@ bool Timer::reset(uint64_t ms, bool from_now) {
 }
 
 Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager)
-        : m_cb(std::move(cb)), m_ms(ms), m_recurring(recurring), m_manager(manager),
-          m_next(util::GetCurrentMS() + m_ms) {}
+        : m_cb(std::move(cb)), m_ms(ms), m_recurring(recurring), m_manager(manager) {
+    m_next = util::GetCurrentMS() + m_ms;
+}
 
-Timer::Timer(uint64_t next) : m_next(next) {
+Timer::Timer(uint64_t next) {
+    m_next = next;
 }
 
 bool Timer::Comparator::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const {
@@ -85,12 +81,181 @@ bool Timer::Comparator::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs)
     return lhs.get() < rhs.get();
 }
 
+TimingWheel::TimingWheel(uint64_t now_ms) : m_current(now_ms) {
+}
+
+void TimingWheel::add(TimerNode *node, uint64_t now_ms) {
+    if (!m_count) {
+        //空着的时候没有推进，直接跳到当前时间，否则下一次advance要把空闲期间逐毫秒走一遍
+        m_current = now_ms;
+    }
+    //当前这一格已经处理过了，已经过期的放到下一格
+    link(node, m_current + 1);
+    ++m_count;
+}
+
+bool TimingWheel::remove(TimerNode *node) {
+    if (!node->m_wheelPprev) {
+        return false;
+    }
+    unlink(node);
+    --m_count;
+    return true;
+}
+
+void TimingWheel::link(TimerNode *node, uint64_t earliest) {
+    uint64_t expire = std::max(node->m_next, earliest);
+    uint64_t delta = expire - m_current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << shift(level + 1))) {
+        ++level;
+    }
+    if (level == LEVELS - 1 && delta >= (1ull << (shift(LEVELS - 1) + LEVEL_BITS))) {
+        //超出范围的放在最高层最远的一格，转下来时按真实时间重新分配
+        expire = m_current + (1ull << (shift(LEVELS - 1) + LEVEL_BITS)) - 1;
+    }
+    size_t slot = (expire >> shift(level)) & (slots(level) - 1);
+
+    TimerNode *&head = m_slots[level][slot];
+    node->m_wheelNext = head;
+    if (head) {
+        head->m_wheelPprev = &node->m_wheelNext;
+    }
+    head = node;
+    node->m_wheelPprev = &head;
+    node->m_wheelLevel = level;
+    node->m_wheelSlot = slot;
+    m_bitmap[level][slot / 64] |= 1ull << (slot % 64);
+}
+
+void TimingWheel::unlink(TimerNode *node) {
+    *node->m_wheelPprev = node->m_wheelNext;
+    if (node->m_wheelNext) {
+        node->m_wheelNext->m_wheelPprev = node->m_wheelPprev;
+    }
+    int level = node->m_wheelLevel;
+    size_t slot = node->m_wheelSlot;
+    if (!m_slots[level][slot]) {
+        m_bitmap[level][slot / 64] &= ~(1ull << (slot % 64));
+    }
+    node->m_wheelNext = nullptr;
+    node->m_wheelPprev = nullptr;
+}
+
+void TimingWheel::cascade(int level, size_t slot) {
+    TimerNode *node = m_slots[level][slot];
+    m_slots[level][slot] = nullptr;
+    m_bitmap[level][slot / 64] &= ~(1ull << (slot % 64));
+    while (node) {
+        TimerNode *next = node->m_wheelNext;
+        //在处理m_current这一格之前转下来，正好这一毫秒到期的要放进这一格
+        link(node, m_current);
+        node = next;
+    }
+}
+
+void TimingWheel::advance(uint64_t now_ms, std::vector<TimerNode *> &expired) {
+    while (m_current < now_ms) {
+        if (!m_count) {
+            m_current = now_ms;
+            break;
+        }
+        ++m_current;
+        //低层转完一圈，把上一层对应的格子分下来，上一层也转完一圈时继续往上
+        for (int level = 1; level < LEVELS; ++level) {
+            if (m_current & ((1ull << shift(level)) - 1)) {
+                break;
+            }
+            cascade(level, (m_current >> shift(level)) & (LEVEL_SIZE - 1));
+        }
+        size_t slot = m_current & (ROOT_SIZE - 1);
+        TimerNode *node = m_slots[0][slot];
+        if (!node) {
+            continue;
+        }
+        m_slots[0][slot] = nullptr;
+        m_bitmap[0][slot / 64] &= ~(1ull << (slot % 64));
+        while (node) {
+            TimerNode *next = node->m_wheelNext;
+            node->m_wheelNext = nullptr;
+            node->m_wheelPprev = nullptr;
+            expired.push_back(node);
+            --m_count;
+            node = next;
+        }
+    }
+}
+
+void TimingWheel::takeAll(uint64_t now_ms, std::vector<TimerNode *> &expired) {
+    for (int level = 0; level < LEVELS; ++level) {
+        for (size_t slot = 0; slot < slots(level); ++slot) {
+            TimerNode *node = m_slots[level][slot];
+            m_slots[level][slot] = nullptr;
+            while (node) {
+                TimerNode *next = node->m_wheelNext;
+                node->m_wheelNext = nullptr;
+                node->m_wheelPprev = nullptr;
+                expired.push_back(node);
+                node = next;
+            }
+        }
+        for (auto &word: m_bitmap[level]) {
+            word = 0;
+        }
+    }
+    m_count = 0;
+    m_current = now_ms;
+}
+
+int TimingWheel::findNext(int level, size_t from) const {
+    size_t size = slots(level);
+    for (size_t i = 0; i < size;) {
+        size_t slot = (from + i) & (size - 1);
+        uint64_t word = m_bitmap[level][slot / 64] >> (slot % 64);
+        if (word) {
+            return static_cast<int>(i + __builtin_ctzll(word));
+        }
+        //跳到下一个字，跨过末尾时回到开头
+        i += 64 - slot % 64;
+    }
+    return -1;
+}
+
+uint64_t TimingWheel::nextExpire() const {
+    if (!m_count) {
+        return ~0ull;
+    }
+    //第0层是精确的到期时间，上面的层取转下来的时间，都不会晚于真正的到期时间
+    uint64_t next = ~0ull;
+    int distance = findNext(0, (m_current + 1) & (ROOT_SIZE - 1));
+    if (distance >= 0) {
+        next = m_current + 1 + distance;
+    }
+    for (int level = 1; level < LEVELS; ++level) {
+        uint64_t index = m_current >> shift(level);
+        distance = findNext(level, (index + 1) & (LEVEL_SIZE - 1));
+        if (distance >= 0) {
+            next = std::min(next, (index + 1 + distance) << shift(level));
+        }
+    }
+    return next;
+}
 
 TimerManager::TimerManager() {
     m_previouseTime = util::GetCurrentMS();
+    m_wheel = std::make_unique<TimingWheel>(m_previouseTime);
 }
 
-TimerManager::~TimerManager() = default;
+TimerManager::~TimerManager() {
+    //释放时间轮上Timer持有的自己
+    std::vector<TimerNode *> nodes;
+    m_wheel->takeAll(m_previouseTime, nodes);
+    for (auto &node: nodes) {
+        if (!node->m_onExpire) {
+            static_cast<Timer *>(node)->m_wheelSelf.reset();
+        }
+    }
+}
 
 Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring) {
     Timer::ptr t(new Timer(ms, std::move(cb), recurring, this));
@@ -108,20 +273,87 @@ TimerManager::addConditionTimer(uint64_t ms, const std::function<void()> &cb, co
 uint64_t TimerManager::getNextTimer() {
     RWMutexType::ReadLock lock(m_mutex);
     m_tickled = false;
-    if (m_timers.empty())
+    uint64_t next_ms = m_wheel->nextExpire();
+    if (!m_timers.empty()) {
+        next_ms = std::min(next_ms, (*m_timers.begin())->m_next);
+    }
+    m_nextDeadline = next_ms;
+    if (next_ms == ~0ull)
         return ~0ul;//最大值
-    const Timer::ptr &next = *m_timers.begin();
     auto now_ms = util::GetCurrentMS();
-    if (now_ms >= next->m_next) {
+    if (now_ms >= next_ms) {
         return 0;
     } else {
-        return next->m_next - now_ms;
+        return next_ms - now_ms;
     };
 }
 
+bool TimerManager::setTimingWheel(bool v) {
+    RWMutexType::WriteLock lock(m_mutex);
+    if (v == m_useWheel)
+        return true;
+    if (!m_timers.empty() || !m_wheel->empty())
+        return false;
+    m_useWheel = v;
+    return true;
+}
+
+void TimerManager::armTimer(TimerNode *node, uint64_t ms) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_wheel->remove(node);
+    ++node->m_seq;
+    uint64_t now_ms = util::GetCurrentMS();
+    node->m_next = now_ms + ms;
+    m_wheel->add(node, now_ms);
+    bool at_front = node->m_next < m_nextDeadline && !m_tickled;
+    if (at_front) {
+        m_tickled = true;
+    }
+    lock.unlock();
+
+    if (at_front) {
+        onTimerInsertedAtFront();
+    }
+}
+
+bool TimerManager::disarmTimer(TimerNode *node) {
+    RWMutexType::WriteLock lock(m_mutex);
+    return m_wheel->remove(node);
+}
+
+void TimerManager::insertTimer(const Timer::ptr &val, uint64_t now_ms) {
+    if (m_useWheel) {
+        val->m_wheelSelf = val;
+        m_wheel->add(val.get(), now_ms);
+    } else {
+        m_timers.insert(val);
+    }
+}
+
+bool TimerManager::removeTimer(const Timer::ptr &val) {
+    if (m_useWheel) {
+        if (!m_wheel->remove(val.get()))
+            return false;
+        val->m_wheelSelf.reset();
+        return true;
+    }
+    auto it = m_timers.find(val);
+    if (it == m_timers.end())
+        return false;
+    m_timers.erase(it);
+    return true;
+}
+
 void TimerManager::addTimer(const Timer::ptr &val, mutex::RWMutex::WriteLock &lock) {
-    auto it = m_timers.insert(val).first;
-    bool at_front = (it == m_timers.begin()) && !m_tickled;
+    bool at_front;
+    if (m_useWheel) {
+        //时间轮不维护最小值，和正在等待的到期时间比较
+        insertTimer(val, util::GetCurrentMS());
+        at_front = val->m_next < m_nextDeadline && !m_tickled;
+    } else {
+        auto it = m_timers.insert(val).first;
+        at_front = (it == m_timers.begin()) && !m_tickled;
+    }
     if (at_front) {
         m_tickled = true;
     }
@@ -135,29 +367,40 @@ void TimerManager::addTimer(const Timer::ptr &val, mutex::RWMutex::WriteLock &lo
 void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs) {
     uint64_t now_time = util::GetCurrentMS();
     std::vector<Timer::ptr> expired;
-    {
-        RWMutexType::ReadLock lock(m_mutex);
-        if (m_timers.empty())
-            return;
-    }
-    RWMutexType::WriteLock lock1(m_mutex);
-    if (m_timers.empty())
+    if (!hasTimer())
         return;
+    RWMutexType::WriteLock lock1(m_mutex);
     bool rollover = detectClockRollover(now_time);
-    if (!rollover && ((*m_timers.begin())->m_next > now_time))
-        return;
-    Timer::ptr nowTimer(new Timer(now_time));
-    auto it = rollover ? m_timers.end() : m_timers.lower_bound(nowTimer);
-    while (it != m_timers.end() && (*it)->m_next == now_time)
-        it++;
-    expired.insert(expired.begin(), m_timers.begin(), it);
-    m_timers.erase(m_timers.begin(), it);
-    cbs.reserve(expired.size());
+    if (!m_timers.empty() && (rollover || (*m_timers.begin())->m_next <= now_time)) {
+        Timer::ptr nowTimer(new Timer(now_time));
+        auto it = rollover ? m_timers.end() : m_timers.lower_bound(nowTimer);
+        while (it != m_timers.end() && (*it)->m_next == now_time)
+            it++;
+        expired.insert(expired.begin(), m_timers.begin(), it);
+        m_timers.erase(m_timers.begin(), it);
+    }
+    if (!m_wheel->empty()) {
+        std::vector<TimerNode *> nodes;
+        if (rollover) {
+            m_wheel->takeAll(now_time, nodes);
+        } else {
+            m_wheel->advance(now_time, nodes);
+        }
+        for (auto &node: nodes) {
+            if (node->m_onExpire) {
+                //嵌入式定时器，回调执行时节点可能已经被重新arm，带上序号
+                cbs.emplace_back([node, seq = node->m_seq] { node->m_onExpire(node, seq); });
+            } else {
+                expired.push_back(std::move(static_cast<Timer *>(node)->m_wheelSelf));
+            }
+        }
+    }
+    cbs.reserve(cbs.size() + expired.size());
     for (auto &time: expired) {
         cbs.push_back(time->m_cb);
         if (time->m_recurring) {
             time->m_next = now_time + time->m_ms;
-            m_timers.insert(time);
+            insertTimer(time, now_time);
         } else {
             time->m_cb = nullptr;
         }
@@ -166,7 +409,7 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs) {
 
 bool TimerManager::hasTimer() {
     RWMutexType::ReadLock lock(m_mutex);
-    return !m_timers.empty();
+    return !m_timers.empty() || !m_wheel->empty();
 }
 
 void TimerManager::onTimer(const std::weak_ptr<void> &weak_cond, const std::function<void()> &cb) {
@@ -9,8 +9,10 @@
   */
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <set>
+#include <vector>
 #include "thread.h"
 
 
@@ -18,8 +20,30 @@ namespace hyn {
 
 class TimerManager;
 
-class Timer : public std::enable_shared_from_this<Timer> {
+class TimingWheel;
+
+/**
+ *@brief：能挂在时间轮上的节点
+ *@note：Timer继承它；也可以直接嵌在别的对象里用armTimer挂上，不分配内存，
+ *       使用者要保证节点在到期或者disarmTimer之前一直有效
+ */
+struct TimerNode {
+    ///精确执行时间
+    uint64_t m_next{0};
+    ///到期时调用，参数是节点和arm时的序号；Timer对象为nullptr
+    void (*m_onExpire)(TimerNode *node, uint64_t seq){nullptr};
+    ///每次arm加一，回调里用来判断是不是已经被重新arm过了
+    uint64_t m_seq{0};
+    ///时间轮格子里的链表
+    TimerNode *m_wheelNext{nullptr};
+    TimerNode **m_wheelPprev{nullptr};
+    uint8_t m_wheelLevel{0};
+    uint16_t m_wheelSlot{0};
+};
+
+class Timer : public TimerNode, public std::enable_shared_from_this<Timer> {
     friend class TimerManager;
+    friend class TimingWheel;
 public:
     typedef std::shared_ptr<Timer> ptr;
 
@@ -62,12 +86,12 @@ private:
     bool m_recurring{false};
     ///执行周期
     uint64_t m_ms{0};
-    ///精确执行时间
-    uint64_t m_next{0};
     ///回调函数
     std::function<void()> m_cb;
     ///定时器管理器
     TimerManager *m_manager{nullptr};
+    ///挂在时间轮上时持有自己，摘下来时释放
+    Timer::ptr m_wheelSelf;
 
     ///定时器比较仿函数
     struct Comparator {
@@ -79,6 +103,83 @@ private:
     };
 };
 
+/**
+ *@brief：分层时间轮，1ms一格，第0层256格，往上每层64格，5层一共覆盖2^32ms
+ *@note：不加锁，由TimerManager的锁保护；定时器按到期时间挂在对应层的格子里，
+ *       低层转完一圈时把上一层的一格重新分配到下面，插入和删除都是O(1)
+ */
+class TimingWheel {
+public:
+    explicit TimingWheel(uint64_t now_ms);
+
+    /**
+     *@作用：添加节点，到期时间取m_next
+     *@参数：当前时间，时间轮空着的时候不推进，添加第一个节点时直接跳到这里
+     */
+    void add(TimerNode *node, uint64_t now_ms);
+
+    /**
+     *@作用：删除节点
+     *@返回值：节点不在时间轮上返回false
+     */
+    bool remove(TimerNode *node);
+
+    /**
+     *@作用：推进到now_ms，到期的节点放进expired
+     */
+    void advance(uint64_t now_ms, std::vector<TimerNode *> &expired);
+
+    /**
+     *@作用：取出所有节点，时间回到now_ms
+     */
+    void takeAll(uint64_t now_ms, std::vector<TimerNode *> &expired);
+
+    /**
+     *@作用：下一次需要推进的时间，不晚于最早的到期时间；没有定时器返回~0ull
+     */
+    [[nodiscard]] uint64_t nextExpire() const;
+
+    [[nodiscard]] bool empty() const { return m_count == 0; }
+
+private:
+    static constexpr int LEVELS = 5;
+    static constexpr int ROOT_BITS = 8;
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr size_t ROOT_SIZE = 1 << ROOT_BITS;
+    static constexpr size_t LEVEL_SIZE = 1 << LEVEL_BITS;
+
+    static int shift(int level) { return level ? ROOT_BITS + LEVEL_BITS * (level - 1) : 0; }
+
+    static size_t slots(int level) { return level ? LEVEL_SIZE : ROOT_SIZE; }
+
+    /**
+     *@作用：按到期时间挂到对应的格子上
+     *@参数：最早能放的时间，早于它的节点放到这一格
+     */
+    void link(TimerNode *node, uint64_t earliest);
+
+    void unlink(TimerNode *node);
+
+    /**
+     *@作用：把level层的slot格重新分配到下面的层
+     */
+    void cascade(int level, size_t slot);
+
+    /**
+     *@作用：从from开始往后找第一个不空的格子
+     *@返回值：距离from的格数，没有返回-1
+     */
+    [[nodiscard]] int findNext(int level, size_t from) const;
+
+    ///已经处理到的时间
+    uint64_t m_current;
+    ///定时器个数
+    size_t m_count = 0;
+    TimerNode *m_slots[LEVELS][ROOT_SIZE]{};
+    ///每个格子是否有定时器
+    uint64_t m_bitmap[LEVELS][ROOT_SIZE / 64]{};
+};
+
 class TimerManager {
     friend Timer;
 public:
@@ -112,6 +213,29 @@ public:
      */
     uint64_t getNextTimer();
 
+    /**
+     *@作用：使用分层时间轮代替有序集合，插入和取消是O(1)，到期精度1ms
+     *@参数：是否使用时间轮
+     *@返回值：已经有定时器时不能切换，返回false
+     */
+    bool setTimingWheel(bool v);
+
+    [[nodiscard]] bool isTimingWheel() const { return m_useWheel; }
+
+    /**
+     *@作用：挂上嵌入式定时器，已经挂着的先摘下来，不分配内存
+     *@参数：节点，m_onExpire必须已经设置
+     *@参数：超时时间ms
+     *@note：不管是否使用时间轮模式，嵌入式定时器都放在时间轮里
+     */
+    void armTimer(TimerNode *node, uint64_t ms);
+
+    /**
+     *@作用：摘下嵌入式定时器
+     *@返回值：已经到期或者没有挂上返回false
+     */
+    bool disarmTimer(TimerNode *node);
+
     /**
      *@作用：在定时器超时后执行用户指定的回调函数
      */
@@ -139,6 +263,18 @@ protected:
     bool hasTimer();
 
 private:
+    /**
+     *@作用：把定时器放进有序集合或者时间轮
+     *@参数：当前时间，只有时间轮用到
+     */
+    void insertTimer(const Timer::ptr &val, uint64_t now_ms);
+
+    /**
+     *@作用：把定时器从有序集合或者时间轮里删除
+     *@返回值：定时器不在里面返回false
+     */
+    bool removeTimer(const Timer::ptr &val);
+
     /**
      *@作用：检测服务器是否被调后了
      *@参数：当前时间
@@ -149,6 +285,12 @@ private:
     RWMutexType m_mutex;
     /// 定时器集合
     std::set<Timer::ptr, Timer::Comparator> m_timers;
+    /// 时间轮，放嵌入式定时器，时间轮模式下也放Timer
+    std::unique_ptr<TimingWheel> m_wheel;
+    /// Timer是否放在时间轮里
+    bool m_useWheel = false;
+    /// 上次getNextTimer算出的最近到期时间，早于它的定时器插入时需要onTimerInsertedAtFront
+    std::atomic<uint64_t> m_nextDeadline{~0ull};
     /// 是否触发onTimerInsertedAtFront
     bool m_tickled = false;
     /// 上次执行时间
@@ -0,0 +1,284 @@
+/**
+  ******************************************************************************
+  * @file           : Varint.cpp
+  * @author         : hyn
+  * @brief          : None
+  * @attention      : None
+  * @date           : 2023/6/2
+  ******************************************************************************
+  */
+
+
+#include "Varint.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HYN_VARINT_X86 1
+#define HYN_TARGET_BMI2 __attribute__((target("bmi,bmi2")))
+#define HYN_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2")))
+#endif
+
+namespace hyn::varint {
+
+namespace {
+
+/**
+ *@brief：编码一个值，和ByteArray::writeUint32/writeUint64一样逐7位输出
+ */
+template<typename T>
+inline size_t EncodeOneScalar(T value, uint8_t *out) {
+    size_t i = 0;
+    while (value >= 0x80) {
+        out[i++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[i++] = value;
+    return i;
+}
+
+/**
+ *@brief：从[p, p + len)解码一个值，读到MAX个字节时不管有没有结束位都停下(和readUint32/readUint64一致)
+ *@return：用掉的字节数，数据不完整时返回0
+ */
+template<typename T, size_t MAX>
+inline size_t DecodeOneScalar(const uint8_t *p, size_t len, T &value) {
+    T res = 0;
+    size_t n = std::min(len, MAX);
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t bytes = p[i];
+        res |= static_cast<T>(bytes & 0x7f) << (7 * i);
+        if (bytes < 0x80 || i + 1 == MAX) {
+            value = res;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+template<typename T, size_t MAX>
+size_t EncodeScalar(const T *values, size_t count, uint8_t *out) {
+    uint8_t *p = out;
+    for (size_t i = 0; i < count; ++i) {
+        p += EncodeOneScalar(values[i], p);
+    }
+    return p - out;
+}
+
+template<typename T, size_t MAX>
+size_t DecodeScalar(const uint8_t *in, size_t len, T *values, size_t count, size_t &decoded) {
+    const uint8_t *p = in;
+    const uint8_t *end = in + len;
+    size_t n = 0;
+    while (n < count) {
+        size_t used = DecodeOneScalar<T, MAX>(p, end - p, values[n]);
+        if (!used) {
+            break;
+        }
+        p += used;
+        ++n;
+    }
+    decoded = n;
+    return p - in;
+}
+
+#ifdef HYN_VARINT_X86
+
+constexpr uint64_t LOW7 = 0x7f7f7f7f7f7f7f7full;
+constexpr uint64_t HIGH1 = 0x8080808080808080ull;
+
+/**
+ *@brief：用pdep把7位一组摊到8个字节里，一次写8个字节，只适合小于2^56的值
+ */
+HYN_TARGET_BMI2 inline size_t EncodeOneBmi2(uint64_t value, uint8_t *out) {
+    uint64_t w = _pdep_u64(value, LOW7);
+    unsigned bits = 64 - __builtin_clzll(value | 1);
+    size_t len = (bits + 6) / 7;
+    w |= HIGH1 & _bzhi_u64(~0ull, 8 * (len - 1));
+    memcpy(out, &w, sizeof(w));
+    return len;
+}
+
+/**
+ *@brief：p后面至少有8个字节可读，用pext取出一个占len个字节的值
+ */
+HYN_TARGET_BMI2 inline uint64_t ExtractBmi2(const uint8_t *p, size_t len) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return _pext_u64(_bzhi_u64(w, 8 * len), LOW7);
+}
+
+template<typename T>
+HYN_TARGET_AVX2 size_t EncodeAvx2(const T *values, size_t count, uint8_t *out) {
+    constexpr size_t LANES = 32 / sizeof(T);
+    const __m256i high = sizeof(T) == 4 ? _mm256_set1_epi32(~0x7f) : _mm256_set1_epi64x(~0x7fll);
+    uint8_t *p = out;
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        if (_mm256_testz_si256(v, high)) {
+            //整组都小于128，每个值正好一个字节，挑出每个元素的最低字节拼在一起
+            if constexpr (sizeof(T) == 4) {
+                const __m256i pick = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                __m256i b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pick),
+                                                        _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm256_castsi256_si128(b));
+            } else {
+                const __m256i pick = _mm256_setr_epi8(0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                      0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                __m256i b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pick),
+                                                        _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+                uint64_t w = _mm_cvtsi128_si64(_mm256_castsi256_si128(b));
+                //低2字节来自第一个128位通道，第5、6字节来自第二个
+                uint32_t four = static_cast<uint32_t>(w & 0xffff) | static_cast<uint32_t>((w >> 16) & 0xffff0000);
+                memcpy(p, &four, sizeof(four));
+            }
+            p += LANES;
+            continue;
+        }
+        for (size_t k = 0; k < LANES; ++k) {
+            uint64_t value = values[i + k];
+            p += (value >> 56) ? EncodeOneScalar(value, p) : EncodeOneBmi2(value, p);
+        }
+    }
+    for (; i < count; ++i) {
+        uint64_t value = values[i];
+        p += (value >> 56) ? EncodeOneScalar(value, p) : EncodeOneBmi2(value, p);
+    }
+    return p - out;
+}
+
+template<typename T, size_t MAX>
+HYN_TARGET_AVX2 size_t DecodeAvx2(const uint8_t *in, size_t len, T *values, size_t count, size_t &decoded) {
+    const uint8_t *p = in;
+    const uint8_t *end = in + len;
+    size_t n = 0;
+    while (n < count && end - p >= 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        uint32_t mask = _mm256_movemask_epi8(x);
+        if (!mask && count - n >= 32) {
+            //32个单字节的值，直接零扩展
+            if constexpr (sizeof(T) == 4) {
+                for (int k = 0; k < 4; ++k) {
+                    __m256i w = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + 8 * k)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + n + 8 * k), w);
+                }
+            } else {
+                for (int k = 0; k < 8; ++k) {
+                    int32_t four;
+                    memcpy(&four, p + 4 * k, sizeof(four));
+                    __m256i w = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + n + 4 * k), w);
+                }
+            }
+            p += 32;
+            n += 32;
+            continue;
+        }
+        //用继续位的掩码算出窗口里每个值的长度，值本身用pext取出
+        uint32_t stops = ~mask;
+        size_t o = 0;
+        while (n < count && o < 24) {
+            uint32_t rest = stops >> o;
+            if (!rest) {
+                break;
+            }
+            size_t used = __builtin_ctz(rest) + 1;
+            if (used > 8 || used > MAX) {
+                break;
+            }
+            values[n++] = static_cast<T>(used == 1 ? p[o] : ExtractBmi2(p + o, used));
+            o += used;
+        }
+        p += o;
+        if (!o && n < count) {
+            //超过8个字节的值，32位的超过5个字节时按readUint32的规则截断
+            p += DecodeOneScalar<T, MAX>(p, end - p, values[n++]);
+        }
+    }
+    size_t rest;
+    p += DecodeScalar<T, MAX>(p, end - p, values + n, count - n, rest);
+    decoded = n + rest;
+    return p - in;
+}
+
+#endif
+
+struct Codec {
+    size_t (*encode32)(const uint32_t *, size_t, uint8_t *);
+    size_t (*encode64)(const uint64_t *, size_t, uint8_t *);
+    size_t (*decode32)(const uint8_t *, size_t, uint32_t *, size_t, size_t &);
+    size_t (*decode64)(const uint8_t *, size_t, uint64_t *, size_t, size_t &);
+    const char *name;
+};
+
+const Codec s_scalar{EncodeScalar<uint32_t, MAX_LEN32>, EncodeScalar<uint64_t, MAX_LEN64>,
+                     DecodeScalar<uint32_t, MAX_LEN32>, DecodeScalar<uint64_t, MAX_LEN64>, "scalar"};
+
+#ifdef HYN_VARINT_X86
+const Codec s_avx2{EncodeAvx2<uint32_t>, EncodeAvx2<uint64_t>,
+                   DecodeAvx2<uint32_t, MAX_LEN32>, DecodeAvx2<uint64_t, MAX_LEN64>, "avx2"};
+#endif
+
+/**
+ *@brief：按CPU支持的指令集选一次实现
+ */
+const Codec &Select() {
+#ifdef HYN_VARINT_X86
+    static const Codec &codec = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")
+                                ? s_avx2 : s_scalar;
+    return codec;
+#else
+    return s_scalar;
+#endif
+}
+
+} // namespace
+
+size_t EncodeUint32(const uint32_t *values, size_t count, uint8_t *out) {
+    return Select().encode32(values, count, out);
+}
+
+size_t EncodeUint64(const uint64_t *values, size_t count, uint8_t *out) {
+    return Select().encode64(values, count, out);
+}
+
+size_t DecodeUint32(const uint8_t *in, size_t len, uint32_t *values, size_t count, size_t &decoded) {
+    return Select().decode32(in, len, values, count, decoded);
+}
+
+size_t DecodeUint64(const uint8_t *in, size_t len, uint64_t *values, size_t count, size_t &decoded) {
+    return Select().decode64(in, len, values, count, decoded);
+}
+
+void EncodeZigzag32(const int32_t *in, size_t count, uint32_t *out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = (static_cast<uint32_t>(in[i]) << 1) ^ static_cast<uint32_t>(in[i] >> 31);
+    }
+}
+
+void EncodeZigzag64(const int64_t *in, size_t count, uint64_t *out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = (static_cast<uint64_t>(in[i]) << 1) ^ static_cast<uint64_t>(in[i] >> 63);
+    }
+}
+
+void DecodeZigzag32(const uint32_t *in, size_t count, int32_t *out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<int32_t>((in[i] >> 1) ^ (-(in[i] & 1)));
+    }
+}
+
+void DecodeZigzag64(const uint64_t *in, size_t count, int64_t *out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<int64_t>((in[i] >> 1) ^ (-(in[i] & 1)));
+    }
+}
+
+const char *Implementation() {
+    return Select().name;
+}
+
+} // hyn::varint
@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file           : Varint.h
+  * @author         : hyn
+  * @brief          : 批量Varint(LEB128)编解码
+  * @attention      : 格式和ByteArray::writeUint32/readUint32一样，可以混用
+  * @date           : 2023/6/2
+  ******************************************************************************
+  */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hyn::varint {
+
+///32位Varint最多占用的字节数
+constexpr size_t MAX_LEN32 = 5;
+///64位Varint最多占用的字节数
+constexpr size_t MAX_LEN64 = 10;
+///编码时输出缓冲区末尾需要多留的字节数，快速路径一次写8个字节
+constexpr size_t ENCODE_SLACK = 8;
+
+/**
+ *@brief 编码count个值
+ *@param [out] out 输出缓冲区，至少count * MAX_LEN32 + ENCODE_SLACK字节
+ *@return 编码后的字节数
+ */
+size_t EncodeUint32(const uint32_t *values, size_t count, uint8_t *out);
+
+/**
+ *@brief 编码count个值
+ *@param [out] out 输出缓冲区，至少count * MAX_LEN64 + ENCODE_SLACK字节
+ *@return 编码后的字节数
+ */
+size_t EncodeUint64(const uint64_t *values, size_t count, uint8_t *out);
+
+/**
+ *@brief 从[in, in + len)里解码最多count个值，最后一个值不完整时停在它前面
+ *@param [out] decoded 解码出的个数
+ *@return 用掉的字节数
+ */
+size_t DecodeUint32(const uint8_t *in, size_t len, uint32_t *values, size_t count, size_t &decoded);
+
+/**
+ *@brief 从[in, in + len)里解码最多count个值，最后一个值不完整时停在它前面
+ *@param [out] decoded 解码出的个数
+ *@return 用掉的字节数
+ */
+size_t DecodeUint64(const uint8_t *in, size_t len, uint64_t *values, size_t count, size_t &decoded);
+
+/**
+ *@brief Zigzag编码，和ByteArray::EncodeZigzag32结果一样
+ */
+void EncodeZigzag32(const int32_t *in, size_t count, uint32_t *out);
+
+void EncodeZigzag64(const int64_t *in, size_t count, uint64_t *out);
+
+void DecodeZigzag32(const uint32_t *in, size_t count, int32_t *out);
+
+void DecodeZigzag64(const uint64_t *in, size_t count, int64_t *out);
+
+/**
+ *@brief 当前CPU上使用的实现：支持avx2+bmi2时为"avx2"，否则为"scalar"
+ */
+const char *Implementation();
+
+} // hyn::varint
@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file           : WorkStealingQueue.h
+  * @author         : hyn
+  * @brief          : 无锁任务窃取队列
+  * @attention      : None
+  * @date           : 2023/5/22
+  ******************************************************************************
+  */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace hyn::scheduler {
+
+/**
+ *@brief：Chase-Lev任务队列
+ *@note：只有所属线程可以push，任何线程(包括所属线程)都可以从队头steal，
+ *       所属线程也从队头取任务，保持和原来任务链表一样的先进先出顺序；
+ *       队列满了由所属线程扩容，旧数组可能还在被窃取线程读，析构时统一释放
+ */
+template<typename T>
+class WorkStealingQueue : boost::noncopyable {
+public:
+    explicit WorkStealingQueue(int64_t capacity = 256) {
+        m_array.store(new Array(capacity), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingQueue() {
+        for (auto *i: m_retired) {
+            delete i;
+        }
+        delete m_array.load(std::memory_order_relaxed);
+    }
+
+    /**
+     *@brief：放入队尾，只能由所属线程调用
+     */
+    void push(T *item) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array *a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = grow(a, b, t);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     *@brief：从队头取出一个，队列为空或者和其他线程竞争失败返回nullptr
+     */
+    T *steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T *item = m_array.load(std::memory_order_acquire)->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    /**
+     *@brief：近似的元素个数
+     */
+    [[nodiscard]] size_t size() const {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+private:
+    struct Array {
+        explicit Array(int64_t cap) : capacity(cap), mask(cap - 1), items(new std::atomic<T *>[cap]) {}
+
+        ~Array() { delete[] items; }
+
+        T *get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+
+        void put(int64_t i, T *item) { items[i & mask].store(item, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<T *> *items;
+    };
+
+    Array *grow(Array *old, int64_t b, int64_t t) {
+        auto *a = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            a->put(i, old->get(i));
+        }
+        m_retired.push_back(old);
+        m_array.store(a, std::memory_order_release);
+        return a;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<Array *> m_array;
+    ///扩容后被替换掉的数组
+    std::vector<Array *> m_retired;
+};
+
+} // hyn::scheduler
@@ -10,6 +10,11 @@
 #include <atomic>
 #include <utility>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
 
 #include "fiber.h"
 #include "Logger.h"
@@ -30,81 +35,151 @@ static thread_local hyn::fiber::Fiber *t_fiber = nullptr;
 static thread_local hyn::fiber::Fiber::ptr t_threadFiber = nullptr;
 
 
+static std::atomic<size_t> s_stack_max_cached{64};
+static std::atomic<uint64_t> s_stack_hits{0};
+static std::atomic<uint64_t> s_stack_misses{0};
+///线程退出时缓存已析构，之后归还的栈直接释放
+static thread_local bool t_stack_cache_destroyed = false;
+
 /**
-*@类名：MallocStackAllocator
-*@参数：null
-*/
-class MallocStackAllocator {
-public:
-    /**
-     *@作用：分配内存
-     *@参数：分配大小
-     *@返回值：void*
-     */
-    static void *Alloc(size_t size) {
-        return malloc(size);
+ *@brief：线程局部的空闲栈缓存，按栈大小分组
+ */
+struct StackCache {
+    ~StackCache() {
+        t_stack_cache_destroyed = true;
+        for (auto &i: stacks) {
+            for (auto vp: i.second) {
+                Unmap(vp, i.first);
+            }
+        }
+    }
+
+    static size_t PageSize() {
+        static const size_t s_page_size = sysconf(_SC_PAGESIZE);
+        return s_page_size;
+    }
+
+    static void *Map(size_t size) {
+        size_t page = PageSize();
+        void *base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1, 0);
+        THROW_RUNTIME_ERROR_IF(base == MAP_FAILED, "mmap fiber stack error");
+        //栈向低地址增长，最低的一页作为保护页
+        if (mprotect(base, page, PROT_NONE)) {
+            munmap(base, size + page);
+            THROW_RUNTIME_ERROR_IF(1, "mprotect fiber stack guard page error");
+        }
+        return static_cast<char *>(base) + page;
+    }
+
+    static void Unmap(void *vp, size_t size) {
+        size_t page = PageSize();
+        munmap(static_cast<char *>(vp) - page, size + page);
+    }
+
+    ///栈大小 -> 空闲栈
+    std::unordered_map<size_t, std::vector<void *>> stacks;
+    ///缓存的栈总数
+    size_t count = 0;
+};
+
+static thread_local StackCache t_stack_cache;
+
+void *hyn::fiber::StackPool::Alloc(size_t size) {
+    size = (size + StackCache::PageSize() - 1) & ~(StackCache::PageSize() - 1);
+    auto it = t_stack_cache.stacks.find(size);
+    if (it != t_stack_cache.stacks.end() && !it->second.empty()) {
+        void *vp = it->second.back();
+        it->second.pop_back();
+        --t_stack_cache.count;
+        ++s_stack_hits;
+        return vp;
     }
+    ++s_stack_misses;
+    return StackCache::Map(size);
+}
+
+void hyn::fiber::StackPool::Dealloc(void *vp, size_t size) {
+    size = (size + StackCache::PageSize() - 1) & ~(StackCache::PageSize() - 1);
+    if (t_stack_cache_destroyed || t_stack_cache.count >= s_stack_max_cached) {
+        StackCache::Unmap(vp, size);
+        return;
+    }
+    t_stack_cache.stacks[size].push_back(vp);
+    ++t_stack_cache.count;
+}
+
+void hyn::fiber::StackPool::SetMaxCached(size_t count) {
+    s_stack_max_cached = count;
+}
+
+size_t hyn::fiber::StackPool::GetMaxCached() {
+    return s_stack_max_cached;
+}
+
+uint64_t hyn::fiber::StackPool::Hits() {
+    return s_stack_hits;
+}
+
+uint64_t hyn::fiber::StackPool::Misses() {
+    return s_stack_misses;
+}
+
+size_t hyn::fiber::StackPool::Cached() {
+    return t_stack_cache.count;
+}
+
+using StackAlloc = hyn::fiber::StackPool;
 
-    /**
-     *@作用：释放内存
-     *@参数：要释放的内存，大小
-     *@返回值：null
-     */
-    static void Dealloc(void *vp) {
-        free(vp);
+static std::atomic<size_t> s_shared_stack_size{1024 * 1024};
+
+/**
+ *@brief：线程的共享栈，共享栈模式的协程都在这块栈上运行，切出后把用到的部分拷贝走
+ */
+struct SharedStack {
+    ~SharedStack() {
+        if (base) {
+            StackAlloc::Dealloc(base, size);
+        }
     }
+
+    void *base = nullptr;
+    size_t size = 0;
 };
 
-using StackAlloc = MallocStackAllocator;
+static thread_local SharedStack t_shared_stack;
 
 hyn::fiber::Fiber::Fiber() {
     m_state = EXEC;
     SetThis(this);
-    if (getcontext(&m_ctx)) {
-        error("getcontext error");
-        THROW_RUNTIME_ERROR_IF(1, "getcontext");
-    }
     ++s_fiber_count;
 
     //debug("Fiber::Fiber main");
 }
 
-/**
-    typedef struct ucontext_t
-    {
-    unsigned long int __ctx(uc_flags);
-    struct ucontext_t *uc_link;
-    stack_t uc_stack;
-    mcontext_t uc_mcontext;
-    sigset_t uc_sigmask;
-    struct _libc_fpstate __fpregs_mem;
-    __extension__ unsigned long long int __ssp[4];
-    } ucontext_t;
-*/
-hyn::fiber::Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller) : m_id(++s_fiber_id),
-                                                                                        m_cb(std::move(cb)), m_ctx(),
-                                                                                        m_state(INIT),
-                                                                                        m_stack(nullptr) {
+hyn::fiber::Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller, bool shared_stack)
+        : m_id(++s_fiber_id), m_cb(std::move(cb)), m_ctx(), m_state(INIT), m_stack(nullptr) {
     ++s_fiber_count;
-    ///FIXME:config
-    //int stack_size = hyn::singleton::Singleton<hyn::ini::IniFile>::get_instance()->get("Fiber","stacks_size");
-    m_stacksize = stacksize ? stacksize : 131072;
-    m_stack = StackAlloc::Alloc(m_stacksize);
-    // 获取上下文对象的副本
-    if (getcontext(&m_ctx)) {
-        error("getcontext error");
-        THROW_RUNTIME_ERROR_IF(1, "getcontext");
-    }
-    //uc link 关联上下文
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
-
-    if (!use_caller) {
-        makecontext(&m_ctx, &Fiber::MainFunc, 0);
+#ifndef HYN_FIBER_USE_UCONTEXT
+    //只在汇编上下文下启用，ucontext后端(包括-DFIBER_CONTEXT=ucontext)退回独立栈
+    m_sharedStack = shared_stack && !use_caller;
+#endif
+    if (m_sharedStack) {
+        if (!t_shared_stack.base) {
+            t_shared_stack.size = s_shared_stack_size;
+            t_shared_stack.base = StackAlloc::Alloc(t_shared_stack.size);
+        }
+        m_stacksize = t_shared_stack.size;
+        m_stack = t_shared_stack.base;
+        m_ownerThread = util::GetThreadId();
     } else {
-        makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
+        ///FIXME:config
+        //int stack_size = hyn::singleton::Singleton<hyn::ini::IniFile>::get_instance()->get("Fiber","stacks_size");
+        m_stacksize = stacksize ? stacksize : 131072;
+        m_stack = StackAlloc::Alloc(m_stacksize);
+        m_ctx.make(m_stack, m_stacksize, use_caller ? &Fiber::CallerMainFunc : &Fiber::MainFunc);
     }
+    //共享栈协程的初始栈帧在第一次swapIn时才构造，否则会被先运行的共享栈协程覆盖
 
     //debug("Fiber::Fiber id : %d", m_id);
 }
@@ -113,7 +188,11 @@ hyn::fiber::Fiber::~Fiber() {
     --s_fiber_count;
     if (m_stack) {
         assert(m_state == INIT || m_state == TERM || m_state == EXCEPT);
-        StackAlloc::Dealloc(m_stack);
+        if (m_sharedStack) {
+            free(m_saveBuf);
+        } else {
+            StackAlloc::Dealloc(m_stack, m_stacksize);
+        }
     } else {
         assert(!m_cb);
         assert(m_state == EXEC);
@@ -130,31 +209,62 @@ void hyn::fiber::Fiber::reset(const std::function<void()> &cb) {
     assert(m_stack);
     assert(m_state == TERM || m_state == INIT || m_state == EXCEPT);
     m_cb = cb;
-    THROW_RUNTIME_ERROR_IF(getcontext(&m_ctx), "getcontext error");
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
+    if (!m_sharedStack) {
+        m_ctx.make(m_stack, m_stacksize, &Fiber::MainFunc);
+    }
+    m_saveSize = 0;
+    setOwnerThread(-1);
     m_state = INIT;
 }
 
 void hyn::fiber::Fiber::swapIn() {
-    debug("swapIN()");
     SetThis(this);
     assert(m_state == INIT || m_state == READY || m_state == HOLD);
+    if (m_sharedStack && m_state == INIT) {
+        m_ctx.make(m_stack, m_stacksize, &Fiber::MainFunc);
+    }
     m_state = EXEC;
-    if (swapcontext(&scheduler::Scheduler::GetMainFiber()->m_ctx, &m_ctx)) {
-        error("swap context");
-        THROW_RUNTIME_ERROR_IF(1, "swap context");
+    if (m_sharedStack && m_saveSize) {
+        //恢复到原来的地址上，栈上的指针才能继续使用
+        memcpy(static_cast<char *>(m_stack) + m_stacksize - m_saveSize, m_saveBuf, m_saveSize);
+    }
+    Context::Swap(scheduler::Scheduler::GetMainFiber()->m_ctx, m_ctx);
+    if (m_sharedStack) {
+        saveSharedStack();
     }
 }
 
+void hyn::fiber::Fiber::saveSharedStack() {
+    if (m_state == TERM || m_state == EXCEPT) {
+        m_saveSize = 0;
+        return;
+    }
+    //已经切回调度协程，共享栈上[sp, 栈顶)就是该协程挂起时的全部现场
+    auto *sp = static_cast<char *>(m_ctx.getSp());
+    auto *top = static_cast<char *>(m_stack) + m_stacksize;
+    assert(sp > m_stack && sp <= top);
+    m_saveSize = top - sp;
+    if (m_saveCap < m_saveSize || m_saveCap > m_saveSize * 4) {
+        //按实际使用的大小分配，避免空闲连接占用整块栈
+        free(m_saveBuf);
+        m_saveCap = (m_saveSize + 255) & ~static_cast<size_t>(255);
+        m_saveBuf = static_cast<char *>(malloc(m_saveCap));
+        THROW_RUNTIME_ERROR_IF(!m_saveBuf, "malloc shared stack save buffer error");
+    }
+    memcpy(m_saveBuf, sp, m_saveSize);
+}
+
+void hyn::fiber::Fiber::SetSharedStackSize(size_t size) {
+    s_shared_stack_size = size;
+}
+
+size_t hyn::fiber::Fiber::GetSharedStackSize() {
+    return s_shared_stack_size;
+}
+
 void hyn::fiber::Fiber::swapOut() {
     SetThis(scheduler::Scheduler::GetMainFiber());
-    if (swapcontext(&m_ctx, &scheduler::Scheduler::GetMainFiber()->m_ctx)) {
-        error("swap out");
-        THROW_RUNTIME_ERROR_IF(1, "swap out");
-    }
+    Context::Swap(m_ctx, scheduler::Scheduler::GetMainFiber()->m_ctx);
 }
 
 hyn::fiber::Fiber::ptr hyn::fiber::Fiber::GetThis() {
@@ -199,18 +309,12 @@ uint64_t hyn::fiber::Fiber::GetFiberId() {
 void hyn::fiber::Fiber::call() {
     SetThis(this);
     m_state = EXEC;
-    if (swapcontext(&(t_threadFiber->m_ctx), &m_ctx)) {
-        info("call error");
-        THROW_RUNTIME_ERROR_IF(1, "call error");
-    }
+    Context::Swap(t_threadFiber->m_ctx, m_ctx);
 }
 
 void hyn::fiber::Fiber::back() {
     SetThis(t_threadFiber.get());
-    if (swapcontext(&m_ctx, &t_threadFiber->m_ctx)) {
-        info("back error");
-        THROW_RUNTIME_ERROR_IF(1, "back error");
-    }
+    Context::Swap(m_ctx, t_threadFiber->m_ctx);
 }
 
 
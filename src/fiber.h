@@ -9,12 +9,12 @@
   */
 #pragma once
 
-#include <ucontext.h>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <functional>
+#include "fiber_context.h"
 
 namespace hyn::fiber {
 
@@ -37,6 +37,49 @@ swapconext : 相当于先调用getcontext到oucp，然后调用setconext将ucp
 
 
 
+/**
+ *@brief：协程栈池
+ *@note：栈用mmap分配，栈底有一个PROT_NONE的保护页，栈溢出时直接触发SIGSEGV而不是踩坏堆；
+ *@note：协程结束后栈放回当前线程的缓存中复用，每个线程最多缓存GetMaxCached()个
+ */
+class StackPool {
+public:
+    /**
+     *@brief：分配协程栈，优先从当前线程的缓存中取
+     *@param：栈大小
+     */
+    static void *Alloc(size_t size);
+
+    /**
+     *@brief：归还协程栈，缓存已满时直接munmap
+     *@param：栈地址
+     *@param：栈大小
+     */
+    static void Dealloc(void *vp, size_t size);
+
+    /**
+     *@brief：设置每个线程最多缓存的栈数量
+     */
+    static void SetMaxCached(size_t count);
+
+    static size_t GetMaxCached();
+
+    /**
+     *@brief：从缓存中分配到栈的次数
+     */
+    static uint64_t Hits();
+
+    /**
+     *@brief：需要新mmap栈的次数
+     */
+    static uint64_t Misses();
+
+    /**
+     *@brief：当前线程缓存的栈数量
+     */
+    static size_t Cached();
+};
+
 /**
 *@brief：Fiber : public std::enable_shared_from_this<Fiber>
 *@param：
@@ -74,8 +117,10 @@ public:
      *@param：协程执行的函数
      *@param：协程栈的大小
      *@param：是否在MainFiber上调度
+     *@param：是否运行在线程的共享栈上，ucontext后端忽略该参数，使用独立栈
      */
-    explicit Fiber(std::function<void()> cb, size_t stacksize = 0, bool use_caller = false);
+    explicit Fiber(std::function<void()> cb, size_t stacksize = 0, bool use_caller = false,
+                   bool shared_stack = false);
 
     ~Fiber();
 
@@ -165,6 +210,44 @@ public:
      */
     void setState(State mState);
 
+    /**
+     *@brief：是否运行在共享栈上
+     */
+    bool isSharedStack() const { return m_sharedStack; }
+
+    /**
+     *@brief：协程固定在哪个线程上恢复，没有固定返回-1
+     *@note：共享栈协程固定在创建它的线程上；多reactor模式下处理fd的协程固定在该fd所在的reactor线程上
+     */
+    int getOwnerThread() const { return m_ownerThread; }
+
+    /**
+     *@brief：把协程固定到指定线程，共享栈协程不能更改
+     */
+    void setOwnerThread(int thread) {
+        if (!m_sharedStack) {
+            m_ownerThread = thread;
+        }
+    }
+
+    /**
+     *@brief：当前协程挂起时保存的栈大小(共享栈模式)
+     */
+    size_t getSavedStackSize() const { return m_saveSize; }
+
+    /**
+     *@brief：设置每个线程共享栈的大小，需要在创建共享栈协程之前设置
+     */
+    static void SetSharedStackSize(size_t size);
+
+    static size_t GetSharedStackSize();
+
+private:
+    /**
+     *@brief：共享栈协程切出后，把栈上已使用的部分拷贝到保存缓冲区
+     */
+    void saveSharedStack();
+
 private:
     ///id
     uint64_t m_id = 0;
@@ -173,10 +256,20 @@ private:
     /// 协程状态
     State m_state = INIT;
     /// 协程上下文
-    ucontext_t m_ctx{};
+    Context m_ctx{};
     /// 协程运行栈指针
     void *m_stack = nullptr;
     /// 协程运行函数
     std::function<void()> m_cb;
+    /// 是否运行在共享栈上
+    bool m_sharedStack = false;
+    /// 协程固定的线程
+    int m_ownerThread = -1;
+    /// 共享栈协程挂起时保存的栈内容
+    char *m_saveBuf = nullptr;
+    /// 保存缓冲区容量
+    size_t m_saveCap = 0;
+    /// 保存的栈大小
+    size_t m_saveSize = 0;
 };
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+/**
+  ******************************************************************************
+  * @file           : fiber_context.cpp
+  * @author         : hyn
+  * @brief          : 协程上下文切换后端
+  * @attention      : None
+  * @date           : 2023/5/20
+  ******************************************************************************
+  */
+#include <cstdint>
+
+#include "fiber_context.h"
+#include "Logger.h"
+
+namespace hyn::fiber {
+
+void UContext::make(void *stack, size_t size, void (*fn)()) {
+    THROW_RUNTIME_ERROR_IF(getcontext(&m_ctx), "getcontext error");
+    //uc link 关联上下文
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = stack;
+    m_ctx.uc_stack.ss_size = size;
+    makecontext(&m_ctx, fn, 0);
+}
+
+void UContext::Swap(UContext &from, UContext &to) {
+    if (swapcontext(&from.m_ctx, &to.m_ctx)) {
+        error("swap context");
+        THROW_RUNTIME_ERROR_IF(1, "swap context");
+    }
+}
+
+void *UContext::getSp() const {
+#if defined(__x86_64__)
+    return reinterpret_cast<void *>(m_ctx.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+    return reinterpret_cast<void *>(m_ctx.uc_mcontext.sp);
+#else
+    return nullptr;
+#endif
+}
+
+} // hyn::fiber
+
+#ifdef HYN_FIBER_HAS_ASM_CONTEXT
+
+extern "C" {
+/**
+ *@brief 把callee-saved寄存器压栈,栈指针保存到*from_sp,然后切到to_sp上弹出寄存器并返回
+ */
+void hyn_fiber_ctx_swap(void **from_sp, void *to_sp);
+/**
+ *@brief 新上下文第一次被换入时的返回地址,调用保存在寄存器里的入口函数
+ */
+void hyn_fiber_ctx_entry();
+}
+
+#if defined(__x86_64__)
+/**
+ * 栈帧(低地址->高地址): mxcsr|x87 cw, r15, r14, r13, r12, rbx, rbp, 返回地址
+ */
+asm(R"(
+    .text
+    .globl  hyn_fiber_ctx_swap
+    .type   hyn_fiber_ctx_swap,@function
+    .align  16
+hyn_fiber_ctx_swap:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r12
+    pushq   %r13
+    pushq   %r14
+    pushq   %r15
+    subq    $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    addq    $8, %rsp
+    popq    %r15
+    popq    %r14
+    popq    %r13
+    popq    %r12
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   hyn_fiber_ctx_swap,.-hyn_fiber_ctx_swap
+
+    .globl  hyn_fiber_ctx_entry
+    .type   hyn_fiber_ctx_entry,@function
+    .align  16
+hyn_fiber_ctx_entry:
+    .cfi_startproc
+    .cfi_undefined rip
+    callq   *%r12
+    ud2
+    .cfi_endproc
+    .size   hyn_fiber_ctx_entry,.-hyn_fiber_ctx_entry
+)");
+
+static constexpr size_t s_frame_words = 10;
+static constexpr size_t s_entry_slot = 4;
+static constexpr size_t s_return_slot = 7;
+
+#elif defined(__aarch64__)
+/**
+ * 栈帧(低地址->高地址): x19-x28, x29(fp), x30(lr), d8-d15
+ */
+asm(R"(
+    .text
+    .globl  hyn_fiber_ctx_swap
+    .type   hyn_fiber_ctx_swap,%function
+    .align  4
+hyn_fiber_ctx_swap:
+    sub     sp, sp, #160
+    stp     x19, x20, [sp, #0]
+    stp     x21, x22, [sp, #16]
+    stp     x23, x24, [sp, #32]
+    stp     x25, x26, [sp, #48]
+    stp     x27, x28, [sp, #64]
+    stp     x29, x30, [sp, #80]
+    stp     d8,  d9,  [sp, #96]
+    stp     d10, d11, [sp, #112]
+    stp     d12, d13, [sp, #128]
+    stp     d14, d15, [sp, #144]
+    mov     x2, sp
+    str     x2, [x0]
+    mov     sp, x1
+    ldp     x19, x20, [sp, #0]
+    ldp     x21, x22, [sp, #16]
+    ldp     x23, x24, [sp, #32]
+    ldp     x25, x26, [sp, #48]
+    ldp     x27, x28, [sp, #64]
+    ldp     x29, x30, [sp, #80]
+    ldp     d8,  d9,  [sp, #96]
+    ldp     d10, d11, [sp, #112]
+    ldp     d12, d13, [sp, #128]
+    ldp     d14, d15, [sp, #144]
+    add     sp, sp, #160
+    ret
+    .size   hyn_fiber_ctx_swap,.-hyn_fiber_ctx_swap
+
+    .globl  hyn_fiber_ctx_entry
+    .type   hyn_fiber_ctx_entry,%function
+    .align  4
+hyn_fiber_ctx_entry:
+    .cfi_startproc
+    .cfi_undefined x30
+    blr     x19
+    brk     #0
+    .cfi_endproc
+    .size   hyn_fiber_ctx_entry,.-hyn_fiber_ctx_entry
+)");
+
+static constexpr size_t s_frame_words = 20;
+static constexpr size_t s_entry_slot = 0;
+static constexpr size_t s_return_slot = 11;
+
+#endif
+
+namespace hyn::fiber {
+
+void AsmContext::make(void *stack, size_t size, void (*fn)()) {
+    //栈顶16字节对齐,预留出第一次换入时要弹出的寄存器
+    auto top = (reinterpret_cast<uintptr_t>(stack) + size) & ~static_cast<uintptr_t>(15);
+    auto *frame = reinterpret_cast<uint64_t *>(top) - s_frame_words;
+    for (size_t i = 0; i < s_frame_words; ++i) {
+        frame[i] = 0;
+    }
+#if defined(__x86_64__)
+    //mxcsr和x87控制字的默认值
+    frame[0] = 0x1F80ull | (0x037Full << 32);
+#endif
+    frame[s_entry_slot] = reinterpret_cast<uint64_t>(fn);
+    frame[s_return_slot] = reinterpret_cast<uint64_t>(&hyn_fiber_ctx_entry);
+    m_sp = frame;
+}
+
+void AsmContext::Swap(AsmContext &from, AsmContext &to) {
+    hyn_fiber_ctx_swap(&from.m_sp, to.m_sp);
+}
+
+} // hyn::fiber
+
+#endif
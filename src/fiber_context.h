@@ -0,0 +1,107 @@
+/**
+  ******************************************************************************
+  * @file           : fiber_context.h
+  * @author         : hyn
+  * @brief          : 协程上下文切换后端
+  * @attention      : None
+  * @date           : 2023/5/20
+  ******************************************************************************
+  */
+#pragma once
+
+#include <cstddef>
+#include <ucontext.h>
+
+/**
+ * 编译期选择上下文切换后端:
+ * 默认在x86-64/aarch64上使用手写汇编切换(只保存callee-saved寄存器和栈指针,不保存信号掩码,没有系统调用);
+ * 定义HYN_FIBER_USE_UCONTEXT(cmake -DFIBER_CONTEXT=ucontext)或者在其他架构上退回到ucontext实现。
+ */
+#if !defined(HYN_FIBER_USE_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+#define HYN_FIBER_USE_UCONTEXT
+#endif
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define HYN_FIBER_HAS_ASM_CONTEXT 1
+#endif
+
+namespace hyn::fiber {
+
+/**
+ *@brief 基于getcontext/makecontext/swapcontext的上下文
+ *@note 每次切换都会调用sigprocmask保存/恢复信号掩码
+ */
+class UContext {
+public:
+    /**
+     *@brief 在指定的栈上构造上下文,切换进来后执行fn
+     *@param stack 栈底地址
+     *@param size 栈大小
+     *@param fn 入口函数,不允许返回
+     */
+    void make(void *stack, size_t size, void (*fn)());
+
+    /**
+     *@brief 保存当前上下文到from,切换到to
+     */
+    static void Swap(UContext &from, UContext &to);
+
+    /**
+     *@brief 切出后保存的栈指针,不支持的架构返回nullptr
+     */
+    [[nodiscard]] void *getSp() const;
+
+    /**
+     *@brief 后端名称
+     */
+    static const char *Name() { return "ucontext"; }
+
+private:
+    ucontext_t m_ctx{};
+};
+
+#ifdef HYN_FIBER_HAS_ASM_CONTEXT
+
+/**
+ *@brief 汇编实现的上下文
+ *@note 只保存callee-saved寄存器,切换时把寄存器压到当前栈上,上下文中只记录栈指针
+ */
+class AsmContext {
+public:
+    /**
+     *@brief 在指定的栈上构造上下文,切换进来后执行fn
+     *@param stack 栈底地址
+     *@param size 栈大小
+     *@param fn 入口函数,不允许返回
+     */
+    void make(void *stack, size_t size, void (*fn)());
+
+    /**
+     *@brief 保存当前上下文到from,切换到to
+     */
+    static void Swap(AsmContext &from, AsmContext &to);
+
+    /**
+     *@brief 切出后保存的栈指针
+     */
+    [[nodiscard]] void *getSp() const { return m_sp; }
+
+    /**
+     *@brief 后端名称
+     */
+    static const char *Name() { return "asm"; }
+
+private:
+    ///保存的栈指针
+    void *m_sp = nullptr;
+};
+
+#endif
+
+#ifdef HYN_FIBER_USE_UCONTEXT
+using Context = UContext;
+#else
+using Context = AsmContext;
+#endif
+
+} // hyn::fiber
@@ -59,9 +59,12 @@ size_t http_parser_execute(http_parser *parser, const char *buffer, size_t len,
 {
 	if(len == 0) return 0;
 	parser->nread = 0;
-	parser->mark = 0;
-	parser->field_len = 0;
-	parser->field_start = 0;
+	/* off > 0: continuing in the same buffer, marks of a split token stay valid */
+	if(off == 0) {
+		parser->mark = 0;
+		parser->field_len = 0;
+		parser->field_start = 0;
+	}
 	
 	const char *p, *pe;
 	int cs = parser->cs;
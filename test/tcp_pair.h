@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file           : tcp_pair.h
+  * @author         : hyn
+  * @brief          : 测试用的回环连接：在127.0.0.1上建立一对连接好的socket
+  * @attention      : 建立连接的调用不能放进assert，NDEBUG下会被去掉；失败时直接abort
+  * @date           : 2023/6/5
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TCP_PAIR_H
+#define SERVERFRAMEWORK_TCP_PAIR_H
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include "../src/Address.h"
+#include "../src/Socket.h"
+#include "../src/SocketStream.h"
+
+/**
+ *@brief 建立一对连接好的socket
+ *@return {客户端, 服务端}
+ */
+inline std::pair<hyn::Socket::ptr, hyn::Socket::ptr> tcp_socket_pair() {
+    auto addr = hyn::IPv4Address::Create("127.0.0.1", 0);
+    auto listener = hyn::Socket::CreateTCP(addr);
+    bool ok = listener->bind(addr) && listener->listen();
+    auto client = hyn::Socket::CreateTCP(addr);
+    ok = ok && client->connect(listener->getLocalAddress());
+    hyn::Socket::ptr server = ok ? listener->accept() : nullptr;
+    listener->close();
+    if (!server) {
+        std::cerr << "tcp_socket_pair: connect 127.0.0.1 failed, errno=" << errno << std::endl;
+        abort();
+    }
+    return {client, server};
+}
+
+/**
+ *@brief 建立一对连接，客户端包成SocketStream，服务端包成Server(SocketStream、HttpSession等以Socket::ptr构造的流)
+ */
+template<class Server = hyn::SocketStream>
+std::pair<hyn::SocketStream::ptr, std::shared_ptr<Server>> tcp_pair() {
+    auto [client, server] = tcp_socket_pair();
+    return {std::make_shared<hyn::SocketStream>(client), std::make_shared<Server>(server)};
+}
+
+#endif //SERVERFRAMEWORK_TCP_PAIR_H
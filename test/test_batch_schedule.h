@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file           : test_batch_schedule.h
+  * @author         : hyn
+  * @brief          : 批量提交任务和逐个提交的对比
+  * @attention      : None
+  * @date           : 2023/5/23
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_BATCH_SCHEDULE_H
+#define SERVERFRAMEWORK_TEST_BATCH_SCHEDULE_H
+
+#include <atomic>
+#include <iostream>
+#include "../src/Logger.h"
+#include "../src/Scheduler.h"
+#include "../src/util.h"
+
+static std::atomic<uint64_t> s_batch_done{0};
+
+/**
+ *@brief 外部线程每次提交batch个任务，返回每秒完成的任务数
+ */
+double batch_schedule_bench(size_t batch, uint64_t total) {
+    s_batch_done = 0;
+    hyn::scheduler::Scheduler sc(4, false, "batch");
+    sc.start();
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (uint64_t i = 0; i < total; i += batch) {
+        if (batch == 1) {
+            sc.schedule([]() { ++s_batch_done; });
+            continue;
+        }
+        hyn::scheduler::Scheduler::TaskList tasks;
+        for (size_t k = 0; k < batch; ++k) {
+            tasks.add([]() { ++s_batch_done; });
+        }
+        sc.scheduleBatch(tasks);
+    }
+    while (s_batch_done < total) {
+        usleep(100);
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    sc.stop();
+    return total * 1e6 / (cost ? cost : 1);
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    const uint64_t total = 1 << 20;
+    for (size_t batch: {1, 16, 256}) {
+        std::cout << "batch: " << batch << " tasks/sec: " << batch_schedule_bench(batch, total) << '\n';
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_BATCH_SCHEDULE_H
@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file           : test_buffer_pool.h
+  * @author         : hyn
+  * @brief          : 每个请求新建ByteArray时缓冲区的分配次数
+  * @attention      : 替换了全局的operator new，只统计1K以上的分配
+  * @date           : 2023/6/1
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_BUFFER_POOL_H
+#define SERVERFRAMEWORK_TEST_BUFFER_POOL_H
+
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+#include "../src/BufferPool.h"
+#include "../src/ByteArray.h"
+#include "../src/util.h"
+
+static std::atomic<uint64_t> s_buffer_allocs{0};
+
+void *operator new(size_t size) {
+    if (size >= 1024) {
+        ++s_buffer_allocs;
+    }
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/**
+ *@brief 模拟请求：新建ByteArray，写入size字节再全部读出来，请求结束释放
+ */
+void buffer_request(size_t base_size, size_t size) {
+    static thread_local std::vector<char> data(1 << 20, 'x');
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(base_size));
+    ba->write(data.data(), size);
+    ba->setPos(0);
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs);
+}
+
+void buffer_pool_bench(int threads, size_t base_size, size_t size, int requests) {
+    uint64_t before = s_buffer_allocs;
+    uint64_t begin = hyn::util::GetCurrentUS();
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> steady{0};
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([=, &steady]() {
+            //第一个请求把缓存建起来，之后的都应该不再分配
+            buffer_request(base_size, size);
+            uint64_t start = s_buffer_allocs;
+            for (int i = 1; i < requests; ++i) {
+                buffer_request(base_size, size);
+            }
+            steady += s_buffer_allocs - start;
+        });
+    }
+    for (auto &t: workers) {
+        t.join();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    auto stats = hyn::BufferPool::GetStats();
+    std::cout << "threads: " << threads << " node: " << base_size << " request: " << size
+              << " allocs total: " << s_buffer_allocs - before << " allocs/request after warm up: "
+              << (double) steady / (threads * (requests - 1)) << " ns/request: "
+              << cost * 1000.0 / (threads * requests) << '\n';
+    std::cout << "  pool hits: " << stats.hits << " misses: " << stats.misses << " bypass: " << stats.bypass
+              << " cached: " << stats.cachedBytes << " rss: " << stats.rss << '\n';
+}
+
+void test() {
+    buffer_pool_bench(1, 4096, 10000, 100000);
+    buffer_pool_bench(4, 16384, 100000, 20000);
+    buffer_pool_bench(1, 65536, 1 << 20, 2000);
+    //不在级别里的大小不走池
+    buffer_pool_bench(1, 1 << 20, 1 << 20, 2000);
+}
+
+#endif //SERVERFRAMEWORK_TEST_BUFFER_POOL_H
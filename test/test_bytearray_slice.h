@@ -0,0 +1,145 @@
+/**
+  ******************************************************************************
+  * @file           : test_bytearray_slice.h
+  * @author         : hyn
+  * @brief          : ByteArray切片和追加，代理转发时不拷贝数据
+  * @attention      : 转发路径是readv到ByteArray，append到另一个ByteArray，getReadBuffers后writev
+  * @date           : 2023/5/31
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_BYTEARRAY_SLICE_H
+#define SERVERFRAMEWORK_TEST_BYTEARRAY_SLICE_H
+
+#include <cassert>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "../src/ByteArray.h"
+#include "../src/util.h"
+
+void test_slice() {
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(7));
+    std::string data;
+    for (int i = 0; i < 100; ++i) {
+        data += std::to_string(i);
+    }
+    ba->writeStringWithoutLength(data);
+    ba->setPos(0);
+
+    //切片和原来的数据共用内存
+    auto part = ba->slice(50, 13);
+    assert(part->getPos() == 0 && part->getReadSize() == 50);
+    assert(part->toString() == data.substr(13, 50));
+    std::vector<iovec> src, dst;
+    ba->getReadBuffers(src, 50, 13);
+    part->getReadBuffers(dst);
+    assert(src.size() == dst.size() && src[0].iov_base == dst[0].iov_base);
+
+    //写一段，接一段共用的，再写一段
+    hyn::ByteArray::ptr out(new hyn::ByteArray(16));
+    out->writeStringWithoutLength("head:");
+    out->append(*part);
+    out->writeFuint32(0x12345678);
+    out->setPos(0);
+    assert(out->toString().substr(0, 5 + 50) == "head:" + data.substr(13, 50));
+    out->setPos(55);
+    assert(out->readFuint32() == 0x12345678);
+
+    //当前位置后面的数据被丢弃
+    out->setPos(5);
+    out->append(*ba, 3, 0);
+    out->setPos(0);
+    assert(out->toString() == "head:" + data.substr(0, 3));
+
+    //追加自己的数据
+    out->setPos(out->getSize());
+    out->append(*out, 5, 0);
+    out->setPos(0);
+    assert(out->toString() == "head:" + data.substr(0, 3) + "head:");
+
+    //原来的ByteArray释放后切片仍然有效
+    ba.reset();
+    assert(part->toString() == data.substr(13, 50));
+    part->clear();
+    part->writeStringWithoutLength("fresh");
+    part->setPos(0);
+    assert(part->toString() == "fresh");
+}
+
+/**
+ *@brief 从一个socketpair读chunk字节，转发到另一个socketpair，copy为true时先拷贝到另一个ByteArray再发
+ */
+void proxy_bench(bool copy, size_t chunk, int rounds) {
+    int in[2], out[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, in);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, out);
+    int size = chunk * 2;
+    for (int *fds: {in, out}) {
+        for (int i = 0; i < 2; ++i) {
+            setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+            setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+    }
+    std::string payload(chunk, 'x');
+    std::string received(chunk, 0);
+    hyn::ByteArray::ptr request(new hyn::ByteArray(16 * 1024));
+    hyn::ByteArray::ptr forward(new hyn::ByteArray(16 * 1024));
+    std::vector<char> tmp(chunk);
+    uint64_t cost = 0;
+    for (int r = 0; r < rounds; ++r) {
+        payload[r % chunk] = (char) ('a' + r % 26);
+        write(in[1], payload.data(), chunk);
+
+        uint64_t begin = hyn::util::GetCurrentUS();
+        request->clear();
+        forward->clear();
+        std::vector<iovec> iovs;
+        for (size_t n = 0; n < chunk;) {
+            iovs.clear();
+            request->getWriteBuffers(iovs, chunk - n);
+            ssize_t rt = readv(in[0], iovs.data(), (int) iovs.size());
+            assert(rt > 0);
+            request->setPos(request->getPos() + rt);
+            n += rt;
+        }
+        request->setPos(0);
+        if (copy) {
+            request->read(tmp.data(), chunk);
+            forward->write(tmp.data(), chunk);
+        } else {
+            forward->append(*request);
+        }
+        forward->setPos(0);
+        while (forward->getReadSize()) {
+            iovs.clear();
+            forward->getReadBuffers(iovs);
+            ssize_t rt = writev(out[1], iovs.data(), (int) iovs.size());
+            assert(rt > 0);
+            forward->setPos(forward->getPos() + rt);
+        }
+        cost += hyn::util::GetCurrentUS() - begin;
+
+        for (size_t n = 0; n < chunk;) {
+            n += read(out[0], &received[n], chunk - n);
+        }
+        assert(received == payload);
+    }
+    for (int fd: {in[0], in[1], out[0], out[1]}) {
+        close(fd);
+    }
+    std::cout << (copy ? "copy " : "slice") << " chunk: " << chunk << " us per forward: "
+              << (double) cost / rounds << '\n';
+}
+
+void test() {
+    test_slice();
+    for (size_t chunk: {4096, 65536, 1 << 20}) {
+        proxy_bench(true, chunk, 200);
+        proxy_bench(false, chunk, 200);
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_BYTEARRAY_SLICE_H
@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file           : test_fd_lookup.h
+  * @author         : hyn
+  * @brief          : 多线程同时查fd上下文时hook调用的吞吐，冷缓存下查一条fd记录的耗时
+  * @attention      : 每次hook的recv都要查一次FdMgr
+  * @date           : 2023/5/29
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_FD_LOOKUP_H
+#define SERVERFRAMEWORK_TEST_FD_LOOKUP_H
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include "../src/FDManger.h"
+#include "../src/Hook.h"
+#include "../src/util.h"
+
+/**
+ *@brief 每个线程一个socketpair，先写进去一个字节，然后不停地用hook的recv(MSG_PEEK)读，不会阻塞，
+ *       测的主要是FdMgr查找的开销；线程数增加时每个线程的吞吐不应该明显下降
+ */
+void fd_lookup_bench(int threads, int ops) {
+    std::vector<std::thread> workers;
+    std::vector<int> fds;
+    for (int i = 0; i < threads; ++i) {
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        hyn::FdMgr::GetInstance()->get(sv[0], true);
+        send(sv[1], "x", 1, 0);
+        fds.push_back(sv[0]);
+        fds.push_back(sv[1]);
+    }
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    uint64_t start = 0;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([fd = fds[i * 2], ops, &ready, &go]() {
+            hyn::set_hook_enable(true);
+            char c;
+            ++ready;
+            while (!go) {
+                std::this_thread::yield();
+            }
+            for (int n = 0; n < ops; ++n) {
+                recv(fd, &c, 1, MSG_PEEK);
+            }
+        });
+    }
+    while (ready != threads) {
+        std::this_thread::yield();
+    }
+    start = hyn::util::GetCurrentMS();
+    go = true;
+    for (auto &t: workers) {
+        t.join();
+    }
+    uint64_t used = hyn::util::GetCurrentMS() - start;
+    for (int fd: fds) {
+        hyn::FdMgr::GetInstance()->del(fd);
+        close(fd);
+    }
+    std::cout << "threads: " << threads << " ms: " << used
+              << " ops/s per thread: " << (uint64_t) ops * 1000 / (used ? used : 1) << '\n';
+}
+
+/**
+ *@brief 在远大于缓存的一批fd记录上随机查找并读取超时时间，每次查找基本都是缓存未命中，
+ *       耗时主要取决于一次查找要碰几个缓存行
+ */
+void fd_record_scan_bench(int count, int ops) {
+    auto *mgr = hyn::FdMgr::GetInstance();
+    //用不存在的fd号，只创建记录，不会碰到真正的文件
+    const int base = 1 << 20;
+    std::vector<int> order(count);
+    for (int i = 0; i < count; ++i) {
+        order[i] = base + i;
+        mgr->get(base + i, true);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    uint64_t sum = 0;
+    uint64_t start = hyn::util::GetCurrentMS();
+    for (int n = 0; n < ops; ++n) {
+        auto ctx = mgr->get(order[n % count]);
+        sum += ctx->get_time(SO_RCVTIMEO) + ctx->is_socket();
+    }
+    uint64_t used = hyn::util::GetCurrentMS() - start;
+    for (int fd: order) {
+        mgr->del(fd);
+    }
+    std::cout << "records: " << count << " ns per lookup: " << used * 1000000.0 / ops
+              << (sum ? "" : " ") << '\n';
+}
+
+void test() {
+    fd_record_scan_bench(1 << 18, 4000000);
+    for (int threads: {1, 2, 4, 8}) {
+        fd_lookup_bench(threads, 1000000);
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_FD_LOOKUP_H
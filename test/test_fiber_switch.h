@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file           : test_fiber_switch.h
+  * @author         : hyn
+  * @brief          : 协程上下文切换性能测试
+  * @attention      : None
+  * @date           : 2023/5/20
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_FIBER_SWITCH_H
+#define SERVERFRAMEWORK_TEST_FIBER_SWITCH_H
+
+#include <iostream>
+#include <vector>
+#include "../src/Logger.h"
+#include "../src/fiber.h"
+#include "../src/util.h"
+
+/**
+ *@brief 两个上下文之间来回切换,统计每秒切换次数
+ */
+template<typename Ctx>
+struct ContextSwitchBench {
+    static inline Ctx s_main;
+    static inline Ctx s_co;
+
+    static void Entry() {
+        for (;;) {
+            Ctx::Swap(s_co, s_main);
+        }
+    }
+
+    static double Run(uint64_t rounds) {
+        std::vector<char> stack(64 * 1024);
+        s_co.make(stack.data(), stack.size(), &Entry);
+        uint64_t begin = hyn::util::GetCurrentUS();
+        for (uint64_t i = 0; i < rounds; ++i) {
+            Ctx::Swap(s_main, s_co);
+        }
+        uint64_t cost = hyn::util::GetCurrentUS() - begin;
+        return rounds * 2 * 1e6 / (cost ? cost : 1);
+    }
+};
+
+/**
+ *@brief 通过Fiber::call/back来回切换,统计每秒切换次数
+ */
+double fiber_switch_bench(uint64_t rounds) {
+    hyn::fiber::Fiber::GetThis();
+    hyn::fiber::Fiber *raw = nullptr;
+    hyn::fiber::Fiber::ptr fiber(new hyn::fiber::Fiber([&raw, rounds]() {
+        for (uint64_t i = 0; i < rounds; ++i) {
+            raw->back();
+        }
+    }, 0, true));
+    raw = fiber.get();
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (uint64_t i = 0; i < rounds; ++i) {
+        fiber->call();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    fiber->call();
+    assert(fiber->getState() == hyn::fiber::Fiber::TERM);
+    return rounds * 2 * 1e6 / (cost ? cost : 1);
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    const uint64_t rounds = 1000000;
+    std::cout << "ucontext switches/sec: " << ContextSwitchBench<hyn::fiber::UContext>::Run(rounds) << '\n';
+#ifdef HYN_FIBER_HAS_ASM_CONTEXT
+    std::cout << "asm      switches/sec: " << ContextSwitchBench<hyn::fiber::AsmContext>::Run(rounds) << '\n';
+#endif
+    std::cout << "Fiber(" << hyn::fiber::Context::Name() << ") switches/sec: " << fiber_switch_bench(rounds) << '\n';
+}
+
+#endif //SERVERFRAMEWORK_TEST_FIBER_SWITCH_H
@@ -0,0 +1,224 @@
+/**
+  ******************************************************************************
+  * @file           : test_fixed_fast_path.h
+  * @author         : hyn
+  * @brief          : 固定长度读写的快速路径和批量字节序转换
+  * @attention      : legacy是改之前的写法：先byteswap，再走通用的write/read
+  * @date           : 2023/6/3
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_FIXED_FAST_PATH_H
+#define SERVERFRAMEWORK_TEST_FIXED_FAST_PATH_H
+
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <vector>
+#include "../src/ByteArray.h"
+#include "../src/util.h"
+
+/**
+ *@brief 一条混合字段的记录
+ */
+void write_record(hyn::ByteArray::ptr &ba, int i) {
+    ba->writeFuint8(i);
+    ba->writeFint16(-i);
+    ba->writeFuint32(i * 2654435761u);
+    ba->writeFint64(-(int64_t) i * 0x9E3779B97F4A7C15ll);
+    ba->writeDouble(i * 0.5);
+    ba->writeFloat(i * 0.25f);
+}
+
+void check_record(hyn::ByteArray::ptr &ba, int i) {
+    assert(ba->readFuint8() == (uint8_t) i);
+    assert(ba->readFint16() == (int16_t) -i);
+    assert(ba->readFuint32() == i * 2654435761u);
+    assert(ba->readFint64() == -(int64_t) i * 0x9E3779B97F4A7C15ll);
+    assert(ba->readDouble() == i * 0.5);
+    assert(ba->readFloat() == i * 0.25f);
+}
+
+template<typename T>
+void legacy_write(hyn::ByteArray::ptr &ba, T value) {
+    if constexpr (sizeof(T) > 1) {
+        if (!ba->isLittleEndian()) value = byteswap(value);
+    }
+    ba->write(&value, sizeof(value));
+}
+
+template<typename T>
+T legacy_read(hyn::ByteArray::ptr &ba) {
+    T value;
+    ba->read(&value, sizeof(value));
+    if constexpr (sizeof(T) > 1) {
+        if (!ba->isLittleEndian()) value = byteswap(value);
+    }
+    return value;
+}
+
+void test_fixed_correct() {
+    for (bool little: {false, true}) {
+        for (size_t base: {3, 7, 13, 4096}) {
+            hyn::ByteArray::ptr ba(new hyn::ByteArray(base));
+            hyn::ByteArray::ptr ref(new hyn::ByteArray(base));
+            ba->setIsLittleEndian(little);
+            ref->setIsLittleEndian(little);
+            for (int i = 0; i < 500; ++i) {
+                write_record(ba, i);
+                legacy_write<uint8_t>(ref, i);
+                legacy_write<int16_t>(ref, -i);
+                legacy_write<uint32_t>(ref, i * 2654435761u);
+                legacy_write<int64_t>(ref, -(int64_t) i * 0x9E3779B97F4A7C15ll);
+                double d = i * 0.5;
+                uint64_t d64;
+                memcpy(&d64, &d, sizeof(d));
+                legacy_write<uint64_t>(ref, d64);
+                float f = i * 0.25f;
+                uint32_t f32;
+                memcpy(&f32, &f, sizeof(f));
+                legacy_write<uint32_t>(ref, f32);
+            }
+            ba->setPos(0);
+            ref->setPos(0);
+            assert(ba->toString() == ref->toString());
+            for (int i = 0; i < 500; ++i) {
+                check_record(ba, i);
+            }
+            assert(ba->getReadSize() == 0);
+
+            //读到末尾时抛异常，位置不变
+            bool thrown = false;
+            try {
+                ba->readFuint32();
+            } catch (std::out_of_range &) {
+                thrown = true;
+            }
+            assert(thrown && ba->getReadSize() == 0);
+
+            //批量读写和逐个读写的结果一样
+            std::vector<uint16_t> u16(1000);
+            std::vector<uint32_t> u32(1000);
+            std::vector<int64_t> i64(1000);
+            std::iota(u16.begin(), u16.end(), 0x1234);
+            std::iota(u32.begin(), u32.end(), 0x12345678);
+            std::iota(i64.begin(), i64.end(), -0x123456789abcll);
+            ba->clear();
+            ref->clear();
+            ba->writeFixedArray(u16.data(), u16.size() - 1);
+            ba->writeFixedArray(u32.data(), u32.size() - 3);
+            ba->writeFixedArray(i64.data(), i64.size());
+            for (size_t k = 0; k + 1 < u16.size(); ++k) ref->writeFuint16(u16[k]);
+            for (size_t k = 0; k + 3 < u32.size(); ++k) ref->writeFuint32(u32[k]);
+            for (auto v: i64) ref->writeFint64(v);
+            ba->setPos(0);
+            ref->setPos(0);
+            assert(ba->toString() == ref->toString());
+            std::vector<uint16_t> r16(u16.size() - 1);
+            std::vector<uint32_t> r32(u32.size() - 3);
+            std::vector<int64_t> r64(i64.size());
+            ba->readFixedArray(r16.data(), r16.size());
+            ba->readFixedArray(r32.data(), r32.size());
+            ba->readFixedArray(r64.data(), r64.size());
+            assert(std::equal(r16.begin(), r16.end(), u16.begin()));
+            assert(std::equal(r32.begin(), r32.end(), u32.begin()));
+            assert(r64 == i64);
+        }
+    }
+}
+
+/**
+ *@brief 混合字段序列化的吞吐，legacy为true时用改之前的写法
+ */
+void fixed_bench(bool legacy, bool little, int records) {
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(4096));
+    ba->setIsLittleEndian(little);
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < records; ++i) {
+        if (legacy) {
+            legacy_write<uint8_t>(ba, i);
+            legacy_write<int16_t>(ba, -i);
+            legacy_write<uint32_t>(ba, i);
+            legacy_write<int64_t>(ba, i);
+            legacy_write<uint64_t>(ba, i);
+            legacy_write<uint32_t>(ba, i);
+        } else {
+            ba->writeFuint8(i);
+            ba->writeFint16(-i);
+            ba->writeFuint32(i);
+            ba->writeFint64(i);
+            ba->writeFuint64(i);
+            ba->writeFuint32(i);
+        }
+    }
+    uint64_t write_cost = hyn::util::GetCurrentUS() - begin;
+    ba->setPos(0);
+    uint64_t sum = 0;
+    begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < records; ++i) {
+        if (legacy) {
+            sum += legacy_read<uint8_t>(ba);
+            sum += legacy_read<int16_t>(ba);
+            sum += legacy_read<uint32_t>(ba);
+            sum += legacy_read<int64_t>(ba);
+            sum += legacy_read<uint64_t>(ba);
+            sum += legacy_read<uint32_t>(ba);
+        } else {
+            sum += ba->readFuint8();
+            sum += ba->readFint16();
+            sum += ba->readFuint32();
+            sum += ba->readFint64();
+            sum += ba->readFuint64();
+            sum += ba->readFuint32();
+        }
+    }
+    uint64_t read_cost = hyn::util::GetCurrentUS() - begin;
+    assert(ba->getReadSize() == 0 && sum != 1);
+    double mb = ba->getSize() / 1048576.0;
+    std::cout << (legacy ? "legacy " : "fast   ") << (little ? "little" : "big   ") << " write MB/s: "
+              << mb / (write_cost / 1e6) << " read MB/s: " << mb / (read_cost / 1e6) << '\n';
+}
+
+/**
+ *@brief 整块uint32数组的吞吐，bulk为false时逐个写
+ */
+void fixed_array_bench(bool bulk, int count) {
+    std::vector<uint32_t> values(count), out(count);
+    std::iota(values.begin(), values.end(), 0);
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(4096));
+    uint64_t begin = hyn::util::GetCurrentUS();
+    if (bulk) {
+        ba->writeFixedArray(values.data(), values.size());
+    } else {
+        for (auto v: values) ba->writeFuint32(v);
+    }
+    uint64_t write_cost = hyn::util::GetCurrentUS() - begin;
+    ba->setPos(0);
+    begin = hyn::util::GetCurrentUS();
+    if (bulk) {
+        ba->readFixedArray(out.data(), out.size());
+    } else {
+        for (auto &v: out) v = ba->readFuint32();
+    }
+    uint64_t read_cost = hyn::util::GetCurrentUS() - begin;
+    assert(out == values);
+    double mb = count * 4 / 1048576.0;
+    std::cout << (bulk ? "array  " : "single ") << "u32 big write MB/s: " << mb / (write_cost / 1e6)
+              << " read MB/s: " << mb / (read_cost / 1e6) << '\n';
+}
+
+void test() {
+    test_fixed_correct();
+    for (int round = 0; round < 2; ++round) {
+        for (bool little: {false, true}) {
+            fixed_bench(true, little, 1 << 20);
+            fixed_bench(false, little, 1 << 20);
+        }
+    }
+    fixed_array_bench(false, 1 << 22);
+    fixed_array_bench(true, 1 << 22);
+}
+
+#endif //SERVERFRAMEWORK_TEST_FIXED_FAST_PATH_H
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file           : test_hook_timeout.h
+  * @author         : hyn
+  * @brief          : 带超时的recv阻塞时、跨线程提交任务时的内存分配次数
+  * @attention      : 替换了全局的operator new来计数
+  * @date           : 2023/5/28
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HOOK_TIMEOUT_H
+#define SERVERFRAMEWORK_TEST_HOOK_TIMEOUT_H
+
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <sys/socket.h>
+#include "../src/FDManger.h"
+#include "../src/IOManager.h"
+#include "../src/Logger.h"
+#include "../src/util.h"
+
+static std::atomic<uint64_t> s_alloc_count{0};
+
+void *operator new(size_t size) {
+    ++s_alloc_count;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/**
+ *@brief 两个协程通过socketpair来回收发，每次recv都设置了超时并且都要等对端，统计稳定后每次往返的分配次数
+ */
+void hook_timeout_bench(size_t threads, int rounds) {
+    std::atomic<int> done{0};
+    std::atomic<uint64_t> allocs{0};
+    hyn::iomanager::IOManager iom(threads, false, "timeout");
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    for (int i = 0; i < 2; ++i) {
+        iom.schedule([sv, i, rounds, &done, &allocs]() {
+            int fd = sv[i];
+            hyn::FdMgr::GetInstance()->get(fd, true);
+            timeval tv{5, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            char buf[8] = "ping";
+            if (i == 0) {
+                send(fd, buf, sizeof(buf), 0);
+            }
+            for (int r = 0; r < rounds; ++r) {
+                //跑过一轮之后各种缓存都建好了，开始计数
+                if (i == 0 && r == rounds / 10) {
+                    allocs = s_alloc_count.load();
+                }
+                if (recv(fd, buf, sizeof(buf), 0) <= 0 || send(fd, buf, sizeof(buf), 0) <= 0) {
+                    break;
+                }
+            }
+            if (i == 0) {
+                allocs = s_alloc_count - allocs;
+                done = rounds - rounds / 10;
+            }
+        });
+    }
+    iom.stop();
+    for (int fd: sv) {
+        //主线程没有开启hook,手动清掉fd上下文,避免下一轮复用fd时拿到旧的状态
+        hyn::FdMgr::GetInstance()->del(fd);
+        close(fd);
+    }
+    std::cout << "threads: " << threads << " round trips: " << done << " allocations: " << allocs
+              << " per round trip: " << (double) allocs / (done ? done.load() : 1) << '\n';
+}
+
+/**
+ *@brief 一个线程提交任务，另外threads个调度线程执行并释放，统计稳定后每个任务的分配次数
+ */
+void task_alloc_bench(size_t threads, int rounds) {
+    const int BATCH = 1000;
+    std::atomic<int> done{0};
+    uint64_t allocs = 0;
+    hyn::scheduler::Scheduler sc(threads, false, "task_alloc");
+    sc.start();
+    for (int r = 0; r < rounds; ++r) {
+        //跑过一轮之后各种缓存都建好了，开始计数
+        if (r == rounds / 10) {
+            allocs = s_alloc_count.load();
+        }
+        for (int i = 0; i < BATCH; ++i) {
+            sc.schedule([&done]() { ++done; });
+        }
+        while (done < (r + 1) * BATCH) {
+            usleep(10);
+        }
+    }
+    allocs = s_alloc_count - allocs;
+    sc.stop();
+    int tasks = (rounds - rounds / 10) * BATCH;
+    std::cout << "threads: " << threads << " tasks: " << tasks << " allocations: " << allocs
+              << " per task: " << (double) allocs / tasks << '\n';
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    hook_timeout_bench(1, 100000);
+    hook_timeout_bench(2, 100000);
+    hook_timeout_bench(4, 100000);
+    task_alloc_bench(1, 200);
+    task_alloc_bench(2, 200);
+    task_alloc_bench(4, 200);
+}
+
+#endif //SERVERFRAMEWORK_TEST_HOOK_TIMEOUT_H
@@ -0,0 +1,201 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_pipeline.h
+  * @author         : hyn
+  * @brief          : HttpSession复用连接上的缓冲区和解析器，pipeline的请求依次解析，响应攒起来一次writev
+  * @attention      : 走127.0.0.1；bench里depth是每个连接同时在路上的请求数
+  * @date           : 2023/6/8
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_PIPELINE_H
+#define SERVERFRAMEWORK_TEST_HTTP_PIPELINE_H
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include "../src/Address.h"
+#include "../src/HttpSession.h"
+#include "../src/IOManager.h"
+#include "../src/Socket.h"
+#include "../src/util.h"
+#include "tcp_pair.h"
+
+/**
+ *@brief 第i个请求，pad是额外头部的长度，body是消息体长度
+ */
+std::string pipeline_request(int i, size_t pad = 0, size_t body = 0) {
+    std::string req = (body ? "POST" : "GET") + std::string(" /pipeline/") + std::to_string(i) + " HTTP/1.1\r\n"
+                      "Host: 127.0.0.1\r\nConnection: keep-alive\r\n";
+    if (pad) {
+        req += "X-Pad: " + std::string(pad, 'p') + "\r\n";
+    }
+    if (body) {
+        req += "Content-Length: " + std::to_string(body) + "\r\n\r\n" + std::string(body, (char) ('a' + i % 26));
+    } else {
+        req += "\r\n";
+    }
+    return req;
+}
+
+void check_pipeline_request(const hyn::http::HttpRequest::ptr &req, int i, size_t pad = 0, size_t body = 0) {
+    assert(req);
+    assert(req->getPath() == "/pipeline/" + std::to_string(i));
+    assert(req->getHeader("host") == "127.0.0.1" && !req->isAutoClose());
+    assert(req->getHeader("x-pad") == std::string(pad, 'p'));
+    assert(req->getBody() == std::string(body, (char) ('a' + i % 26)));
+}
+
+hyn::http::HttpResponse::ptr pipeline_response(int i, size_t body = 5) {
+    hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, false));
+    rsp->setHeader("X-Id", std::to_string(i));
+    rsp->setBody(std::string(body, 'r'));
+    return rsp;
+}
+
+/**
+ *@brief 客户端按chunk大小分段写data
+ */
+void pipeline_write(const hyn::SocketStream::ptr &client, const std::string &data, size_t chunk) {
+    for (size_t i = 0; i < data.size(); i += chunk) {
+        size_t n = std::min(chunk, data.size() - i);
+        assert(client->writeFixSize(data.data() + i, n) == (int) n);
+        if (chunk < 64) {
+            usleep(50);
+        }
+    }
+}
+
+void test_pipeline_correct() {
+    //一次写进去的多个请求，后面的请求不用再读socket
+    {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        std::string data = pipeline_request(0) + pipeline_request(1, 0, 5) + pipeline_request(2);
+        assert(client->writeFixSize(data.data(), data.size()) == (int) data.size());
+        auto r0 = session->recvRequest();
+        assert(session->getBufferedSize() == data.size() - pipeline_request(0).size());
+        auto r1 = session->recvRequest();
+        auto r2 = session->recvRequest();
+        assert(session->getBufferedSize() == 0);
+        check_pipeline_request(r0, 0);
+        check_pipeline_request(r1, 1, 0, 5);
+        check_pipeline_request(r2, 2);
+
+        //响应攒在一起，一次发出
+        std::string expect;
+        for (int i = 0; i < 3; ++i) {
+            auto rsp = pipeline_response(i, i == 1 ? 0 : 5);
+            expect += rsp->toString();
+            session->queueResponse(rsp);
+        }
+        assert(session->getPendingResponses() == 3);
+        assert(session->flushResponses() == (int) expect.size());
+        std::string got(expect.size(), 0);
+        assert(client->readFixSize(&got[0], got.size()) == (int) got.size());
+        assert(got == expect);
+    }
+
+    //任意切开、攒满缓冲区要挪动数据、消息体比缓冲区大
+    for (size_t chunk: {1, 7, 13, 1000, 1 << 20}) {
+        for (bool hold: {false, true}) {
+            auto [client, session] = tcp_pair<hyn::HttpSession>();
+            std::string data;
+            int count = 40;
+            for (int i = 0; i < count; ++i) {
+                data += pipeline_request(i, i % 5 ? 0 : 1500, i % 3 ? 0 : (i % 9 ? 17 : 10000));
+            }
+            hyn::iomanager::IOManager::GetThis()->schedule([client = client, data, chunk] {
+                pipeline_write(client, data, chunk);
+            });
+            std::vector<hyn::http::HttpRequest::ptr> held;
+            std::string expect;
+            for (int i = 0; i < count; ++i) {
+                auto req = session->recvRequest();
+                check_pipeline_request(req, i, i % 5 ? 0 : 1500, i % 3 ? 0 : (i % 9 ? 17 : 10000));
+                if (hold) {
+                    held.push_back(req);
+                }
+                auto rsp = pipeline_response(i);
+                expect += rsp->toString();
+                session->queueResponse(rsp);
+            }
+            //缓冲区挪动或换新之后，之前返回的请求仍然有效
+            for (size_t i = 0; i < held.size(); ++i) {
+                check_pipeline_request(held[i], (int) i, i % 5 ? 0 : 1500, i % 3 ? 0 : (i % 9 ? 17 : 10000));
+            }
+            session->flushResponses();
+            std::string got(expect.size(), 0);
+            assert(client->readFixSize(&got[0], got.size()) == (int) got.size());
+            assert(got == expect);
+        }
+    }
+
+    //请求头超过缓冲区时失败，之前攒下的响应先发出去
+    {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        std::string data = pipeline_request(0) + pipeline_request(1, 8192);
+        hyn::iomanager::IOManager::GetThis()->schedule([client = client, data] {
+            pipeline_write(client, data, 1 << 20);
+        });
+        check_pipeline_request(session->recvRequest(), 0);
+        auto rsp = pipeline_response(0);
+        session->queueResponse(rsp);
+        assert(!session->recvRequest());
+        std::string expect = rsp->toString();
+        std::string got(expect.size(), 0);
+        assert(client->readFixSize(&got[0], got.size()) == (int) got.size());
+        assert(got == expect);
+    }
+}
+
+/**
+ *@brief 客户端每次同时发depth个请求再收depth个响应，batch为false时服务端每个响应单独发送
+ */
+void pipeline_bench(int depth, bool batch, int requests) {
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    std::string batch_data;
+    for (int i = 0; i < depth; ++i) {
+        batch_data += pipeline_request(i);
+    }
+    size_t rsp_size = pipeline_response(0)->toString().size();
+    hyn::iomanager::IOManager::GetThis()->schedule([session = session, batch, requests] {
+        for (int i = 0; i < requests; ++i) {
+            auto req = session->recvRequest();
+            assert(req);
+            auto rsp = pipeline_response(0);
+            if (batch) {
+                session->queueResponse(rsp);
+            } else {
+                session->sendResponse(rsp);
+            }
+        }
+        session->flushResponses();
+    });
+    std::vector<char> buff(rsp_size * depth);
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int done = 0; done < requests; done += depth) {
+        assert(client->writeFixSize(batch_data.data(), batch_data.size()) == (int) batch_data.size());
+        assert(client->readFixSize(buff.data(), buff.size()) == (int) buff.size());
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << "depth: " << depth << (batch ? " batched" : " single ") << " requests/s: " << requests * 1e6 / cost
+              << '\n';
+    client->close();
+}
+
+void test() {
+    hyn::iomanager::IOManager iom(1, true, "pipeline");
+    iom.schedule([] {
+        test_pipeline_correct();
+        for (int round = 0; round < 2; ++round) {
+            pipeline_bench(1, false, 32000);
+            pipeline_bench(16, false, 32000);
+            pipeline_bench(16, true, 32000);
+        }
+    });
+    iom.stop();
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_PIPELINE_H
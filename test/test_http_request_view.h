@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_request_view.h
+  * @author         : hyn
+  * @brief          : 请求的路径、头部直接引用接收缓冲区，解析时不分配内存
+  * @attention      : 替换了全局的operator new，统计所有分配；legacy是改之前的表示：头部全部拷进MAP
+  * @date           : 2023/6/7
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_REQUEST_VIEW_H
+#define SERVERFRAMEWORK_TEST_HTTP_REQUEST_VIEW_H
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include "../src/HttpParser.h"
+#include "../src/Servlet.h"
+#include "../src/util.h"
+
+static std::atomic<uint64_t> s_request_allocs{0};
+
+void *operator new(size_t size) {
+    ++s_request_allocs;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+/**
+ *@brief 一个有headers个头部的请求，content-length为0
+ */
+std::string make_view_request(int headers) {
+    std::string req = "GET /api/v1/items/1234567890?page=2&size=20#top HTTP/1.1\r\n"
+                      "Host: www.example.com\r\n"
+                      "Connection: keep-alive\r\n"
+                      "Content-Length: 0\r\n";
+    for (int i = 3; i < headers; ++i) {
+        req += "X-Header-" + std::to_string(i) + ": value-" + std::to_string(i * 7) + "\r\n";
+    }
+    return req + "\r\n";
+}
+
+void check_view_request(const hyn::http::HttpRequest::ptr &req, int headers) {
+    assert(req->getMethod() == hyn::http::HttpMethod::GET);
+    assert(req->getVersion() == 0x11);
+    assert(req->getPath() == "/api/v1/items/1234567890");
+    assert(req->getQuery() == "page=2&size=20");
+    assert(req->getFragment() == "top");
+    assert(req->getHeaderFields().size() == (size_t) headers);
+    assert(req->getHeader("HOST") == "www.example.com");
+    assert(req->getHeaderView("connection", hyn::http::header::CONNECTION) == "keep-alive");
+    assert(req->getHeaderAs<uint64_t>("content-length", 100) == 0);
+    for (int i = 3; i < headers; ++i) {
+        assert(req->getHeaderAs<int>("x-header-" + std::to_string(i)) == 0);
+        assert(req->getHeader("X-HEADER-" + std::to_string(i)) == "value-" + std::to_string(i * 7));
+    }
+    assert(req->getHeader("not-exist", "def") == "def");
+}
+
+void test_view_correct() {
+    for (int headers: {3, 10, 16, 17, 40}) {
+        std::string data = make_view_request(headers);
+
+        //一次解析完
+        hyn::http::HttpRequestParser parser;
+        assert(parser.execute(data.data(), data.size(), 0) == data.size());
+        assert(parser.isFinished() == 1 && !parser.hasError());
+        check_view_request(parser.getData(), headers);
+
+        //在每个位置断开，分两次解析，断开的token接着上一次的位置
+        for (size_t cut = 1; cut < data.size(); ++cut) {
+            hyn::http::HttpRequestParser split;
+            size_t parsed = split.execute(data.data(), cut, 0);
+            parsed += split.execute(data.data(), data.size(), parsed);
+            assert(parsed == data.size() && split.isFinished() == 1 && !split.hasError());
+            check_view_request(split.getData(), headers);
+        }
+
+        //原来的execute会覆盖已解析的数据，请求要先拷出来
+        std::string copy = data + "body";
+        hyn::http::HttpRequestParser legacy;
+        assert(legacy.execute(&copy[0], copy.size()) == data.size());
+        memset(&copy[0], 'x', data.size());
+        check_view_request(legacy.getData(), headers);
+
+        //detach之后缓冲区可以复用
+        std::string buffer = data;
+        hyn::http::HttpRequestParser detached;
+        detached.execute(buffer.data(), buffer.size(), 0);
+        detached.getData()->detach();
+        buffer.assign(buffer.size(), 'x');
+        check_view_request(detached.getData(), headers);
+
+        //改头部
+        auto req = parser.getData();
+        req->setHeader("host", "a.b.c");
+        assert(req->getHeader("Host") == "a.b.c" && req->getHeaderFields().size() == (size_t) headers);
+        req->delHeader("CONNECTION");
+        assert(!req->hasHeader("connection") && req->getHeaderFields().size() == (size_t) headers - 1);
+        req->setHeader("Content-Length", "abc");
+        uint64_t length = 1;
+        assert(!req->checkGetHeaderAs<uint64_t>("content-length", length, 7) && length == 7);
+        auto &map = req->getHeaders();
+        assert(map.size() == (size_t) headers - 1 && map.at("HOST") == "a.b.c");
+        std::string value;
+        assert(req->hasHeader("x-header-3", &value) == (headers > 3) && (headers == 3 || value == "value-21"));
+    }
+
+    //重复的头部取最后一个
+    std::string dup = "GET / HTTP/1.1\r\nAccept: a\r\naccept: b\r\n\r\n";
+    hyn::http::HttpRequestParser parser;
+    parser.execute(dup.data(), dup.size(), 0);
+    assert(parser.getData()->getHeader("ACCEPT") == "b");
+    assert(parser.getData()->getHeaderFields().size() == 2);
+    assert(parser.getData()->getHeaders().size() == 1);
+    parser.getData()->delHeader("accept");
+    assert(parser.getData()->getHeaderFields().empty());
+}
+
+/**
+ *@brief 反复setHeader/setPath同一个值复用之前拷贝进来的存储，按路径视图找servlet不分配内存
+ */
+void test_set_and_dispatch_no_growth() {
+    std::string data = make_view_request(10);
+    hyn::http::HttpRequestParser parser;
+    parser.execute(data.data(), data.size(), 0);
+    auto req = parser.getData();
+    req->setHeader("X-Trace-Id", "0123456789abcdef0123456789abcdef");
+    req->setHeader("host", "www.example.org.long-enough-for-heap");
+    req->setPath("/api/v2/items/0000000000000000000000");
+    uint64_t before = s_request_allocs;
+    for (int i = 0; i < 1000; ++i) {
+        std::string_view id = i % 2 ? "fedcba9876543210fedcba9876543210" : "0123456789abcdef0123456789abcdef";
+        req->setHeader("x-trace-id", id);
+        req->setHeader("HOST", "www.example.org.long-enough-for-heap");
+        req->setPath("/api/v2/items/1111111111111111111111");
+    }
+    uint64_t allocs = s_request_allocs - before;
+    assert(allocs == 0);
+    assert(req->getHeader("X-TRACE-ID") == "fedcba9876543210fedcba9876543210");
+    assert(req->getHeader("Host") == "www.example.org.long-enough-for-heap");
+    assert(req->getPath() == "/api/v2/items/1111111111111111111111");
+    assert(req->getHeaderFields().size() == 11);
+
+    hyn::ServletDispatch dispatch;
+    auto exact = std::make_shared<hyn::FunctionServlet>(
+            [](hyn::http::HttpRequest::ptr, hyn::http::HttpResponse::ptr, hyn::HttpSession::ptr) { return 0; });
+    auto glob = std::make_shared<hyn::FunctionServlet>(
+            [](hyn::http::HttpRequest::ptr, hyn::http::HttpResponse::ptr, hyn::HttpSession::ptr) { return 0; });
+    dispatch.addServlet("/api/v2/items/1111111111111111111111", exact);
+    dispatch.addGlobServlet("/api/v2/*", glob);
+    before = s_request_allocs;
+    auto matched = dispatch.getMatchedServlet(req->getPath());
+    auto globbed = dispatch.getMatchedServlet(std::string_view("/api/v2/other/path/longer-than-sso").substr(0, 20));
+    allocs = s_request_allocs - before;
+    assert(allocs == 0);
+    assert(matched == exact && globbed == glob);
+}
+
+/**
+ *@brief 解析requests次10个头部的请求，legacy为true时再像改之前一样把头部拷成MAP
+ */
+void request_view_bench(bool legacy, int requests) {
+    std::string data = make_view_request(10);
+    uint64_t allocs = 0;
+    uint64_t sum = 0;
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < requests; ++i) {
+        hyn::http::HttpRequestParser parser;
+        uint64_t before = s_request_allocs;
+        parser.execute(data.data(), data.size(), 0);
+        sum += parser.getContentLength() + parser.getData()->getPath().size();
+        parser.getData()->initClose();
+        if (legacy) {
+            sum += parser.getData()->getHeaders().size();
+        }
+        allocs += s_request_allocs - before;
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    if (!legacy) {
+        assert(allocs == 0);
+    }
+    std::cout << (legacy ? "legacy " : "view   ") << "requests/s: " << requests * 1e6 / cost
+              << " allocs/request: " << (double) allocs / requests << " checksum: " << sum << '\n';
+}
+
+void test() {
+    test_view_correct();
+    test_set_and_dispatch_no_growth();
+    for (int round = 0; round < 2; ++round) {
+        request_view_bench(true, 200000);
+        request_view_bench(false, 200000);
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_REQUEST_VIEW_H
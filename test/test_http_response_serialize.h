@@ -0,0 +1,170 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_response_serialize.h
+  * @author         : hyn
+  * @brief          : HttpResponse::serialize直接写进调用者的缓冲区，和原来用stringstream拼接对比
+  * @attention      : legacy是最早的dump：状态行、头部、长度全部经过ostream格式化
+  * @date           : 2023/6/11
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_RESPONSE_SERIALIZE_H
+#define SERVERFRAMEWORK_TEST_HTTP_RESPONSE_SERIALIZE_H
+
+#include <cassert>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "../src/Http.h"
+#include "../src/util.h"
+
+/**
+ *@brief 改之前的写法
+ */
+std::string legacy_serialize(const hyn::http::HttpResponse &rsp) {
+    std::stringstream os;
+    os << "HTTP/" << static_cast<uint32_t>((rsp.getVersion() >> 4)) << "."
+       << static_cast<uint32_t>((rsp.getVersion() & 0x0F)) << " " << (uint32_t) rsp.getStatus() << " "
+       << (rsp.getReason().empty() ? hyn::http::HttpStatusToString(rsp.getStatus()) : rsp.getReason()) << "\r\n";
+    for (auto &i: rsp.getHeaders()) {
+        if (!rsp.isWebsocket() && strcasecmp(i.first.c_str(), "connection") == 0) {
+            continue;
+        }
+        os << i.first << ": " << i.second << "\r\n";
+    }
+    if (!rsp.isWebsocket()) {
+        os << "connection: " << (rsp.isAutoClose() ? "close" : "keep-alive") << "\r\n";
+    }
+    if (!rsp.getBody().empty()) {
+        os << "content-length: " << rsp.getBody().size() << "\r\n\r\n" << rsp.getBody();
+    } else {
+        os << "\r\n";
+    }
+    return os.str();
+}
+
+/**
+ *@brief 小的JSON响应
+ */
+hyn::http::HttpResponse::ptr json_response(int id) {
+    hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, false));
+    rsp->setHeader("Server", "hyn/1.0");
+    rsp->setHeader("Content-Type", "application/json");
+    rsp->setBody("{\"id\":" + std::to_string(id) + ",\"name\":\"hyn\",\"ok\":true}");
+    return rsp;
+}
+
+/**
+ *@brief 用serialize转成字符串，先用小缓冲区试一次
+ */
+std::string serialize_string(const hyn::http::HttpResponse &rsp) {
+    char small[16];
+    size_t len = rsp.serialize(small, sizeof(small));
+    std::string out(len, 0);
+    assert(rsp.serialize(&out[0], out.size()) == len);
+    assert(rsp.serializeHead(&out[0], out.size()) == len - rsp.getBody().size());
+    return out;
+}
+
+void test_serialize_correct() {
+    std::vector<hyn::http::HttpResponse::ptr> rsps;
+    rsps.push_back(json_response(1));
+    for (auto status: {hyn::http::HttpStatus::OK, hyn::http::HttpStatus::NOT_FOUND,
+                       hyn::http::HttpStatus::NETWORK_AUTHENTICATION_REQUIRED, hyn::http::HttpStatus::CONTINUE}) {
+        for (uint8_t version: {0x10, 0x11, 0x20}) {
+            for (bool close: {false, true}) {
+                hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(version, close));
+                rsp->setStatus(status);
+                rsp->setBody(close ? "" : "hello");
+                rsps.push_back(rsp);
+            }
+        }
+    }
+    //自定义原因、不认识的状态码、websocket、很长的头部
+    hyn::http::HttpResponse::ptr reason(new hyn::http::HttpResponse);
+    reason->setReason("Everything Fine");
+    rsps.push_back(reason);
+    hyn::http::HttpResponse::ptr unknown(new hyn::http::HttpResponse);
+    unknown->setStatus(static_cast<hyn::http::HttpStatus>(299));
+    rsps.push_back(unknown);
+    hyn::http::HttpResponse::ptr websocket(new hyn::http::HttpResponse);
+    websocket->setStatus(hyn::http::HttpStatus::SWITCHING_PROTOCOLS);
+    websocket->setWebsocket(true);
+    websocket->setHeader("Connection", "Upgrade");
+    websocket->setHeader("Upgrade", "websocket");
+    rsps.push_back(websocket);
+    hyn::http::HttpResponse::ptr large = json_response(2);
+    large->setHeader("X-Large", std::string(1000, 'l'));
+    large->setHeader("connection", "ignored");
+    large->setBody(std::string(123456, 'b'));
+    rsps.push_back(large);
+
+    for (auto &rsp: rsps) {
+        std::string expect = legacy_serialize(*rsp);
+        assert(serialize_string(*rsp) == expect);
+        assert(rsp->toString() == expect);
+        std::string head = "prefix";
+        rsp->dumpHead(head);
+        assert(head == "prefix" + expect.substr(0, expect.size() - rsp->getBody().size()));
+    }
+
+    //date头部，和strftime的结果对比，跨秒时重试
+    for (;;) {
+        time_t now = time(nullptr);
+        char expect[64];
+        struct tm tm{};
+        gmtime_r(&now, &tm);
+        strftime(expect, sizeof(expect), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        std::string_view date = hyn::http::HttpDateNow();
+        auto rsp = json_response(3);
+        rsp->setSendDate(true);
+        std::string str = serialize_string(*rsp);
+        if (time(nullptr) != now) {
+            continue;
+        }
+        assert(date == expect && date.size() == 29);
+        assert(str.find("\r\ndate: " + std::string(date) + "\r\n") != std::string::npos);
+        assert(str.size() == legacy_serialize(*rsp).size() + 37);
+        break;
+    }
+}
+
+/**
+ *@brief 序列化requests次，mode 0:legacy 1:toString 2:serialize到复用的缓冲区
+ */
+void serialize_bench(int mode, bool date, int requests) {
+    auto rsp = json_response(12345);
+    rsp->setSendDate(date);
+    std::vector<char> buff(4096);
+    uint64_t sum = 0;
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < requests; ++i) {
+        if (mode == 0) {
+            sum += legacy_serialize(*rsp).size();
+        } else if (mode == 1) {
+            sum += rsp->toString().size();
+        } else {
+            sum += rsp->serialize(buff.data(), buff.size());
+        }
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    static const char *names[] = {"legacy   ", "toString ", "serialize"};
+    std::cout << names[mode] << (date ? " date" : "     ") << " responses/s: " << requests * 1e6 / cost
+              << " checksum: " << sum << '\n';
+}
+
+void test() {
+    test_serialize_correct();
+    for (int round = 0; round < 2; ++round) {
+        serialize_bench(0, false, 1000000);
+        serialize_bench(1, false, 1000000);
+        serialize_bench(2, false, 1000000);
+        serialize_bench(2, true, 1000000);
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_RESPONSE_SERIALIZE_H
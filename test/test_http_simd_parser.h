@@ -0,0 +1,255 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_simd_parser.h
+  * @author         : hyn
+  * @brief          : SIMD快速路径和ragel解析同一批请求，结果必须完全一样
+  * @attention      : 随机变异的请求大多会交给ragel，统计里simd是快速路径解析完的比例
+  * @date           : 2023/6/10
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_SIMD_PARSER_H
+#define SERVERFRAMEWORK_TEST_HTTP_SIMD_PARSER_H
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/HttpParser.h"
+#include "../src/util.h"
+
+using SimdBackend = hyn::http::HttpRequestParser::Backend;
+
+/**
+ *@brief 解析结果，全部拷成字符串方便比较
+ */
+struct SimdParseResult {
+    int finished = 0;
+    int error = 0;
+    size_t nread = 0;
+    bool simd = false;
+
+    ///回调报告的错误，比如不认识的方法
+    bool callbackError = false;
+    std::string dump;
+
+    //没收完时快速路径不消费数据，nread不用比较；
+    //快速路径要等请求头收完才调用回调，回调报告的错误在这之前发现不了
+    bool operator==(const SimdParseResult &rhs) const {
+        if (error || rhs.error) {
+            const SimdParseResult &err = error ? *this : rhs;
+            const SimdParseResult &other = error ? rhs : *this;
+            return other.error || (err.callbackError && !other.finished);
+        }
+        return finished == rhs.finished && error == rhs.error && (!finished || nread == rhs.nread) &&
+               dump == rhs.dump;
+    }
+};
+
+/**
+ *@brief cut不为0时在cut处断开分两次解析
+ */
+SimdParseResult simd_parse(const std::string &data, SimdBackend backend, size_t cut = 0) {
+    hyn::http::HttpRequestParser parser;
+    parser.setBackend(backend);
+    SimdParseResult result;
+    if (cut) {
+        result.nread = parser.execute(data.data(), cut, 0);
+        if (!parser.isFinished() && !parser.hasError()) {
+            result.nread += parser.execute(data.data(), data.size(), result.nread);
+        }
+    } else {
+        result.nread = parser.execute(data.data(), data.size(), 0);
+    }
+    result.finished = parser.isFinished();
+    result.error = parser.hasError();
+    result.simd = parser.isSimdParsed();
+    result.callbackError = parser.getError() != 0;
+    if (result.finished == 1 && !result.error) {
+        auto req = parser.getData();
+        std::stringstream ss;
+        ss << (int) req->getMethod() << ' ' << (int) req->getVersion() << ' ' << req->getPath() << '|'
+           << req->getQuery() << '|' << req->getFragment() << '\n';
+        for (auto &field: req->getHeaderFields()) {
+            ss << field.name << ':' << field.value << '|' << field.hash << '\n';
+        }
+        result.dump = ss.str();
+    }
+    return result;
+}
+
+/**
+ *@brief 两种实现的结果不一样时打印出请求
+ */
+bool simd_same(const std::string &data, size_t cut = 0) {
+    auto ragel = simd_parse(data, SimdBackend::RAGEL, cut);
+    auto simd = simd_parse(data, SimdBackend::SIMD, cut);
+    if (ragel == simd) {
+        return simd.simd;
+    }
+    std::cout << "mismatch cut=" << cut << " request:\n" << data << "\nragel: " << ragel.finished << ' '
+              << ragel.error << ' ' << ragel.nread << '\n' << ragel.dump << "simd: " << simd.finished << ' '
+              << simd.error << ' ' << simd.nread << '\n' << simd.dump;
+    assert(false);
+    return false;
+}
+
+/**
+ *@brief 常见的请求，快速路径都要能处理
+ */
+std::vector<std::string> simd_corpus() {
+    std::vector<std::string> corpus = {
+            "GET / HTTP/1.1\r\n\r\n",
+            "GET /index.html HTTP/1.0\r\nHost: a\r\n\r\n",
+            "POST /api/v1/items?page=2&size=20 HTTP/1.1\r\nHost: www.example.com\r\n"
+            "Content-Type: application/json\r\nContent-Length: 13\r\n\r\n{\"a\":\"hello\"}",
+            "GET /p? HTTP/1.1\r\nX-Empty:\r\nX-Space:   \r\nX-Trail: v \t\r\n\r\n",
+            "GET /p# HTTP/1.1\r\n\r\n",
+            "GET /a%20b/%E4%BD%A0?q=%2F#frag?x HTTP/1.1\r\nX-Utf8: \xe4\xbd\xa0\xe5\xa5\xbd\r\n\r\n",
+            "DELETE /;a=1/:@!$&'()*+,=~._- HTTP/1.1\r\nX-Tab:\tv\tw\r\n\r\n",
+            "OPTIONS /x HTTP/1.1\r\nAccept: a\r\naccept: b\r\nA!#$%&'*+-.^_`|~z: 1\r\n\r\n",
+    };
+    std::string browser = "GET /static/js/app.5f2c1a.js?v=20230610 HTTP/1.1\r\n"
+                          "Host: www.example.com\r\n"
+                          "Connection: keep-alive\r\n"
+                          "sec-ch-ua: \"Not.A/Brand\";v=\"8\", \"Chromium\";v=\"114\"\r\n"
+                          "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+                          "Chrome/114.0.0.0 Safari/537.36\r\n"
+                          "Accept: */*\r\n"
+                          "Sec-Fetch-Site: same-origin\r\n"
+                          "Referer: https://www.example.com/index.html\r\n"
+                          "Accept-Encoding: gzip, deflate, br\r\n"
+                          "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+                          "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n\r\n";
+    corpus.push_back(browser);
+    std::string many = "GET /many HTTP/1.1\r\n";
+    for (int i = 0; i < 64; ++i) {
+        many += "X-H" + std::to_string(i) + ": " + std::string(i, 'v') + "\r\n";
+    }
+    corpus.push_back(many + "\r\n");
+    return corpus;
+}
+
+/**
+ *@brief 不常见或者错误的格式，交给ragel
+ */
+std::vector<std::string> simd_fallback_corpus() {
+    std::string many = "GET /many HTTP/1.1\r\n";
+    for (int i = 0; i < 65; ++i) {
+        many += "X-H" + std::to_string(i) + ": v\r\n";
+    }
+    return {
+            many + "\r\n",
+            "GET /a HTTP/1.1\nHost: a\n\n",
+            "GET /a HTTP/1.1\r\nHost: a\r\n continue\r\n\r\n",
+            "GET http://h/p?q HTTP/1.1\r\n\r\n",
+            "GET //h/p HTTP/1.1\r\n\r\n",
+            "GET * HTTP/1.1\r\n\r\n",
+            "GET /%2 HTTP/1.1\r\n\r\n",
+            "GET /a HTTP/2.0\r\n\r\n",
+            "GET /a b HTTP/1.1\r\n\r\n",
+            "get /a HTTP/1.1\r\n\r\n",
+            "GET /a HTTP/1.1\r\nBad Name: v\r\n\r\n",
+            "GET /a HTTP/1.1\r\n: v\r\n\r\n",
+            "GET /a HTTP/1.1\r\nX: a\rb\r\n\r\n",
+            "GET /a HTTP/1.1\r\nX: a\x01\r\n\r\n",
+            "GET /a HTTP/1.1\r\n\r\r\n",
+            "GET /{a} HTTP/1.1\r\n\r\n",
+            "ABCDEFGHIJKLMNOPQRSTU /a HTTP/1.1\r\n\r\n",
+    };
+}
+
+void test_simd_correct() {
+    std::cout << "simd implementation: " << hyn::http::simd::Implementation() << '\n';
+    for (auto &req: simd_corpus()) {
+        //常见格式必须走快速路径，在任意位置断开结果都一样
+        assert(simd_same(req));
+        for (size_t cut = 1; cut < req.size(); ++cut) {
+            simd_same(req, cut);
+        }
+        //后面跟着下一个请求
+        simd_same(req + req);
+    }
+    for (auto &req: simd_fallback_corpus()) {
+        assert(!simd_same(req));
+        for (size_t cut = 1; cut < req.size(); ++cut) {
+            simd_same(req, cut);
+        }
+    }
+
+    //随机变异：插入、删除、替换容易出问题的字符
+    const std::string alphabet = std::string(" \t\r\n:/?#%@;=,\"{}\x7f\x80\xff\x01", 21) + "aZ09-";
+    std::vector<std::string> seeds = simd_corpus();
+    std::mt19937 rng(20230610);
+    size_t total = 0, fast = 0;
+    for (int round = 0; round < 200000; ++round) {
+        std::string req = seeds[rng() % seeds.size()];
+        int mutations = 1 + rng() % 3;
+        for (int m = 0; m < mutations; ++m) {
+            size_t pos = rng() % req.size();
+            char c = (rng() % 4) ? alphabet[rng() % alphabet.size()] : (char) (rng() & 0xff);
+            switch (rng() % 4) {
+                case 0:
+                    req.insert(req.begin() + (long) pos, c);
+                    break;
+                case 1:
+                    req.erase(pos, 1);
+                    break;
+                case 2:
+                    req[pos] = c;
+                    break;
+                default:
+                    //复制一段，制造很长的token和很多头部
+                    req.insert(pos, req.substr(rng() % req.size(), rng() % 200));
+                    break;
+            }
+            if (req.empty()) {
+                req = "G";
+            }
+        }
+        ++total;
+        fast += simd_same(req);
+        if (round % 64 == 0) {
+            simd_same(req, 1 + rng() % req.size());
+        }
+    }
+    std::cout << "fuzz requests: " << total << " simd parsed: " << fast << '\n';
+}
+
+/**
+ *@brief 解析requests次req，请求对象不拷贝头部
+ */
+void simd_bench(const char *name, const std::string &req, SimdBackend backend, int requests) {
+    hyn::http::HttpRequestParser parser;
+    parser.setBackend(backend);
+    uint64_t sum = 0;
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < requests; ++i) {
+        parser.reset();
+        sum += parser.execute(req.data(), req.size(), 0);
+        assert(parser.isFinished() == 1 && !parser.hasError());
+        sum += parser.getData()->getHeaderFields().size();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << name << (backend == SimdBackend::SIMD ? " simd  " : " ragel ") << "requests/s: "
+              << requests * 1e6 / cost << " MB/s: " << (double) req.size() * requests / cost
+              << " checksum: " << sum << '\n';
+}
+
+void test() {
+    test_simd_correct();
+    auto corpus = simd_corpus();
+    for (int round = 0; round < 2; ++round) {
+        for (auto backend: {SimdBackend::RAGEL, SimdBackend::SIMD}) {
+            simd_bench("small  ", corpus[1], backend, 1000000);
+            simd_bench("browser", corpus[corpus.size() - 2], backend, 500000);
+            simd_bench("64 hdrs", corpus.back(), backend, 100000);
+        }
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_SIMD_PARSER_H
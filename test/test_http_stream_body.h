@@ -0,0 +1,330 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_stream_body.h
+  * @author         : hyn
+  * @brief          : 请求消息体按需从连接上读，响应消息体用chunked边生成边发，内存不随消息体增长
+  * @attention      : 走127.0.0.1；legacy是改之前的写法：消息体整个放进std::string；
+  *                   峰值内存看ru_maxrss，所以先跑流式的再跑legacy
+  * @date           : 2023/6/9
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_STREAM_BODY_H
+#define SERVERFRAMEWORK_TEST_HTTP_STREAM_BODY_H
+
+#include <cassert>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+#include "../src/Address.h"
+#include "../src/HttpSession.h"
+#include "../src/IOManager.h"
+#include "../src/Socket.h"
+#include "../src/util.h"
+#include "tcp_pair.h"
+
+static const char *g_stream_body_file = "/tmp/hyn_stream_body.dat";
+
+/**
+ *@brief 消息体第i个字节的内容
+ */
+static char stream_body_byte(uint64_t i) {
+    return static_cast<char>('a' + (i * 7 + (i >> 12)) % 26);
+}
+
+static long max_rss_mb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss >> 10;
+}
+
+/**
+ *@brief 读到对方关闭为止
+ */
+std::string stream_read_all(const hyn::SocketStream::ptr &stream) {
+    std::string out;
+    char buff[16384];
+    for (;;) {
+        int n = stream->read(buff, sizeof(buff));
+        if (n <= 0) {
+            return out;
+        }
+        out.append(buff, n);
+    }
+}
+
+/**
+ *@brief 把chunked编码的消息体解出来，返回用掉的长度
+ */
+size_t stream_dechunk(const std::string &data, size_t pos, std::string &body) {
+    for (;;) {
+        size_t eol = data.find("\r\n", pos);
+        assert(eol != std::string::npos);
+        size_t size = std::stoul(data.substr(pos, eol - pos), nullptr, 16);
+        pos = eol + 2;
+        if (!size) {
+            assert(data.compare(pos, 2, "\r\n") == 0);
+            return pos + 2;
+        }
+        body.append(data, pos, size);
+        pos += size;
+        assert(data.compare(pos, 2, "\r\n") == 0);
+        pos += 2;
+    }
+}
+
+void test_stream_request() {
+    //chunked上传：块长度各不相同，带扩展和trailer，任意切开，后面跟着pipeline的请求
+    for (size_t cut: {1, 5, 64, 1 << 20}) {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        std::string expect;
+        std::string data = "POST /upload HTTP/1.1\r\nHost: h\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (size_t size: {1, 15, 16, 255, 4096, 5000, 70000}) {
+            char head[32];
+            snprintf(head, sizeof(head), size % 2 ? "%zx;name=v\r\n" : "%zX\r\n", size);
+            data += head;
+            for (size_t i = 0; i < size; ++i) {
+                expect += stream_body_byte(expect.size());
+            }
+            data.append(expect, expect.size() - size, size).append("\r\n");
+        }
+        data += "0\r\nX-Trailer: t\r\n\r\nGET /next HTTP/1.1\r\nHost: h\r\n\r\n";
+        hyn::iomanager::IOManager::GetThis()->schedule([client = client, data, cut] {
+            for (size_t i = 0; i < data.size(); i += cut) {
+                size_t n = std::min(cut, data.size() - i);
+                assert(client->writeFixSize(data.data() + i, n) == (int) n);
+            }
+        });
+        auto req = session->recvRequest();
+        assert(req && req->getBody().empty() && req->getBodyStream());
+        std::string got;
+        char buff[3000];
+        for (int n; (n = req->getBodyStream()->read(buff, sizeof(buff))) > 0;) {
+            got.append(buff, n);
+        }
+        assert(got == expect);
+        assert(req->getBodyStream()->read(buff, sizeof(buff)) == 0);
+        auto next = session->recvRequest();
+        assert(next && next->getPath() == "/next" && !next->getBodyStream());
+    }
+
+    //小的消息体还是读进getBody()，大的没读完时在下一个请求之前丢掉
+    {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        std::string small(100, 's');
+        std::string big(1 << 20, 'b');
+        std::string data = "POST /small HTTP/1.1\r\nContent-Length: 100\r\n\r\n" + small +
+                           "POST /big HTTP/1.1\r\nContent-Length: " + std::to_string(big.size()) + "\r\n\r\n" + big +
+                           "GET /after HTTP/1.1\r\n\r\n";
+        hyn::iomanager::IOManager::GetThis()->schedule([client = client, data] {
+            assert(client->writeFixSize(data.data(), data.size()) == (int) data.size());
+        });
+        auto req = session->recvRequest();
+        assert(req->getBody() == small && !req->getBodyStream());
+        req = session->recvRequest();
+        assert(req->getBody().empty() && req->getBodyStream());
+        std::string head(1000, 0);
+        assert(req->getBodyStream()->readFixSize(&head[0], head.size()) == (int) head.size());
+        assert(head == big.substr(0, 1000));
+        auto after = session->recvRequest();
+        assert(after && after->getPath() == "/after");
+        //剩下的部分已经被丢掉了
+        assert(req->getBodyStream()->read(&head[0], head.size()) == 0);
+    }
+
+    //格式错误的块
+    {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        std::string data = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n";
+        assert(client->writeFixSize(data.data(), data.size()) == (int) data.size());
+        auto req = session->recvRequest();
+        char buff[16];
+        assert(req->getBodyStream()->read(buff, sizeof(buff)) == 3);
+        assert(req->getBodyStream()->read(buff, sizeof(buff)) < 0);
+    }
+}
+
+void test_stream_response() {
+    int fd = open(g_stream_body_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    std::string file(100000, 0);
+    for (size_t i = 0; i < file.size(); ++i) {
+        file[i] = stream_body_byte(i);
+    }
+    assert(write(fd, file.data(), file.size()) == (ssize_t) file.size());
+
+    //chunked：各种写法混在一起，前面还有一个攒着的普通响应
+    {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        hyn::http::HttpResponse::ptr first(new hyn::http::HttpResponse(0x11, false));
+        first->setBody("first");
+        session->queueResponse(first);
+        hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, true));
+        auto writer = session->beginResponse(rsp);
+        assert(writer && writer->isChunked() && session->getPendingResponses() == 0);
+        std::string expect = "hello ";
+        assert(writer->write("hello ", 6) == 6);
+        assert(writer->write("", 0) == 0);
+        hyn::ByteArray::ptr ba(new hyn::ByteArray(7));
+        ba->writeStringWithoutLength("from bytearray ");
+        ba->setPos(0);
+        expect += "from bytearray ";
+        assert(writer->write(ba, ba->getReadSize()) == 15);
+        assert(writer->sendFile(fd, 10, 50000) == 50000);
+        expect += file.substr(10, 50000);
+        std::string big(300000, 'z');
+        assert(writer->writeFixSize(big.data(), big.size()) == (int) big.size());
+        expect += big;
+        session->queueResponse(rsp);
+        assert(writer->write("late", 4) < 0);
+        session->close();
+
+        std::string data = stream_read_all(client);
+        std::string head = first->toString();
+        assert(data.compare(0, head.size(), head) == 0);
+        size_t pos = data.find("\r\n\r\n", head.size());
+        std::string rsp_head = data.substr(head.size(), pos + 4 - head.size());
+        assert(rsp_head.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+        assert(rsp_head.find("content-length") == std::string::npos);
+        std::string body;
+        assert(stream_dechunk(data, pos + 4, body) == data.size());
+        assert(body == expect);
+    }
+
+    //事先设置的消息体作为第一段发出去，头部里不能再出现它的content-length
+    for (uint8_t version: {0x11, 0x10}) {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(version, false));
+        rsp->setBody("preset ");
+        auto writer = session->beginResponse(rsp);
+        assert(writer && writer->isChunked() == (version == 0x11) && rsp->getBody().empty());
+        assert(writer->write("tail", 4) == 4);
+        session->queueResponse(rsp);
+        session->close();
+        std::string data = stream_read_all(client);
+        size_t pos = data.find("\r\n\r\n");
+        assert(data.find("content-length") > pos);
+        std::string body;
+        if (version == 0x11) {
+            assert(stream_dechunk(data, pos + 4, body) == data.size());
+        } else {
+            body = data.substr(pos + 4);
+        }
+        assert(body == "preset tail");
+    }
+
+    //知道长度时不分块；HTTP/1.0不分块，写完关闭连接
+    for (uint8_t version: {0x11, 0x10}) {
+        auto [client, session] = tcp_pair<hyn::HttpSession>();
+        hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(version, false));
+        if (version == 0x11) {
+            rsp->setHeader("content-length", "50000");
+        }
+        auto writer = session->beginResponse(rsp);
+        assert(!writer->isChunked() && rsp->isAutoClose() == (version == 0x10));
+        assert(writer->sendFile(fd, 0, 50000) == 50000);
+        session->queueResponse(rsp);
+        session->close();
+        std::string data = stream_read_all(client);
+        size_t pos = data.find("\r\n\r\n");
+        assert(data.substr(pos + 4) == file.substr(0, 50000));
+    }
+    close(fd);
+    unlink(g_stream_body_file);
+}
+
+/**
+ *@brief 上传size字节，legacy为true时像改之前一样整个读进std::string
+ */
+void upload_bench(bool legacy, uint64_t size) {
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, size] {
+        std::string head = "POST /upload HTTP/1.1\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+        assert(client->writeFixSize(head.data(), head.size()) == (int) head.size());
+        std::vector<char> chunk(1 << 16);
+        for (uint64_t done = 0; done < size; done += chunk.size()) {
+            for (size_t i = 0; i < chunk.size(); ++i) {
+                chunk[i] = stream_body_byte(done + i);
+            }
+            assert(client->writeFixSize(chunk.data(), chunk.size()) == (int) chunk.size());
+        }
+    });
+    uint64_t begin = hyn::util::GetCurrentUS();
+    auto req = session->recvRequest();
+    uint64_t sum = 0;
+    if (legacy) {
+        std::string body(size, 0);
+        assert(req->getBodyStream()->readFixSize(&body[0], body.size()) == (int) body.size());
+        for (size_t i = 0; i < body.size(); i += 4096) {
+            sum += body[i];
+        }
+    } else {
+        std::vector<char> buff(1 << 16);
+        uint64_t done = 0;
+        for (int n; (n = req->getBodyStream()->read(buff.data(), buff.size())) > 0; done += n) {
+            for (int i = 0; i < n; i += 4096) {
+                sum += buff[i];
+            }
+        }
+        assert(done == size);
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << (legacy ? "legacy " : "stream ") << "upload MB/s: " << size / 1.048576 / cost
+              << " max rss MB: " << max_rss_mb() << " checksum: " << sum << '\n';
+}
+
+/**
+ *@brief 下载size字节，legacy为true时像改之前一样先拼好整个消息体再发送
+ */
+void download_bench(bool legacy, uint64_t size) {
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, size] {
+        std::vector<char> buff(1 << 18);
+        uint64_t total = 0;
+        for (int n; (n = client->read(buff.data(), buff.size())) > 0;) {
+            total += n;
+        }
+        assert(total > size);
+    });
+    uint64_t begin = hyn::util::GetCurrentUS();
+    hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, true));
+    std::vector<char> chunk(1 << 16);
+    if (legacy) {
+        std::string body;
+        for (uint64_t done = 0; done < size; done += chunk.size()) {
+            body.append(chunk.data(), chunk.size());
+        }
+        rsp->setBody(body);
+        session->sendResponse(rsp);
+    } else {
+        auto writer = session->beginResponse(rsp);
+        for (uint64_t done = 0; done < size; done += chunk.size()) {
+            assert(writer->write(chunk.data(), chunk.size()) == (int) chunk.size());
+        }
+        session->sendResponse(rsp);
+    }
+    session->close();
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << (legacy ? "legacy " : "stream ") << "download MB/s: " << size / 1.048576 / cost
+              << " max rss MB: " << max_rss_mb() << '\n';
+}
+
+void test() {
+    hyn::iomanager::IOManager iom(1, true, "stream");
+    iom.schedule([] {
+        test_stream_request();
+        test_stream_response();
+        const uint64_t size = 512ull << 20;
+        std::cout << "max rss MB before: " << max_rss_mb() << '\n';
+        upload_bench(false, size);
+        download_bench(false, size);
+        upload_bench(true, size);
+        download_bench(true, size);
+    });
+    iom.stop();
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_STREAM_BODY_H
@@ -0,0 +1,121 @@
+/**
+  ******************************************************************************
+  * @file           : test_http_writev.h
+  * @author         : hyn
+  * @brief          : HttpSession::sendResponse用writev发送，和原来拼字符串再发送对比
+  * @attention      : legacy是改之前的写法：stringstream拼toString，再拷贝一次后writeFixSize
+  * @date           : 2023/6/6
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_HTTP_WRITEV_H
+#define SERVERFRAMEWORK_TEST_HTTP_WRITEV_H
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "../src/Address.h"
+#include "../src/HttpSession.h"
+#include "../src/IOManager.h"
+#include "../src/Socket.h"
+#include "../src/util.h"
+#include "tcp_pair.h"
+
+void test_writev_fix_size() {
+    //小的发送缓冲区，writev一定会部分写入
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    int size = 4096;
+    session->getSocket()->setOption(SOL_SOCKET, SO_SNDBUF, size);
+    std::vector<std::string> parts;
+    std::string expect;
+    for (int i = 0; i < 64; ++i) {
+        parts.emplace_back(i * 1000 + (i % 3 ? 17 : 0), (char) ('a' + i % 26));
+        expect += parts.back();
+    }
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, expect] {
+        std::string got(expect.size(), 0);
+        assert(client->readFixSize(&got[0], got.size()) == (int) got.size());
+        assert(got == expect);
+    });
+    std::vector<iovec> iovs;
+    for (auto &p: parts) {
+        iovs.push_back({p.data(), p.size()});
+    }
+    assert(session->writeFixSize(iovs.data(), (int) iovs.size()) == (int64_t) expect.size());
+}
+
+void test_send_response() {
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    std::vector<hyn::http::HttpResponse::ptr> rsps;
+    std::string expect;
+    for (size_t body: {0, 1, 100000}) {
+        hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, false));
+        rsp->setHeader("Content-Type", "text/plain");
+        rsp->setBody(std::string(body, 'x'));
+        rsps.push_back(rsp);
+        expect += rsp->toString();
+    }
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, expect] {
+        std::string got(expect.size(), 0);
+        assert(client->readFixSize(&got[0], got.size()) == (int) got.size());
+        assert(got == expect);
+    });
+    for (auto &rsp: rsps) {
+        assert(session->sendResponse(rsp) > 0);
+    }
+}
+
+/**
+ *@brief 发rounds个消息体大小为body的响应，客户端只负责读
+ */
+void response_bench(bool legacy, size_t body, int rounds) {
+    auto [client, session] = tcp_pair<hyn::HttpSession>();
+    hyn::http::HttpResponse::ptr rsp(new hyn::http::HttpResponse(0x11, false));
+    rsp->setHeader("Content-Type", "application/octet-stream");
+    rsp->setBody(std::string(body, 'x'));
+    size_t total = rsp->toString().size() * rounds;
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, total] {
+        std::vector<char> buff(256 * 1024);
+        for (size_t done = 0; done < total;) {
+            int n = client->read(buff.data(), std::min(buff.size(), total - done));
+            assert(n > 0);
+            done += n;
+        }
+    });
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < rounds; ++i) {
+        if (legacy) {
+            std::stringstream ss;
+            ss << rsp->toString();
+            std::string data = ss.str();
+            assert(session->writeFixSize(data.c_str(), data.size()) > 0);
+        } else {
+            assert(session->sendResponse(rsp) > 0);
+        }
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << (legacy ? "legacy " : "writev ") << "body: " << body << " responses/s: " << rounds * 1e6 / cost
+              << " MB/s: " << total / 1.048576 / cost << '\n';
+}
+
+void test() {
+    hyn::iomanager::IOManager iom(1, true, "writev");
+    iom.schedule([] {
+        test_writev_fix_size();
+        test_send_response();
+        for (int round = 0; round < 2; ++round) {
+            response_bench(true, 1 << 10, 20000);
+            response_bench(false, 1 << 10, 20000);
+            response_bench(true, 1 << 20, 200);
+            response_bench(false, 1 << 20, 200);
+            response_bench(true, 16 << 20, 20);
+            response_bench(false, 16 << 20, 20);
+        }
+    });
+    iom.stop();
+}
+
+#endif //SERVERFRAMEWORK_TEST_HTTP_WRITEV_H
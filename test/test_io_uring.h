@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file           : test_io_uring.h
+  * @author         : hyn
+  * @brief          : epoll和io_uring两种IO路径每次请求的系统调用次数
+  * @attention      : 统计的是IOManager自己的epoll_ctl、epoll_wait、io_uring_enter，
+  *                   不包括每次请求先尝试的那一次read/write
+  * @date           : 2023/5/26
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_IO_URING_H
+#define SERVERFRAMEWORK_TEST_IO_URING_H
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include <sys/socket.h>
+#include "../src/FDManger.h"
+#include "../src/IOManager.h"
+#include "../src/Logger.h"
+#include "../src/util.h"
+
+/**
+ *@brief pairs对socketpair来回收发rounds次，每次读都要等对端写，输出吞吐和每次往返的系统调用次数
+ */
+void io_uring_bench(bool uring, int pairs, int rounds) {
+    std::atomic<int> done{0};
+    hyn::iomanager::IOManager::IoStats stats{};
+    uint64_t begin = hyn::util::GetCurrentUS();
+    {
+        hyn::iomanager::IOManager iom(2, false, "uring");
+        if (uring && !iom.setIoUring(true)) {
+            std::cout << "io_uring not supported\n";
+            return;
+        }
+        for (int p = 0; p < pairs; ++p) {
+            int sv[2];
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+            iom.schedule([sv, rounds]() {
+                hyn::FdMgr::GetInstance()->get(sv[0], true);
+                char buf[8];
+                for (int r = 0; r < rounds; ++r) {
+                    if (read(sv[0], buf, sizeof(buf)) <= 0 || write(sv[0], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                }
+                close(sv[0]);
+            });
+            iom.schedule([sv, rounds, &done]() {
+                hyn::FdMgr::GetInstance()->get(sv[1], true);
+                char buf[8] = "ping";
+                for (int r = 0; r < rounds; ++r) {
+                    if (write(sv[1], buf, sizeof(buf)) <= 0 || read(sv[1], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                    ++done;
+                }
+                close(sv[1]);
+            });
+        }
+        while (done < pairs * rounds) {
+            usleep(1000);
+        }
+        stats = iom.getIoStats();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    double trips = done ? done.load() : 1;
+    std::cout << (uring ? "io_uring" : "epoll   ") << " round trips/sec: " << done * 1e6 / (cost ? cost : 1)
+              << " epoll_ctl/trip: " << stats.epollCtl / trips << " epoll_wait/trip: " << stats.epollWait / trips
+              << " io_uring_enter/trip: " << stats.uringEnter / trips
+              << " total/trip: " << (stats.epollCtl + stats.epollWait + stats.uringEnter) / trips << '\n';
+}
+
+/**
+ *@brief 读的长度超过32位时按UINT32_MAX提交，不能被截成0当作EOF返回
+ */
+void io_uring_large_count() {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    std::atomic<ssize_t> n{-2};
+    {
+        hyn::iomanager::IOManager iom(1, false, "uring_large");
+        if (!iom.setIoUring(true)) {
+            std::cout << "io_uring not supported\n";
+            close(sv[0]);
+            close(sv[1]);
+            return;
+        }
+        iom.schedule([sv, &n]() {
+            hyn::FdMgr::GetInstance()->get(sv[0], true);
+            //堆上的小缓冲区，内核只写入实际到达的数据
+            std::vector<char> buf(16);
+            n = read(sv[0], buf.data(), 1ull << 32);
+        });
+        usleep(10 * 1000);
+        ssize_t rt = write(sv[1], "hello", 5);
+        assert(rt == 5);
+        while (n == -2) {
+            usleep(1000);
+        }
+    }
+    assert(n == 5);
+    hyn::FdMgr::GetInstance()->del(sv[0]);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    io_uring_large_count();
+    io_uring_bench(false, 100, 500);
+    io_uring_bench(true, 100, 500);
+}
+
+#endif //SERVERFRAMEWORK_TEST_IO_URING_H
@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file           : test_mmap_bytearray.h
+  * @author         : hyn
+  * @brief          : 文件映射成ByteArray，和readFromFile对比加载时间
+  * @attention      : 会在/tmp下写一个256MB的文件，结束时删除
+  * @date           : 2023/6/4
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_MMAP_BYTEARRAY_H
+#define SERVERFRAMEWORK_TEST_MMAP_BYTEARRAY_H
+
+#include <cassert>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#include "../src/ByteArray.h"
+#include "../src/util.h"
+
+static const char *g_mmap_file = "/tmp/hyn_mmap_test.dat";
+static const char *g_mmap_copy = "/tmp/hyn_mmap_copy.dat";
+
+/**
+ *@brief 第i个8字节是i，大端
+ */
+void make_mmap_file(size_t size) {
+    int fd = open(g_mmap_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::vector<uint64_t> chunk(1 << 17);
+    for (size_t off = 0; off < size; off += chunk.size() * 8) {
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            chunk[i] = byteswapOnLittleEndian<uint64_t>(off / 8 + i);
+        }
+        assert(write(fd, chunk.data(), chunk.size() * 8) == (ssize_t) (chunk.size() * 8));
+    }
+    close(fd);
+}
+
+void test_mmap_read(size_t size) {
+    hyn::ByteArray::ptr ba(new hyn::ByteArray);
+    ba->writeStringWithoutLength("old data");
+    assert(ba->mapFile(g_mmap_file));
+    assert(ba->getPos() == 0 && ba->getReadSize() == size);
+    assert(ba->readFuint64() == 0);
+    ba->setPos(size - 8);
+    assert(ba->readFuint64() == size / 8 - 1);
+
+    //读出来的内存块就是映射的页，可以直接writev
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs, 64, 4096);
+    assert(iovs.size() == 1 && iovs[0].iov_len == 64);
+
+    //也可以拿到文件fd直接sendfile
+    off_t offset;
+    int fd = ba->getMappedFile(4096, offset);
+    assert(fd >= 0 && offset == 4096);
+    int out = open(g_mmap_copy, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(sendfile(out, fd, &offset, 64) == 64);
+    close(out);
+    hyn::ByteArray::ptr copy(new hyn::ByteArray);
+    assert(copy->readFromFile(g_mmap_copy));
+    copy->setPos(0);
+    assert(copy->getReadSize() == 64 && copy->readFuint64() == 4096 / 8);
+
+    //切片引用映射，ByteArray释放后仍然有效
+    auto part = ba->slice(16, size / 2);
+    assert(part->getMappedFile(8, offset) == fd && offset == (off_t) (size / 2 + 8));
+    ba.reset();
+    assert(part->readFuint64() == size / 16);
+
+    //MAP_PRIVATE写入不会改到文件
+    hyn::ByteArray::ptr priv(new hyn::ByteArray);
+    assert(priv->mapFile(g_mmap_file));
+    priv->writeFuint64(0xdeadbeef);
+    hyn::ByteArray::ptr check(new hyn::ByteArray);
+    assert(check->mapFile(g_mmap_file));
+    assert(check->readFuint64() == 0);
+
+    //写超过文件大小的部分接在普通内存块上
+    priv->setPos(size);
+    priv->writeFuint32(7);
+    assert(priv->getSize() == size + 4 && priv->getMappedFile(size, offset) == -1);
+    priv->setPos(size);
+    assert(priv->readFuint32() == 7);
+}
+
+void test_mmap_write() {
+    unlink(g_mmap_copy);
+    {
+        hyn::ByteArray::ptr ba(new hyn::ByteArray);
+        assert(ba->mapFile(g_mmap_copy, true, 1 << 20));
+        assert(ba->getSize() == (1 << 20));
+        ba->writeStringF32("snapshot");
+        ba->writeFixedArray(std::vector<uint32_t>(1000, 42).data(), 1000);
+    }
+    hyn::ByteArray::ptr ba(new hyn::ByteArray);
+    assert(ba->readFromFile(g_mmap_copy));
+    ba->setPos(0);
+    assert(ba->getReadSize() == (1 << 20));
+    assert(ba->readStringF32() == "snapshot");
+    std::vector<uint32_t> values(1000);
+    ba->readFixedArray(values.data(), values.size());
+    assert(values == std::vector<uint32_t>(1000, 42));
+
+    //空文件映射成空的ByteArray
+    truncate(g_mmap_copy, 0);
+    assert(ba->mapFile(g_mmap_copy));
+    assert(ba->getSize() == 0 && ba->getReadSize() == 0);
+    ba->writeFuint8(1);
+    assert(ba->getSize() == 1);
+    assert(!ba->mapFile("/tmp/hyn_mmap_not_exist/x"));
+}
+
+void mmap_bench(size_t size) {
+    for (int round = 0; round < 2; ++round) {
+        hyn::ByteArray::ptr ba(new hyn::ByteArray);
+        uint64_t begin = hyn::util::GetCurrentUS();
+        assert(ba->readFromFile(g_mmap_file));
+        uint64_t read_cost = hyn::util::GetCurrentUS() - begin;
+        assert(ba->getSize() == size);
+
+        hyn::ByteArray::ptr mapped(new hyn::ByteArray);
+        begin = hyn::util::GetCurrentUS();
+        assert(mapped->mapFile(g_mmap_file));
+        uint64_t map_cost = hyn::util::GetCurrentUS() - begin;
+
+        //第一次访问时才缺页，把整个文件读一遍
+        uint64_t sum = 0;
+        begin = hyn::util::GetCurrentUS();
+        std::vector<iovec> iovs;
+        mapped->getReadBuffers(iovs);
+        for (auto &iov: iovs) {
+            for (size_t i = 0; i < iov.iov_len; i += 4096) {
+                sum += static_cast<char *>(iov.iov_base)[i];
+            }
+        }
+        uint64_t touch_cost = hyn::util::GetCurrentUS() - begin;
+        std::cout << "size: " << (size >> 20) << "MB readFromFile us: " << read_cost << " mapFile us: " << map_cost
+                  << " touch all pages us: " << touch_cost << " checksum: " << sum << '\n';
+    }
+}
+
+void test() {
+    const size_t size = 256 << 20;
+    make_mmap_file(size);
+    test_mmap_read(size);
+    test_mmap_write();
+    mmap_bench(size);
+    unlink(g_mmap_file);
+    unlink(g_mmap_copy);
+}
+
+#endif //SERVERFRAMEWORK_TEST_MMAP_BYTEARRAY_H
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file           : test_multi_reactor.h
+  * @author         : hyn
+  * @brief          : 共享epoll和多reactor模式的对比
+  * @attention      : None
+  * @date           : 2023/5/25
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_MULTI_REACTOR_H
+#define SERVERFRAMEWORK_TEST_MULTI_REACTOR_H
+
+#include <atomic>
+#include <iostream>
+#include <sys/socket.h>
+#include "../src/FDManger.h"
+#include "../src/IOManager.h"
+#include "../src/Logger.h"
+#include "../src/util.h"
+
+/**
+ *@brief pairs对socketpair来回收发rounds次，返回每秒完成的往返次数
+ */
+double multi_reactor_bench(size_t threads, bool multi, int pairs, int rounds) {
+    std::atomic<int> done{0};
+    uint64_t begin = hyn::util::GetCurrentUS();
+    {
+        hyn::iomanager::IOManager iom(threads, false, "reactor");
+        iom.setMultiReactor(multi);
+        for (int p = 0; p < pairs; ++p) {
+            int sv[2];
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+            //一对连接放在同一个reactor上
+            int thread = iom.nextReactorThread();
+            iom.schedule([sv, rounds]() {
+                hyn::FdMgr::GetInstance()->get(sv[0], true);
+                char buf[8];
+                for (int r = 0; r < rounds; ++r) {
+                    if (read(sv[0], buf, sizeof(buf)) <= 0 || write(sv[0], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                }
+                close(sv[0]);
+            }, thread);
+            iom.schedule([sv, rounds, &done]() {
+                hyn::FdMgr::GetInstance()->get(sv[1], true);
+                char buf[8] = "ping";
+                for (int r = 0; r < rounds; ++r) {
+                    if (write(sv[1], buf, sizeof(buf)) <= 0 || read(sv[1], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                    ++done;
+                }
+                close(sv[1]);
+            }, thread);
+        }
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    return done * 1e6 / (cost ? cost : 1);
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    for (size_t threads: {2, 4}) {
+        std::cout << "threads: " << threads
+                  << " shared epoll round trips/sec: " << multi_reactor_bench(threads, false, 200, 500)
+                  << " multi reactor round trips/sec: " << multi_reactor_bench(threads, true, 200, 500) << '\n';
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_MULTI_REACTOR_H
@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file           : test_persistent_events.h
+  * @author         : hyn
+  * @brief          : 每次注册和常驻注册两种模式下每次请求的epoll_ctl次数
+  * @attention      : 常驻注册模式下每个fd只在第一次等待和close时各调用一次epoll_ctl
+  * @date           : 2023/5/30
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_PERSISTENT_EVENTS_H
+#define SERVERFRAMEWORK_TEST_PERSISTENT_EVENTS_H
+
+#include <atomic>
+#include <iostream>
+#include <sys/socket.h>
+#include "../src/FDManger.h"
+#include "../src/IOManager.h"
+#include "../src/Logger.h"
+#include "../src/util.h"
+
+/**
+ *@brief pairs对socketpair来回收发rounds次，每次读都要等对端写，输出吞吐和每次往返的epoll_ctl次数
+ */
+void persistent_events_bench(bool persistent, bool multi, int pairs, int rounds) {
+    std::atomic<int> done{0};
+    hyn::iomanager::IOManager::IoStats stats{};
+    uint64_t begin = hyn::util::GetCurrentUS();
+    {
+        hyn::iomanager::IOManager iom(2, false, "persistent");
+        iom.setPersistentEvents(persistent);
+        iom.setMultiReactor(multi);
+        for (int p = 0; p < pairs; ++p) {
+            int sv[2];
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+            iom.schedule([sv, rounds]() {
+                hyn::FdMgr::GetInstance()->get(sv[0], true);
+                char buf[8];
+                for (int r = 0; r < rounds; ++r) {
+                    if (read(sv[0], buf, sizeof(buf)) <= 0 || write(sv[0], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                }
+                close(sv[0]);
+            });
+            iom.schedule([sv, rounds, &done]() {
+                hyn::FdMgr::GetInstance()->get(sv[1], true);
+                char buf[8] = "ping";
+                for (int r = 0; r < rounds; ++r) {
+                    if (write(sv[1], buf, sizeof(buf)) <= 0 || read(sv[1], buf, sizeof(buf)) <= 0) {
+                        break;
+                    }
+                    ++done;
+                }
+                close(sv[1]);
+            });
+        }
+        while (done < pairs * rounds) {
+            usleep(1000);
+        }
+        stats = iom.getIoStats();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    double trips = done ? done.load() : 1;
+    std::cout << (persistent ? "persistent" : "one-shot  ") << (multi ? " multi reactor" : "")
+              << " round trips/sec: " << done * 1e6 / (cost ? cost : 1)
+              << " epoll_ctl/trip: " << stats.epollCtl / trips << " epoll_wait/trip: " << stats.epollWait / trips
+              << '\n';
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    persistent_events_bench(false, false, 100, 500);
+    persistent_events_bench(true, false, 100, 500);
+    persistent_events_bench(true, true, 100, 500);
+}
+
+#endif //SERVERFRAMEWORK_TEST_PERSISTENT_EVENTS_H
@@ -0,0 +1,153 @@
+/**
+  ******************************************************************************
+  * @file           : test_scheduler_scaling.h
+  * @author         : hyn
+  * @brief          : 调度器多线程扩展性测试
+  * @attention      : None
+  * @date           : 2023/5/22
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_SCHEDULER_SCALING_H
+#define SERVERFRAMEWORK_TEST_SCHEDULER_SCALING_H
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../src/Logger.h"
+#include "../src/Scheduler.h"
+#include "../src/WorkStealingQueue.h"
+#include "../src/util.h"
+
+static std::atomic<uint64_t> s_scaling_done{0};
+
+/**
+ *@brief 每个任务做一点计算，再在调度线程里派生子任务，形成一棵任务树
+ */
+void scaling_task(int depth) {
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 200; ++i) {
+        sum += i * depth;
+    }
+    if (depth > 0) {
+        auto *sc = hyn::scheduler::Scheduler::GetThis();
+        for (int i = 0; i < 4; ++i) {
+            sc->schedule([depth]() { scaling_task(depth - 1); });
+        }
+    }
+    ++s_scaling_done;
+}
+
+/**
+ *@brief 返回每秒完成的任务数
+ */
+double scheduler_scaling_bench(size_t threads, int roots, int depth) {
+    //4叉树的节点数
+    uint64_t per_root = ((1ull << (2 * (depth + 1))) - 1) / 3;
+    uint64_t total = per_root * roots;
+    s_scaling_done = 0;
+    hyn::scheduler::Scheduler sc(threads, false, "scaling");
+    sc.start();
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < roots; ++i) {
+        sc.schedule([depth]() { scaling_task(depth); });
+    }
+    while (s_scaling_done < total) {
+        usleep(100);
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    sc.stop();
+    return total * 1e6 / (cost ? cost : 1);
+}
+
+/**
+ *@brief 所属线程一边push(从很小的容量开始，触发扩容)一边从队头取，其他线程同时窃取，每个元素只能被取到一次
+ */
+void work_stealing_queue_correct(int thieves, int count) {
+    hyn::scheduler::WorkStealingQueue<int> queue(4);
+    std::vector<int> items(count);
+    std::vector<std::atomic<int>> taken(count);
+    std::atomic<int> total{0};
+    std::atomic<bool> pushing{true};
+    auto take = [&](int *item) {
+        ++taken[item - items.data()];
+        ++total;
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thieves; ++i) {
+        threads.emplace_back([&]() {
+            while (pushing || !queue.empty()) {
+                if (int *item = queue.steal()) {
+                    take(item);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < count; ++i) {
+        items[i] = i;
+        queue.push(&items[i]);
+        if (i % 3 == 0) {
+            if (int *item = queue.steal()) {
+                take(item);
+            }
+        }
+    }
+    pushing = false;
+    for (auto &i: threads) {
+        i.join();
+    }
+    while (int *item = queue.steal()) {
+        take(item);
+    }
+    assert(total == count);
+    for (auto &i: taken) {
+        assert(i == 1);
+    }
+}
+
+/**
+ *@brief 测试用，暴露调度线程的id
+ */
+class PinnedScheduler : public hyn::scheduler::Scheduler {
+public:
+    using Scheduler::Scheduler;
+    using Scheduler::getWorkerThreadId;
+
+    [[nodiscard]] int getThreadId(size_t i) const { return m_thread_id_vector[i]; }
+};
+
+/**
+ *@brief start返回后马上按线程id投递任务，任务要在指定的线程上执行
+ */
+void pinned_schedule_after_start(int rounds) {
+    for (int round = 0; round < rounds; ++round) {
+        PinnedScheduler sc(2, false, "pinned");
+        sc.start();
+        int tid = sc.getThreadId(1);
+        assert(sc.getWorkerThreadId(1) == tid);
+        std::atomic<int> ran_on{0};
+        sc.schedule([&ran_on]() { ran_on = hyn::util::GetThreadId(); }, tid);
+        while (ran_on == 0) {
+            usleep(100);
+        }
+        assert(ran_on == tid);
+        sc.stop();
+    }
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    work_stealing_queue_correct(3, 1000000);
+    pinned_schedule_after_start(200);
+    std::cout << "work stealing queue ok" << '\n';
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t n = 1; n <= max_threads; n *= 2) {
+        std::cout << "threads: " << n << " tasks/sec: " << scheduler_scaling_bench(n, 16, 7) << '\n';
+    }
+}
+
+#endif //SERVERFRAMEWORK_TEST_SCHEDULER_SCALING_H
@@ -0,0 +1,141 @@
+/**
+  ******************************************************************************
+  * @file           : test_sendfile.h
+  * @author         : hyn
+  * @brief          : SocketStream的sendFile和spliceFrom，和经过用户态的默认实现对比
+  * @attention      : 走127.0.0.1，会在/tmp下写一个64MB的文件，结束时删除
+  * @date           : 2023/6/5
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_SENDFILE_H
+#define SERVERFRAMEWORK_TEST_SENDFILE_H
+
+#include <cassert>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include "../src/Address.h"
+#include "../src/IOManager.h"
+#include "../src/Socket.h"
+#include "../src/SocketStream.h"
+#include "../src/util.h"
+#include "tcp_pair.h"
+
+static const char *g_sendfile_name = "/tmp/hyn_sendfile_test.dat";
+static const size_t g_sendfile_size = 64 << 20;
+
+/**
+ *@brief 第i个字节的内容，以64KB为周期
+ */
+static char sendfile_byte(size_t i) {
+    return static_cast<char>((i * 31) ^ (i >> 8));
+}
+
+/**
+ *@brief 读len字节，verify为true时检查内容
+ */
+void sendfile_check(const hyn::SocketStream::ptr &stream, size_t len, bool verify) {
+    std::vector<char> buff(256 * 1024);
+    for (size_t done = 0; done < len;) {
+        int n = stream->read(buff.data(), std::min(buff.size(), len - done));
+        assert(n > 0);
+        for (int i = 0; verify && i < n; ++i) {
+            assert(buff[i] == sendfile_byte(done + i));
+        }
+        done += n;
+    }
+}
+
+void sendfile_bench(bool zero_copy, size_t size, bool verify) {
+    int fd = open(g_sendfile_name, O_RDONLY);
+    auto [client, server] = tcp_pair();
+    hyn::iomanager::IOManager::GetThis()->schedule([client = client, size, verify] {
+        sendfile_check(client, size, verify);
+    });
+    uint64_t begin = hyn::util::GetCurrentUS();
+    int64_t rt = zero_copy ? server->sendFile(fd, 0, size) : server->Stream::sendFile(fd, 0, size);
+    assert(rt == (int64_t) size);
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+
+    //文件不够len时返回实际发送的长度
+    off_t tail = g_sendfile_size - 100;
+    rt = zero_copy ? server->sendFile(fd, tail, 1000) : server->Stream::sendFile(fd, tail, 1000);
+    assert(rt == 100);
+    server->close();
+    close(fd);
+    if (!verify) {
+        std::cout << (zero_copy ? "sendfile   " : "pread+send ") << "MB/s: " << size / 1.048576 / cost << '\n';
+    }
+}
+
+void splice_bench(bool zero_copy, size_t size, bool verify) {
+    auto [src_client, proxy_in] = tcp_pair();
+    auto [proxy_out, sink] = tcp_pair();
+    auto iom = hyn::iomanager::IOManager::GetThis();
+    iom->schedule([src_client = src_client, size] {
+        std::vector<char> buff(256 * 1024);
+        for (size_t i = 0; i < buff.size(); ++i) {
+            buff[i] = sendfile_byte(i);
+        }
+        for (size_t done = 0; done < size;) {
+            size_t n = std::min(buff.size(), size - done);
+            assert(src_client->writeFixSize(buff.data(), n) == (int) n);
+            done += n;
+        }
+    });
+    iom->schedule([sink = sink, size, verify] {
+        sendfile_check(sink, size, verify);
+    });
+    uint64_t begin = hyn::util::GetCurrentUS();
+    hyn::Stream::ptr src = proxy_in;
+    int64_t rt = zero_copy ? proxy_out->spliceFrom(src, size) : proxy_out->Stream::spliceFrom(src, size);
+    assert(rt == (int64_t) size);
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+
+    //源端提前关闭时返回已经转发的长度，之后返回0
+    int written = src_client->writeFixSize("12345", 5);
+    src_client->close();
+    int64_t partial = proxy_out->spliceFrom(src, 10);
+    int64_t eof = proxy_out->spliceFrom(src, 10);
+    assert(written == 5 && partial == 5 && eof == 0);
+    proxy_out->close();
+    if (!verify) {
+        std::cout << (zero_copy ? "splice     " : "read+write ") << "MB/s: " << size / 1.048576 / cost << '\n';
+    }
+}
+
+void test() {
+    const size_t size = g_sendfile_size;
+    int fd = open(g_sendfile_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::vector<char> chunk(1 << 20);
+    for (size_t off = 0; off < size; off += chunk.size()) {
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            chunk[i] = sendfile_byte(off + i);
+        }
+        assert(write(fd, chunk.data(), chunk.size()) == (ssize_t) chunk.size());
+    }
+    close(fd);
+
+    hyn::iomanager::IOManager iom(1, true, "sendfile");
+    iom.schedule([size] {
+        //先用小数据检查内容，再测吞吐
+        for (bool zero_copy: {false, true}) {
+            sendfile_bench(zero_copy, 4 << 20, true);
+            splice_bench(zero_copy, 4 << 20, true);
+        }
+        for (int round = 0; round < 2; ++round) {
+            sendfile_bench(false, size, false);
+            sendfile_bench(true, size, false);
+            splice_bench(false, size, false);
+            splice_bench(true, size, false);
+        }
+    });
+    iom.stop();
+    unlink(g_sendfile_name);
+}
+
+#endif //SERVERFRAMEWORK_TEST_SENDFILE_H
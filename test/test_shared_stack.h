@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file           : test_shared_stack.h
+  * @author         : hyn
+  * @brief          : 共享栈模式下空闲连接的内存占用
+  * @attention      : None
+  * @date           : 2023/5/21
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_SHARED_STACK_H
+#define SERVERFRAMEWORK_TEST_SHARED_STACK_H
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../src/IOManager.h"
+#include "../src/FDManger.h"
+#include "../src/Logger.h"
+
+/**
+ *@brief 读取/proc/self/statm,返回(虚拟内存,常驻内存)字节数
+ */
+std::pair<size_t, size_t> read_statm() {
+    size_t vsz = 0, rss = 0;
+    std::ifstream ifs("/proc/self/statm");
+    ifs >> vsz >> rss;
+    size_t page = sysconf(_SC_PAGESIZE);
+    return {vsz * page, rss * page};
+}
+
+/**
+ *@brief 模拟一个空闲的长连接：在不大的调用栈上阻塞在recv
+ */
+void park_connection(int fd, std::atomic<int> &parked) {
+    hyn::FdMgr::GetInstance()->get(fd, true);
+    char header[2048];
+    memset(header, 0, sizeof(header));
+    ++parked;
+    read(fd, header, sizeof(header));
+}
+
+void idle_connection_bench(bool shared, int count) {
+    std::vector<std::pair<int, int>> pairs(count);
+    for (auto &i: pairs) {
+        int sv[2];
+        THROW_RUNTIME_ERROR_IF(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), "socketpair error");
+        i = {sv[0], sv[1]};
+    }
+    std::atomic<int> parked{0};
+    {
+        hyn::iomanager::IOManager iom(1, false, shared ? "shared" : "private");
+        iom.setSharedStack(shared);
+        auto before = read_statm();
+        for (auto &i: pairs) {
+            int fd = i.first;
+            iom.schedule([fd, &parked]() { park_connection(fd, parked); });
+        }
+        while (parked < count) {
+            usleep(10 * 1000);
+        }
+        usleep(100 * 1000);
+        auto after = read_statm();
+        std::cout << (shared ? "shared stack " : "private stack") << " connections: " << count
+                  << " vsz/conn: " << (after.first - before.first) / count
+                  << " rss/conn: " << (after.second - before.second) / count << '\n';
+        for (auto &i: pairs) {
+            write(i.second, "x", 1);
+        }
+    }
+    for (auto &i: pairs) {
+        //主线程没有开启hook,手动清掉fd上下文,避免fd复用时拿到旧的状态
+        hyn::FdMgr::GetInstance()->del(i.first);
+        close(i.first);
+        close(i.second);
+    }
+}
+
+/**
+ *@brief 两个共享栈协程先后创建，第一个运行后挂起，第二个这时才第一次运行
+ *@note 初始栈帧如果在构造时就写到共享栈上，会被先运行的协程覆盖
+ */
+void shared_stack_interleave() {
+    std::atomic<int> done{0};
+    std::vector<int> order;
+    {
+        hyn::iomanager::IOManager iom(1, false, "interleave");
+        iom.schedule([&]() {
+            hyn::fiber::Fiber::ptr first(new hyn::fiber::Fiber([&]() {
+                char buf[512];
+                memset(buf, 1, sizeof(buf));
+                order.push_back(1);
+                hyn::fiber::Fiber::YieldToReady();
+                order.push_back(buf[0] == 1 && buf[sizeof(buf) - 1] == 1 ? 3 : -1);
+                ++done;
+            }, 0, false, true));
+            hyn::fiber::Fiber::ptr second(new hyn::fiber::Fiber([&]() {
+                order.push_back(2);
+                ++done;
+            }, 0, false, true));
+            hyn::scheduler::Scheduler::GetThis()->schedule(first);
+            hyn::scheduler::Scheduler::GetThis()->schedule(second);
+        });
+        while (done < 2) {
+            usleep(1000);
+        }
+    }
+    assert((order == std::vector<int>{1, 2, 3}));
+    std::cout << "shared stack interleave ok" << '\n';
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    int count = static_cast<int>(std::min<rlim_t>(20000, (limit.rlim_cur - 64) / 2));
+    shared_stack_interleave();
+    idle_connection_bench(false, count);
+    idle_connection_bench(true, count);
+}
+
+#endif //SERVERFRAMEWORK_TEST_SHARED_STACK_H
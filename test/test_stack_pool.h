@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file           : test_stack_pool.h
+  * @author         : hyn
+  * @brief          : 协程栈池测试
+  * @attention      : None
+  * @date           : 2023/5/21
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_STACK_POOL_H
+#define SERVERFRAMEWORK_TEST_STACK_POOL_H
+
+#include <iostream>
+#include "../src/Logger.h"
+#include "../src/fiber.h"
+#include "../src/util.h"
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    hyn::fiber::Fiber::GetThis();
+    const int count = 100000;
+    int sum = 0;
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (int i = 0; i < count; ++i) {
+        hyn::fiber::Fiber::ptr fiber(new hyn::fiber::Fiber([&sum]() { ++sum; }, 0, true));
+        fiber->call();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    assert(sum == count);
+    std::cout << "create+run+destroy fibers/sec: " << count * 1e6 / (cost ? cost : 1) << '\n'
+              << "stack pool hits: " << hyn::fiber::StackPool::Hits()
+              << " misses: " << hyn::fiber::StackPool::Misses()
+              << " cached: " << hyn::fiber::StackPool::Cached() << '\n';
+    assert(hyn::fiber::StackPool::Misses() == 1);
+
+    //超过缓存上限的栈直接释放
+    std::vector<hyn::fiber::Fiber::ptr> fibers;
+    for (size_t i = 0; i < hyn::fiber::StackPool::GetMaxCached() * 2; ++i) {
+        fibers.emplace_back(new hyn::fiber::Fiber([]() {}, 0, true));
+        fibers.back()->call();
+    }
+    fibers.clear();
+    std::cout << "cached after burst: " << hyn::fiber::StackPool::Cached() << '\n';
+    assert(hyn::fiber::StackPool::Cached() == hyn::fiber::StackPool::GetMaxCached());
+}
+
+#endif //SERVERFRAMEWORK_TEST_STACK_POOL_H
@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file           : test_tickle.h
+  * @author         : hyn
+  * @brief          : IOManager唤醒次数统计
+  * @attention      : None
+  * @date           : 2023/5/24
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_TICKLE_H
+#define SERVERFRAMEWORK_TEST_TICKLE_H
+
+#include <atomic>
+#include <iostream>
+#include "../src/IOManager.h"
+#include "../src/Logger.h"
+#include "../src/util.h"
+
+/**
+ *@brief 外部线程一波一波地提交小任务，统计发出的tickle和真正有用的唤醒
+ */
+void tickle_bench(size_t threads, int rounds, int burst) {
+    std::atomic<int> done{0};
+    uint64_t begin = hyn::util::GetCurrentUS();
+    hyn::iomanager::IOManager::TickleStats stats{};
+    {
+        hyn::iomanager::IOManager iom(threads, false, "tickle");
+        for (int r = 0; r < rounds; ++r) {
+            for (int i = 0; i < burst; ++i) {
+                iom.schedule([&done]() {
+                    volatile int sum = 0;
+                    for (int k = 0; k < 1000; ++k) {
+                        sum += k;
+                    }
+                    ++done;
+                });
+            }
+            usleep(200);
+        }
+        while (done < rounds * burst) {
+            usleep(100);
+        }
+        stats = iom.getTickleStats();
+    }
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    std::cout << "threads: " << threads << " tasks: " << done << " cost(us): " << cost
+              << " tickles sent: " << stats.sent << " wakeups: " << stats.wakeups
+              << " useful: " << stats.useful << '\n';
+}
+
+void test() {
+    hyn::singleton::Singleton<hyn::logger::Logger>::get_instance()->level(hyn::logger::Logger::WARN);
+    tickle_bench(4, 2000, 8);
+    tickle_bench(8, 2000, 8);
+}
+
+#endif //SERVERFRAMEWORK_TEST_TICKLE_H
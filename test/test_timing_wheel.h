@@ -0,0 +1,163 @@
+/**
+  ******************************************************************************
+  * @file           : test_timing_wheel.h
+  * @author         : hyn
+  * @brief          : 有序集合和时间轮两种定时器管理的对比
+  * @attention      : None
+  * @date           : 2023/5/27
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_TIMING_WHEEL_H
+#define SERVERFRAMEWORK_TEST_TIMING_WHEEL_H
+
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../src/Timer.h"
+#include "../src/util.h"
+
+class BenchTimerManager : public hyn::TimerManager {
+public:
+    using TimerManager::listExpiredCb;
+protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+/**
+ *@brief 添加count个随机超时的定时器再全部取消，模拟大量连接的recv超时；
+ *       然后添加count个1秒内到期的定时器，一直取到全部到期
+ */
+void timing_wheel_bench(bool wheel, size_t count) {
+    BenchTimerManager manager;
+    manager.setTimingWheel(wheel);
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<uint64_t> timeout(1000, 120000);
+    std::vector<hyn::Timer::ptr> timers;
+    timers.reserve(count);
+
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (size_t i = 0; i < count; ++i) {
+        timers.push_back(manager.addTimer(timeout(rng), [] {}));
+    }
+    uint64_t added = hyn::util::GetCurrentUS();
+    for (auto &timer: timers) {
+        timer->cancel();
+    }
+    uint64_t cancelled = hyn::util::GetCurrentUS();
+    timers.clear();
+
+    size_t fired = 0;
+    std::uniform_int_distribution<uint64_t> soon(1, 1000);
+    for (size_t i = 0; i < count; ++i) {
+        manager.addTimer(soon(rng), [&fired] { ++fired; });
+    }
+    uint64_t expire_begin = hyn::util::GetCurrentUS();
+    std::vector<std::function<void()>> cbs;
+    while (fired < count) {
+        usleep(1000);
+        cbs.clear();
+        manager.listExpiredCb(cbs);
+        for (auto &cb: cbs) {
+            cb();
+        }
+    }
+    uint64_t expired = hyn::util::GetCurrentUS();
+
+    std::cout << (wheel ? "timing wheel" : "std::set    ") << " timers: " << count
+              << " add(ns/op): " << (added - begin) * 1000.0 / count
+              << " cancel(ns/op): " << (cancelled - added) * 1000.0 / count
+              << " expire total(ms): " << (expired - expire_begin) / 1000 << '\n';
+}
+
+/**
+ *@brief 直接驱动时间轮，每次推进到nextExpire：节点不能提前到期，到期时间跨过各层转下来时顺序不乱，每个只到期一次
+ */
+void timing_wheel_order() {
+    //起点故意不对齐到任何一层的边界
+    const uint64_t start = 1000000007;
+    hyn::TimingWheel wheel(start);
+    std::vector<uint64_t> delays = {1, 2, 255, 256, 257, 300, 16383, 16384, 16385, 20000, (1 << 20) - 1, 1 << 20,
+                                    (1 << 20) + 5, 3000000, (1 << 26) - 1, 1 << 26, (1 << 26) + 77};
+    std::mt19937 rng(4321);
+    std::uniform_int_distribution<uint64_t> random_delay(1, 1 << 22);
+    for (int i = 0; i < 2000; ++i) {
+        delays.push_back(random_delay(rng));
+    }
+    std::vector<hyn::TimerNode> nodes(delays.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].m_next = start + delays[i];
+        wheel.add(&nodes[i], start);
+    }
+    //取消一部分，不能再到期
+    std::vector<bool> cancelled(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i += 7) {
+        bool removed = wheel.remove(&nodes[i]);
+        assert(removed);
+        removed = wheel.remove(&nodes[i]);
+        assert(!removed);
+        cancelled[i] = true;
+    }
+
+    std::vector<int> fired(nodes.size());
+    std::vector<hyn::TimerNode *> expired;
+    uint64_t now = start;
+    uint64_t last = 0;
+    while (!wheel.empty()) {
+        uint64_t next = wheel.nextExpire();
+        assert(next > now);
+        expired.clear();
+        wheel.advance(next, expired);
+        for (auto *node: expired) {
+            //每次只推进到最早可能到期的时间，到期的必须正好在这一毫秒：既没有提前也没有推迟
+            assert(node->m_next == next);
+            assert(node->m_next >= last);
+            last = node->m_next;
+            ++fired[node - nodes.data()];
+        }
+        now = next;
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        assert(fired[i] == (cancelled[i] ? 0 : 1));
+    }
+}
+
+/**
+ *@brief 时间轮空闲了一天之后再添加，要以添加时的时间为准，不能从旧的时间逐毫秒追上来
+ */
+void timing_wheel_idle_gap() {
+    const uint64_t start = 5000000;
+    hyn::TimingWheel wheel(start);
+    hyn::TimerNode node;
+    node.m_next = start + 10;
+    wheel.add(&node, start);
+    std::vector<hyn::TimerNode *> expired;
+    wheel.advance(start + 10, expired);
+    assert(expired.size() == 1 && wheel.empty());
+
+    uint64_t now = start + 24ull * 3600 * 1000;
+    node.m_next = now + 5;
+    wheel.add(&node, now);
+    assert(wheel.nextExpire() == now + 5);
+    expired.clear();
+    uint64_t begin = hyn::util::GetCurrentUS();
+    wheel.advance(now + 4, expired);
+    assert(expired.empty());
+    wheel.advance(now + 5, expired);
+    uint64_t cost = hyn::util::GetCurrentUS() - begin;
+    assert(expired.size() == 1 && expired[0] == &node);
+    assert(cost < 10000);
+}
+
+void test() {
+    timing_wheel_order();
+    timing_wheel_idle_gap();
+    std::cout << "timing wheel order/cancel/idle gap ok" << '\n';
+    timing_wheel_bench(false, 1000000);
+    timing_wheel_bench(true, 1000000);
+}
+
+#endif //SERVERFRAMEWORK_TEST_TIMING_WHEEL_H
@@ -0,0 +1,177 @@
+/**
+  ******************************************************************************
+  * @file           : test_varint_simd.h
+  * @author         : hyn
+  * @brief          : 批量Varint编解码，和逐个读写的结果对比，再比较两者的速度
+  * @attention      : 用很小的内存块让值跨过块边界
+  * @date           : 2023/6/2
+  ******************************************************************************
+  */
+
+
+
+#ifndef SERVERFRAMEWORK_TEST_VARINT_SIMD_H
+#define SERVERFRAMEWORK_TEST_VARINT_SIMD_H
+
+#include <cassert>
+#include <climits>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "../src/ByteArray.h"
+#include "../src/Varint.h"
+#include "../src/util.h"
+
+/**
+ *@brief 生成count个值，bits为每个值最多的有效位数，0表示各种长度混在一起
+ */
+template<typename T>
+std::vector<T> varint_values(size_t count, int bits, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<T> values(count);
+    for (auto &v: values) {
+        int b = bits ? bits : (int) (rng() % (sizeof(T) * 8)) + 1;
+        uint64_t r = rng();
+        v = static_cast<T>(b >= 64 ? r : r & ((1ull << b) - 1));
+    }
+    return values;
+}
+
+template<typename T>
+void varint_round_trip(const std::vector<T> &values, size_t base) {
+    //批量写，逐个读
+    hyn::ByteArray::ptr bulk(new hyn::ByteArray(base));
+    hyn::ByteArray::ptr single(new hyn::ByteArray(base));
+    if constexpr (std::is_same_v<T, uint32_t>) {
+        bulk->writeUint32Array(values.data(), values.size());
+        for (auto v: values) single->writeUint32(v);
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        bulk->writeInt32Array(values.data(), values.size());
+        for (auto v: values) single->writeInt32(v);
+    } else if constexpr (std::is_same_v<T, uint64_t>) {
+        bulk->writeUint64Array(values.data(), values.size());
+        for (auto v: values) single->writeUint64(v);
+    } else {
+        bulk->writeInt64Array(values.data(), values.size());
+        for (auto v: values) single->writeInt64(v);
+    }
+    bulk->setPos(0);
+    single->setPos(0);
+    assert(bulk->toString() == single->toString());
+
+    //逐个写，批量读；分几次读，让每次的起点落在不同位置
+    std::vector<T> out(values.size());
+    for (size_t n = 0; n < out.size();) {
+        size_t len = std::min<size_t>(out.size() - n, 1 + n % 97);
+        if constexpr (std::is_same_v<T, uint32_t>) {
+            single->readUint32Array(out.data() + n, len);
+        } else if constexpr (std::is_same_v<T, int32_t>) {
+            single->readInt32Array(out.data() + n, len);
+        } else if constexpr (std::is_same_v<T, uint64_t>) {
+            single->readUint64Array(out.data() + n, len);
+        } else {
+            single->readInt64Array(out.data() + n, len);
+        }
+        n += len;
+    }
+    assert(out == values);
+    assert(single->getReadSize() == 0);
+}
+
+void test_varint_codec() {
+    std::cout << "varint implementation: " << hyn::varint::Implementation() << '\n';
+    for (size_t base: {7, 13, 4096}) {
+        for (int bits: {0, 7, 8, 14, 21, 32}) {
+            varint_round_trip(varint_values<uint32_t>(5000, bits, bits + base), base);
+            auto s = varint_values<uint32_t>(5000, bits, bits + base + 1);
+            varint_round_trip(std::vector<int32_t>(s.begin(), s.end()), base);
+        }
+        for (int bits: {0, 7, 28, 56, 57, 64}) {
+            varint_round_trip(varint_values<uint64_t>(5000, bits, bits + base), base);
+            auto s = varint_values<uint64_t>(5000, bits, bits + base + 1);
+            varint_round_trip(std::vector<int64_t>(s.begin(), s.end()), base);
+        }
+        varint_round_trip(std::vector<uint32_t>{0, 127, 128, 16383, 16384, UINT32_MAX}, base);
+        varint_round_trip(std::vector<int32_t>{0, -1, 1, INT32_MIN + 1, INT32_MAX}, base);
+        varint_round_trip(std::vector<uint64_t>{0, 127, 128, 1ull << 56, (1ull << 56) - 1, UINT64_MAX}, base);
+        varint_round_trip(std::vector<int64_t>{0, -1, 1, INT64_MIN + 1, INT64_MAX}, base);
+    }
+
+    //超过5个字节的32位Varint和readUint32一样截断
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(4096));
+    std::vector<uint8_t> raw(64, 0xff);
+    raw.push_back(0x01);
+    ba->write(raw.data(), raw.size());
+    ba->setPos(0);
+    std::vector<uint32_t> expect;
+    while (ba->getReadSize()) expect.push_back(ba->readUint32());
+    ba->setPos(0);
+    std::vector<uint32_t> got(expect.size());
+    ba->readUint32Array(got.data(), got.size());
+    assert(got == expect);
+
+    //数据不够时抛异常
+    ba->setPos(0);
+    bool thrown = false;
+    try {
+        ba->readUint32Array(got.data(), got.size() + 1);
+    } catch (std::out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+template<typename T>
+void varint_bench(const char *name, const std::vector<T> &values) {
+    hyn::ByteArray::ptr ba(new hyn::ByteArray(4096));
+    std::vector<T> out(values.size());
+    double n = values.size();
+
+    uint64_t begin = hyn::util::GetCurrentUS();
+    for (auto v: values) {
+        if constexpr (sizeof(T) == 4) ba->writeUint32(v); else ba->writeUint64(v);
+    }
+    uint64_t single_write = hyn::util::GetCurrentUS() - begin;
+    ba->setPos(0);
+    begin = hyn::util::GetCurrentUS();
+    for (auto &v: out) {
+        if constexpr (sizeof(T) == 4) v = ba->readUint32(); else v = ba->readUint64();
+    }
+    uint64_t single_read = hyn::util::GetCurrentUS() - begin;
+    assert(out == values);
+
+    ba->clear();
+    begin = hyn::util::GetCurrentUS();
+    if constexpr (sizeof(T) == 4) {
+        ba->writeUint32Array(values.data(), values.size());
+    } else {
+        ba->writeUint64Array(values.data(), values.size());
+    }
+    uint64_t bulk_write = hyn::util::GetCurrentUS() - begin;
+    ba->setPos(0);
+    out.assign(out.size(), 0);
+    begin = hyn::util::GetCurrentUS();
+    if constexpr (sizeof(T) == 4) {
+        ba->readUint32Array(out.data(), out.size());
+    } else {
+        ba->readUint64Array(out.data(), out.size());
+    }
+    uint64_t bulk_read = hyn::util::GetCurrentUS() - begin;
+    assert(out == values);
+
+    std::cout << name << " ns/value write: " << single_write * 1000 / n << " -> " << bulk_write * 1000 / n
+              << "  read: " << single_read * 1000 / n << " -> " << bulk_read * 1000 / n << '\n';
+}
+
+void test() {
+    test_varint_codec();
+    const size_t count = 1 << 20;
+    varint_bench("u32 1byte ", varint_values<uint32_t>(count, 7, 1));
+    varint_bench("u32 2byte ", varint_values<uint32_t>(count, 14, 2));
+    varint_bench("u32 mixed ", varint_values<uint32_t>(count, 0, 3));
+    varint_bench("u64 1byte ", varint_values<uint64_t>(count, 7, 4));
+    varint_bench("u64 mixed ", varint_values<uint64_t>(count, 0, 5));
+}
+
+#endif //SERVERFRAMEWORK_TEST_VARINT_SIMD_H